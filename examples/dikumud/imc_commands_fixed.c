@@ -32,6 +32,7 @@ DO_FUN(do_channels);
 DO_FUN(do_channel);
 DO_FUN(do_chjoin);
 DO_FUN(do_chleave);
+DO_FUN(do_chdigest);
 DO_FUN(do_chwho);
 DO_FUN(do_imchelp);
 DO_FUN(do_imcadmin);
@@ -44,11 +45,12 @@ DO_FUN(do_imcdebug);
 
 /*
  * imctell - Send a tell to a player on another MUD
- * Usage: imctell player@mudname message
+ * Usage: imctell player@mudname[,player@mudname...] message
  */
 DO_FUN(do_imctell) {
     char target[MAX_INPUT_LENGTH], message[MAX_INPUT_LENGTH];
-    char *at_pos, *mudname, *username;
+    IMC_TARGET to[IMC_TELL_MAX_TARGETS];
+    int count, result;
     
     if (!IMC_IS_CONNECTED()) {
         send_to_char("MudVault Mesh is not connected.\n\r", ch);
@@ -65,8 +67,8 @@ DO_FUN(do_imctell) {
     
     /* Parse arguments: imctell player@mud message goes here */
     if (argument[0] == '\0') {
-        send_to_char("Usage: imctell <player@mudname> <message>\n\r", ch);
-        send_to_char("Example: imctell john@othermud Hello there!\n\r", ch);
+        send_to_char("Usage: imctell <player@mudname>[,<player@mudname>...] <message>\n\r", ch);
+        send_to_char("Example: imctell john@othermud,mary@thirdmud Hello there!\n\r", ch);
         return;
     }
     
@@ -75,28 +77,14 @@ DO_FUN(do_imctell) {
     strcpy(message, argument);
     
     if (target[0] == '\0' || message[0] == '\0') {
-        send_to_char("Usage: imctell <player@mudname> <message>\n\r", ch);
+        send_to_char("Usage: imctell <player@mudname>[,<player@mudname>...] <message>\n\r", ch);
         return;
     }
     
-    /* Parse target into username@mudname */
-    at_pos = strchr(target, '@');
-    if (!at_pos) {
-        send_to_char("You must specify the target as player@mudname.\n\r", ch);
-        return;
-    }
-    
-    *at_pos = '\0';
-    username = target;
-    mudname = at_pos + 1;
-    
-    if (!IMC_VALID_USERNAME(username)) {
-        send_to_char("Invalid username format.\n\r", ch);
-        return;
-    }
-    
-    if (!IMC_VALID_MUDNAME(mudname)) {
-        send_to_char("Invalid MUD name format.\n\r", ch);
+    /* Parse targets into username@mudname, several separated by commas */
+    if ((result = imc_parse_targets(target, to, IMC_TELL_MAX_TARGETS, &count)) != IMC_TARGET_OK) {
+        sprintf(buf, "%s\n\r", imc_target_error(result));
+        send_to_char(buf, ch);
         return;
     }
     
@@ -106,16 +94,19 @@ DO_FUN(do_imctell) {
         return;
     }
     
-    /* Send the tell */
-    imc_send_tell(imc_get_name(ch), mudname, username, message);
+    /* Send the tell; several recipients share one multitell */
+    if (count == 1) {
+        imc_send_tell(imc_get_name(ch), to[0].mud, to[0].user, message);
+    } else {
+        imc_send_multitell(imc_get_name(ch), to, count, message);
+    }
     
     /* Confirm to sender */
-    sprintf(buf, "You tell %s@%s: %s\n\r", username, mudname, message);
+    sprintf(buf, "You tell %s: %s\n\r", target, message);
     IMC_SEND_TELL_COLOR(ch, buf);
     
     /* Add to history */
-    sprintf(buf2, "%s@%s", username, mudname);
-    imc_add_history(IMC_MSG_TELL, imc_get_name(ch), buf2, message);
+    imc_add_history(IMC_MSG_TELL, imc_get_name(ch), target, message);
 }
 
 /*
@@ -205,7 +196,8 @@ DO_FUN(do_imcwho) {
  */
 DO_FUN(do_imcfinger) {
     char target[MAX_INPUT_LENGTH];
-    char *at_pos, *mudname, *username;
+    IMC_TARGET to;
+    int result;
     
     if (!IMC_IS_CONNECTED()) {
         send_to_char("MudVault Mesh is not connected.\n\r", ch);
@@ -225,25 +217,16 @@ DO_FUN(do_imcfinger) {
     }
     
     /* Parse target */
-    at_pos = strchr(target, '@');
-    if (!at_pos) {
-        send_to_char("You must specify the target as player@mudname.\n\r", ch);
-        return;
-    }
-    
-    *at_pos = '\0';
-    username = target;
-    mudname = at_pos + 1;
-    
-    if (!IMC_VALID_USERNAME(username) || !IMC_VALID_MUDNAME(mudname)) {
-        send_to_char("Invalid username or MUD name format.\n\r", ch);
+    if ((result = imc_parse_target(target, &to)) != IMC_TARGET_OK) {
+        sprintf(buf, "%s\n\r", imc_target_error(result));
+        send_to_char(buf, ch);
         return;
     }
     
     /* Send finger request */
-    imc_send_finger_request(mudname, username);
+    imc_send_finger_request(to.mud, to.user);
     
-    sprintf(buf, "Requesting information about %s@%s...\n\r", username, mudname);
+    sprintf(buf, "Requesting information about %s@%s...\n\r", to.user, to.mud);
     send_to_char(buf, ch);
 }
 
@@ -333,6 +316,8 @@ DO_FUN(do_imcstats) {
         sprintf(buf, "Last Pong: %ld seconds ago\n\r", 
             time(NULL) - imc_data->last_pong);
         send_to_char(buf, ch);
+        
+        imc_pace_show_stats(ch);
     } else {
         sprintf(buf, "Reconnect attempts: %d/%d\n\r", 
             imc_data->reconnect_attempts, IMC_MAX_RECONNECTS);
@@ -466,6 +451,9 @@ DO_FUN(do_chjoin) {
     
     sprintf(buf, "You have joined channel '%s'.\n\r", channel_name);
     IMC_SEND_INFO_COLOR(ch, buf);
+    
+    /* Catch them up on what was said recently */
+    imc_replay_channel(ch, channel_name);
 }
 
 /*
@@ -500,11 +488,45 @@ DO_FUN(do_chleave) {
     
     /* Leave the channel */
     imc_leave_channel(channel_name, imc_get_name(ch));
+    imc_digest_remove(channel_name, imc_get_name(ch));
     
     sprintf(buf, "You have left channel '%s'.\n\r", channel_name);
     IMC_SEND_INFO_COLOR(ch, buf);
 }
 
+/*
+ * chdigest - Take a channel as a periodic digest instead of line by line
+ */
+DO_FUN(do_chdigest) {
+    char channel_name[MAX_INPUT_LENGTH];
+    
+    one_argument(argument, channel_name);
+    
+    if (channel_name[0] == '\0') {
+        send_to_char("Usage: chdigest <channel>\n\r", ch);
+        return;
+    }
+    
+    if (!IMC_VALID_CHANNEL(channel_name)) {
+        send_to_char("Invalid channel name format.\n\r", ch);
+        return;
+    }
+    
+    if (!imc_is_on_channel(channel_name, imc_get_name(ch))) {
+        sprintf(buf, "You are not on channel '%s'.\n\r", channel_name);
+        send_to_char(buf, ch);
+        return;
+    }
+    
+    if (imc_digest_toggle(channel_name, imc_get_name(ch))) {
+        sprintf(buf, "Channel '%s' will now arrive as a digest every %d seconds.\n\r",
+                channel_name, IMC_DIGEST_INTERVAL);
+    } else {
+        sprintf(buf, "Channel '%s' will now arrive line by line.\n\r", channel_name);
+    }
+    send_to_char(buf, ch);
+}
+
 /*
  * imchelp - Show IMC help
  */
@@ -529,6 +551,7 @@ DO_FUN(do_imchelp) {
     send_to_char("  channels                        - List available channels\n\r", ch);
     send_to_char("  chjoin <channel>                - Join a channel\n\r", ch);
     send_to_char("  chleave <channel>               - Leave a channel\n\r", ch);
+    send_to_char("  chdigest <channel>              - Toggle digest delivery\n\r", ch);
     send_to_char("  channel <channel> <message>     - Send message to channel\n\r", ch);
     send_to_char("\n\r", ch);
     
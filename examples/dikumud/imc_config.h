@@ -38,21 +38,58 @@
 #define IMC_MAX_MESSAGE_LEN    4096            /* Maximum message length */
 #define IMC_MAX_CHANNEL_LEN    32              /* Maximum channel name length */
 #define IMC_MAX_USERNAME_LEN   32              /* Maximum username length */
+#define IMC_MAX_MUDNAME_LEN    32              /* Maximum MUD name length */
 #define IMC_BUFFER_SIZE        8192            /* Network buffer size */
+#define IMC_FRAME_BATCHES      1               /* 1 = Offer to take several messages per frame */
+#define IMC_TELL_MAX_TARGETS   8               /* Recipients one imctell can name */
 
 /* Debug and logging */
 #define IMC_DEBUG              0               /* 1 = Enable debug logging */
 #define IMC_LOG_FILE           "../log/imc.log" /* Log file path */
 
 /* Message history */
-#define IMC_HISTORY_SIZE       100             /* Messages to keep in history */
+#define IMC_HISTORY_BLOCK_SIZE 16384           /* Bytes of history per block, deflated when full */
+#define IMC_HISTORY_BLOCKS     256             /* Full blocks kept (about 4MB of chat before deflating) */
+#define IMC_HISTORY_CACHE      4               /* Inflated blocks kept for repeated reads */
 #define IMC_CHANNEL_HISTORY    50              /* Channel messages to keep */
+#define IMC_HISTORY_FILE       "../lib/etc/imc_history" /* Persisted history log */
+#define IMC_HISTORY_SEARCH_MAX 20              /* Max results for imchistory search */
+#define IMC_INDEX_BUCKETS      1024            /* Search index hash buckets */
+#define IMC_REPLAY_LINES       20              /* Channel lines replayed on join */
+#define IMC_REPLAY_PAGE        5               /* Replay lines sent per pulse */
+#define IMC_REPLAY_WINDOW      3600            /* Connected this long, local history is complete */
+#define IMC_REPLAY_TIMEOUT     15              /* Seconds to wait for gateway history */
+
+/* Who cache */
+#define IMC_WHO_MAX_PLAYERS    200             /* Players listed in who replies */
+#define IMC_WHO_ENTRY_LEN      320             /* Serialized bytes per player entry */
+#define IMC_FINGER_FILE        "../lib/etc/imc_finger" /* Finger records for our players */
+
+/* Live feed for local viewers (web portals), Server-Sent Events on loopback */
+#define IMC_FEED_PORT          0               /* Port on 127.0.0.1, 0 = disabled */
+#define IMC_FEED_MAX_VIEWERS   32              /* Viewers connected at once */
+#define IMC_FEED_VIEWER_BUF    65536           /* Unsent bytes a viewer may lag by */
+
+/* Channel digests, for players who take a busy channel in blocks */
+#define IMC_DIGEST_INTERVAL    30              /* Seconds a line may wait */
+#define IMC_DIGEST_LINES       20              /* Lines that flush a digest early */
+#define IMC_DIGEST_BUF         4096            /* Bytes of lines per channel */
 
 /* Rate limiting - be conservative to avoid being rate limited */
 #define IMC_MAX_TELLS_MIN      20              /* Max tells per minute */
 #define IMC_MAX_CHANNELS_MIN   30              /* Max channel messages per minute */
 #define IMC_MAX_WHO_MIN        5               /* Max who requests per minute */
 
+/* Adaptive send pacing - learned from the gateway's RATE_LIMITED errors */
+#define IMC_PACE_INITIAL_RATE  5.0             /* Messages/second per class at startup */
+#define IMC_PACE_MIN_RATE      0.2             /* Never pace slower than this */
+#define IMC_PACE_MAX_RATE      20.0            /* Never pace faster than this */
+#define IMC_PACE_INCREASE      0.25            /* Added each second without rejections */
+#define IMC_PACE_DECREASE      0.5             /* Rate multiplier on each rejection */
+#define IMC_PACE_QUEUE_MAX     200             /* Max queued messages per class */
+#define IMC_PACE_INFLIGHT_MAX  64              /* Sent messages kept for retry */
+#define IMC_PACE_MAX_ATTEMPTS  5               /* Sends per message before dropping */
+
 /* Channel settings */
 #define IMC_MAX_CHANNELS       20              /* Max channels a player can join */
 #define IMC_DEFAULT_CHANNELS   { "gossip", "newbie", "ooc" }  /* Auto-join channels */
@@ -125,6 +162,7 @@
 #define imc_send_to_char(ch, str) send_to_char(ch, "%s", str)
 #define imc_get_name(ch)       GET_NAME(ch)
 #define imc_get_level(ch)      GET_LEVEL(ch)
+#define imc_get_title(ch)      GET_TITLE(ch)
 #define imc_get_room_vnum(ch)  GET_ROOM_VNUM(IN_ROOM(ch))
 #endif
 
@@ -133,6 +171,7 @@
 #define imc_send_to_char(ch, str) send_to_char(str, ch)
 #define imc_get_name(ch)       ch->name
 #define imc_get_level(ch)      ch->level
+#define imc_get_title(ch)      ch->pcdata->title
 #define imc_get_room_vnum(ch)  ch->in_room->vnum
 #endif
 
@@ -141,6 +180,7 @@
 #define imc_send_to_char(ch, str) send_to_char(str, ch)
 #define imc_get_name(ch)       ch->name
 #define imc_get_level(ch)      ch->level
+#define imc_get_title(ch)      ch->pcdata->title
 #define imc_get_room_vnum(ch)  ch->in_room->vnum
 #endif
 
@@ -161,6 +201,10 @@
 #define imc_get_level(ch)      (ch)->level
 #endif
 
+#ifndef imc_get_title
+#define imc_get_title(ch)      ""
+#endif
+
 #ifndef imc_get_room_vnum
 #define imc_get_room_vnum(ch)  0
 #endif
@@ -199,6 +243,14 @@
 #error "IMC_MAX_MESSAGE_LEN cannot exceed 4096 bytes"
 #endif
 
+#if IMC_HISTORY_BLOCK_SIZE < 2 * IMC_MAX_MESSAGE_LEN || IMC_HISTORY_BLOCK_SIZE > 65535
+#error "IMC_HISTORY_BLOCK_SIZE must hold two maximum-length messages and be below 64KB"
+#endif
+
+#if IMC_HISTORY_BLOCKS < 1 || IMC_HISTORY_CACHE < 1
+#error "IMC_HISTORY_BLOCKS and IMC_HISTORY_CACHE must be at least 1"
+#endif
+
 #if IMC_PING_INTERVAL < 30
 #error "IMC_PING_INTERVAL must be at least 30 seconds"
 #endif
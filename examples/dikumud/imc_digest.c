@@ -0,0 +1,213 @@
+/*
+ * MudVault Mesh Channel Digests for DikuMUD/Merc
+ *
+ * A player can take a busy channel as a digest instead of line by line.
+ * Lines for such a channel are formatted once into a shared block, and
+ * every IMC_DIGEST_INTERVAL seconds (or sooner, once IMC_DIGEST_LINES
+ * lines or IMC_DIGEST_BUF bytes have built up) the block goes to each
+ * online digest subscriber as a single write. Subscriptions are kept by
+ * name for the life of the MUD, so they survive a player relogging.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+/* A player taking a channel as a digest */
+typedef struct imc_digest_sub {
+    char name[IMC_MAX_USERNAME_LEN];
+    struct imc_digest_sub *next;
+} IMC_DIGEST_SUB;
+
+/* One channel's subscribers and the lines waiting for them */
+typedef struct imc_digest {
+    char channel[IMC_MAX_CHANNEL_LEN];
+    IMC_DIGEST_SUB *subs;
+    char lines[IMC_DIGEST_BUF];
+    int len;
+    int count;
+    time_t first;                      /* Arrival of the oldest waiting line */
+    struct imc_digest *next;
+} IMC_DIGEST;
+
+static IMC_DIGEST *digest_list = NULL;
+
+/* Rendered once per flush and shared by every subscriber */
+static char digest_plain[IMC_DIGEST_BUF + 128];
+static char digest_color[IMC_DIGEST_BUF + 160];
+
+/* =================================================================== */
+/* INTERNALS                                                          */
+/* =================================================================== */
+
+static IMC_DIGEST *imc_digest_find(const char *channel, bool create) {
+    IMC_DIGEST *d;
+
+    for (d = digest_list; d; d = d->next) {
+        if (!strcasecmp(d->channel, channel)) return d;
+    }
+
+    if (!create || !(d = IMC_CREATE(IMC_DIGEST))) return NULL;
+
+    strncpy(d->channel, channel, IMC_MAX_CHANNEL_LEN - 1);
+    d->next = digest_list;
+    digest_list = d;
+    return d;
+}
+
+static IMC_DIGEST_SUB **imc_digest_sub(IMC_DIGEST *d, const char *name) {
+    IMC_DIGEST_SUB **s;
+
+    for (s = &d->subs; *s; s = &(*s)->next) {
+        if (!strcasecmp((*s)->name, name)) return s;
+    }
+    return NULL;
+}
+
+/*
+ * Send the waiting lines to every online subscriber, one write each.
+ * Subscribers are found on character_list, as the line-by-line delivery
+ * that skips them does, so nobody can miss both.
+ */
+static void imc_digest_flush(IMC_DIGEST *d) {
+    CHAR_DATA *ch;
+
+    if (d->count == 0) return;
+
+    snprintf(digest_plain, sizeof(digest_plain), "[%s] %d line%s:\r\n%.*s",
+             d->channel, d->count, d->count == 1 ? "" : "s", d->len, d->lines);
+    snprintf(digest_color, sizeof(digest_color), "%s%s%s",
+             IMC_COLOR_CHANNEL, digest_plain, IMC_COLOR_NORMAL);
+
+    for (ch = character_list; ch; ch = ch->next) {
+        if (IS_NPC(ch) || !imc_digest_sub(d, imc_get_name(ch))) continue;
+
+        imc_send_to_char(ch, PRF_FLAGGED(ch, PRF_COLOR_1) || PRF_FLAGGED(ch, PRF_COLOR_2)
+                             ? digest_color : digest_plain);
+    }
+
+    d->len = 0;
+    d->count = 0;
+}
+
+/* =================================================================== */
+/* PUBLIC INTERFACE                                                   */
+/* =================================================================== */
+
+/*
+ * Switch a player between line-by-line and digest delivery for a channel.
+ * Returns TRUE if the channel is now a digest for them.
+ */
+bool imc_digest_toggle(const char *channel, const char *name) {
+    IMC_DIGEST *d = imc_digest_find(channel, TRUE);
+    IMC_DIGEST_SUB **s, *sub;
+
+    if (!d) return FALSE;
+
+    if ((s = imc_digest_sub(d, name)) != NULL) {
+        sub = *s;
+        *s = sub->next;
+        free(sub);
+        return FALSE;
+    }
+
+    if (!(sub = IMC_CREATE(IMC_DIGEST_SUB))) return FALSE;
+    strncpy(sub->name, name, IMC_MAX_USERNAME_LEN - 1);
+    sub->next = d->subs;
+    d->subs = sub;
+    return TRUE;
+}
+
+/*
+ * Stop a player's digest for a channel, e.g. when they leave it
+ */
+void imc_digest_remove(const char *channel, const char *name) {
+    if (imc_digest_subscribed(channel, name)) {
+        imc_digest_toggle(channel, name);
+    }
+}
+
+bool imc_digest_subscribed(const char *channel, const char *name) {
+    IMC_DIGEST *d = imc_digest_find(channel, FALSE);
+
+    return d && imc_digest_sub(d, name) != NULL;
+}
+
+/*
+ * Queue a channel line for digest subscribers. Returns TRUE if the channel
+ * has any, in which case they must be skipped for line-by-line delivery.
+ */
+bool imc_digest_channel(const char *channel, const char *from_user,
+                        const char *from_mud, const char *message,
+                        const char *action) {
+    IMC_DIGEST *d = imc_digest_find(channel, FALSE);
+    char line[IMC_MAX_MESSAGE_LEN + 128];
+    int len;
+
+    if (!d || !d->subs) return FALSE;
+
+    if (!from_user) from_user = "Someone";
+    if (!from_mud) from_mud = "Unknown";
+
+    if (action && strcmp(action, "join") == 0) {
+        len = snprintf(line, sizeof(line), "  %s@%s has joined the channel.\r\n",
+                       from_user, from_mud);
+    } else if (action && strcmp(action, "leave") == 0) {
+        len = snprintf(line, sizeof(line), "  %s@%s has left the channel.\r\n",
+                       from_user, from_mud);
+    } else {
+        len = snprintf(line, sizeof(line), "  %s@%s: %s\r\n",
+                       from_user, from_mud, message);
+    }
+    if (len >= (int) sizeof(line)) len = sizeof(line) - 1;
+    if (len > IMC_DIGEST_BUF) len = IMC_DIGEST_BUF;
+
+    if (d->len + len > IMC_DIGEST_BUF) {
+        imc_digest_flush(d);
+    }
+
+    if (d->count == 0) d->first = time(NULL);
+    memcpy(d->lines + d->len, line, len);
+    d->len += len;
+    d->count++;
+
+    if (d->count >= IMC_DIGEST_LINES) {
+        imc_digest_flush(d);
+    }
+    return TRUE;
+}
+
+/*
+ * Flush digests whose oldest line has waited IMC_DIGEST_INTERVAL seconds
+ */
+void imc_digest_update(void) {
+    time_t now = time(NULL);
+    IMC_DIGEST *d;
+
+    for (d = digest_list; d; d = d->next) {
+        if (d->count > 0 && now - d->first >= IMC_DIGEST_INTERVAL) {
+            imc_digest_flush(d);
+        }
+    }
+}
+
+void imc_digest_free(void) {
+    IMC_DIGEST *d, *next_d;
+    IMC_DIGEST_SUB *s, *next_s;
+
+    for (d = digest_list; d; d = next_d) {
+        next_d = d->next;
+        for (s = d->subs; s; s = next_s) {
+            next_s = s->next;
+            free(s);
+        }
+        free(d);
+    }
+    digest_list = NULL;
+}
@@ -0,0 +1,446 @@
+/*
+ * MudVault Mesh Live Feed for DikuMUD/Merc
+ *
+ * Streams mesh channel traffic to local viewers, such as a web portal's
+ * backend, as Server-Sent Events on a loopback port. A viewer connects
+ * with "GET /?channels=gossip,ooc" (no channels means all of them) and
+ * receives each channel message as one event whose data is the message
+ * JSON as it came from the gateway. JSON written across several lines is
+ * sent as one "data:" line per line, so the viewer gets the same document
+ * back with each line break as a plain newline.
+ *
+ * Messages are handed over straight from the decoded input buffer: each
+ * viewer that has nothing queued gets them written from there, and only
+ * what its socket will not take right now is copied into its backlog. A
+ * viewer whose backlog reaches IMC_FEED_VIEWER_BUF is dropped, so one
+ * slow viewer never holds up the MUD or the other viewers.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define IMC_FEED_REQUEST_LEN   1024    /* Longest request head we read */
+#define IMC_FEED_FILTER_LEN    256     /* ",chan,chan," filter per viewer */
+#define IMC_FEED_KEEPALIVE     15      /* Seconds between keepalive comments */
+
+/* One local viewer */
+typedef struct imc_feed_viewer {
+    int fd;                            /* -1 when the slot is free */
+    bool streaming;                    /* Request read, events flowing */
+    char filter[IMC_FEED_FILTER_LEN];  /* Lowercased ",chan,chan,", "" for all */
+    char *backlog;                     /* Request head, then unsent event bytes */
+    int backlog_len;
+} IMC_FEED_VIEWER;
+
+static IMC_FEED_VIEWER feed_viewers[IMC_FEED_MAX_VIEWERS];
+static int feed_listener = -1;
+static int feed_viewer_count = 0;
+static time_t feed_last_keepalive = 0;
+
+static const char feed_headers[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static const char feed_bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+/* =================================================================== */
+/* INTERNALS                                                          */
+/* =================================================================== */
+
+static void imc_feed_close(IMC_FEED_VIEWER *v, const char *reason) {
+    if (v->fd < 0) return;
+
+    if (reason) {
+        imc_debug("Feed viewer %d dropped: %s", v->fd, reason);
+    }
+
+    close(v->fd);
+    IMC_FREE(v->backlog);
+    v->fd = -1;
+    v->streaming = FALSE;
+    v->backlog_len = 0;
+    feed_viewer_count--;
+}
+
+/*
+ * Write as much of the backlog as the socket takes
+ */
+static void imc_feed_flush(IMC_FEED_VIEWER *v) {
+    ssize_t sent;
+
+    while (v->backlog_len > 0) {
+        sent = send(v->fd, v->backlog, v->backlog_len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                imc_feed_close(v, strerror(errno));
+            }
+            return;
+        }
+        v->backlog_len -= sent;
+        memmove(v->backlog, v->backlog + sent, v->backlog_len);
+    }
+}
+
+/*
+ * Send an event made of several pieces. With nothing queued it is written
+ * from the pieces themselves; whatever the socket does not take is queued,
+ * and a viewer that cannot queue it is dropped.
+ */
+static void imc_feed_send(IMC_FEED_VIEWER *v, struct iovec *iov, int count) {
+    struct msghdr msg;
+    ssize_t sent = 0;
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+
+    if (v->backlog_len == 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        do {
+            sent = sendmsg(v->fd, &msg, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                imc_feed_close(v, strerror(errno));
+                return;
+            }
+            sent = 0;
+        }
+        if ((size_t) sent == total) return;
+    }
+
+    if (v->backlog_len + (total - sent) > IMC_FEED_VIEWER_BUF) {
+        imc_feed_close(v, "too slow");
+        return;
+    }
+
+    /* Queue the unsent tail */
+    for (i = 0; i < count; i++) {
+        if ((size_t) sent >= iov[i].iov_len) {
+            sent -= iov[i].iov_len;
+            continue;
+        }
+        memcpy(v->backlog + v->backlog_len, (char *) iov[i].iov_base + sent,
+               iov[i].iov_len - sent);
+        v->backlog_len += iov[i].iov_len - sent;
+        sent = 0;
+    }
+}
+
+/*
+ * Build the viewer's channel filter from "channels=a,b" in the request line
+ */
+static void imc_feed_filter(IMC_FEED_VIEWER *v, const char *line) {
+    const char *p = strstr(line, "channels=");
+    int len = 0;
+
+    v->filter[0] = '\0';
+    if (!p) return;
+
+    v->filter[len++] = ',';
+    for (p += 9; *p && *p != '&' && *p != ' ' && len < IMC_FEED_FILTER_LEN - 2; p++) {
+        if (isalnum((unsigned char) *p) || *p == '-' || *p == '_' || *p == ',') {
+            v->filter[len++] = tolower((unsigned char) *p);
+        }
+    }
+    v->filter[len++] = ',';
+    v->filter[len] = '\0';
+
+    /* "channels=" with nothing after it means every channel */
+    if (len == 2) v->filter[0] = '\0';
+}
+
+static bool imc_feed_wants(IMC_FEED_VIEWER *v, const char *channel) {
+    char key[IMC_MAX_CHANNEL_LEN + 3];
+    int i;
+
+    if (!v->filter[0]) return TRUE;
+
+    key[0] = ',';
+    for (i = 0; channel[i] && i < IMC_MAX_CHANNEL_LEN; i++) {
+        key[i + 1] = tolower((unsigned char) channel[i]);
+    }
+    key[i + 1] = ',';
+    key[i + 2] = '\0';
+
+    return strstr(v->filter, key) != NULL;
+}
+
+/*
+ * Read a new viewer's request head and start its stream
+ */
+static void imc_feed_read_request(IMC_FEED_VIEWER *v) {
+    ssize_t got;
+    char *eol;
+
+    got = recv(v->fd, v->backlog + v->backlog_len,
+               IMC_FEED_REQUEST_LEN - 1 - v->backlog_len, 0);
+    if (got == 0) {
+        imc_feed_close(v, NULL);
+        return;
+    }
+    if (got < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            imc_feed_close(v, strerror(errno));
+        }
+        return;
+    }
+
+    v->backlog_len += got;
+    v->backlog[v->backlog_len] = '\0';
+
+    if (!strstr(v->backlog, "\r\n\r\n") && !strstr(v->backlog, "\n\n")) {
+        if (v->backlog_len >= IMC_FEED_REQUEST_LEN - 1) {
+            send(v->fd, feed_bad_request, sizeof(feed_bad_request) - 1, MSG_NOSIGNAL);
+            imc_feed_close(v, "request too long");
+        }
+        return;
+    }
+
+    if (strncmp(v->backlog, "GET ", 4) != 0) {
+        send(v->fd, feed_bad_request, sizeof(feed_bad_request) - 1, MSG_NOSIGNAL);
+        imc_feed_close(v, "not a GET");
+        return;
+    }
+
+    if ((eol = strchr(v->backlog, '\n')) != NULL) *eol = '\0';
+    imc_feed_filter(v, v->backlog);
+
+    /* The buffer now holds unsent event bytes */
+    v->backlog_len = 0;
+    v->streaming = TRUE;
+    {
+        struct iovec iov = { (void *) feed_headers, sizeof(feed_headers) - 1 };
+        imc_feed_send(v, &iov, 1);
+    }
+}
+
+/*
+ * Streaming viewers send nothing we need; reading tells us when they leave
+ */
+static void imc_feed_drain(IMC_FEED_VIEWER *v) {
+    char scratch[256];
+    ssize_t got;
+
+    while ((got = recv(v->fd, scratch, sizeof(scratch), 0)) > 0)
+        ;
+
+    if (got == 0) {
+        imc_feed_close(v, NULL);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        imc_feed_close(v, strerror(errno));
+    }
+}
+
+static void imc_feed_accept(void) {
+    IMC_FEED_VIEWER *v = NULL;
+    int fd, i;
+
+    while ((fd = accept(feed_listener, NULL, NULL)) >= 0) {
+        for (i = 0; i < IMC_FEED_MAX_VIEWERS; i++) {
+            if (feed_viewers[i].fd < 0) {
+                v = &feed_viewers[i];
+                break;
+            }
+        }
+
+        if (!v || !(v->backlog = malloc(IMC_FEED_VIEWER_BUF + 1))) {
+            imc_debug("Feed viewer refused, %d already connected", feed_viewer_count);
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        v->fd = fd;
+        v->streaming = FALSE;
+        v->backlog_len = 0;
+        v->filter[0] = '\0';
+        feed_viewer_count++;
+        v = NULL;
+    }
+}
+
+/* =================================================================== */
+/* PUBLIC INTERFACE                                                   */
+/* =================================================================== */
+
+/*
+ * Listen for viewers on the loopback interface, if a port is configured
+ */
+void imc_feed_start(void) {
+    struct sockaddr_in addr;
+    int one = 1, i;
+
+    for (i = 0; i < IMC_FEED_MAX_VIEWERS; i++) {
+        feed_viewers[i].fd = -1;
+        feed_viewers[i].backlog = NULL;
+    }
+
+    if (IMC_FEED_PORT <= 0 || feed_listener >= 0) return;
+
+    if ((feed_listener = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        imc_log("Could not create feed socket: %s", strerror(errno));
+        return;
+    }
+
+    setsockopt(feed_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(IMC_FEED_PORT);
+
+    if (bind(feed_listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(feed_listener, 16) < 0) {
+        imc_log("Could not listen for feed viewers on port %d: %s",
+                IMC_FEED_PORT, strerror(errno));
+        close(feed_listener);
+        feed_listener = -1;
+        return;
+    }
+
+    fcntl(feed_listener, F_SETFL, fcntl(feed_listener, F_GETFL, 0) | O_NONBLOCK);
+    imc_log("Live feed listening on 127.0.0.1:%d", IMC_FEED_PORT);
+}
+
+/*
+ * Accept viewers, read their requests, flush backlogs and keep idle
+ * streams open. Call once per loop.
+ */
+void imc_feed_update(void) {
+    static const char keepalive[] = ": keepalive\n\n";
+    time_t now = time(NULL);
+    bool ping;
+    int i;
+
+    if (feed_listener < 0) return;
+
+    imc_feed_accept();
+
+    ping = now - feed_last_keepalive >= IMC_FEED_KEEPALIVE;
+    if (ping) feed_last_keepalive = now;
+
+    for (i = 0; i < IMC_FEED_MAX_VIEWERS; i++) {
+        IMC_FEED_VIEWER *v = &feed_viewers[i];
+
+        if (v->fd < 0) continue;
+
+        if (!v->streaming) {
+            imc_feed_read_request(v);
+            continue;
+        }
+
+        imc_feed_drain(v);
+        if (v->fd >= 0) imc_feed_flush(v);
+        if (v->fd >= 0 && ping) {
+            struct iovec iov = { (void *) keepalive, sizeof(keepalive) - 1 };
+            imc_feed_send(v, &iov, 1);
+        }
+    }
+}
+
+/*
+ * Render a message holding line breaks as one "data: " field per line,
+ * the way SSE carries multi-line data. Returns a fresh allocation.
+ */
+static char *imc_feed_lines(const char *json, int len, int *out_len) {
+    char *event = malloc(len * 7 + 8);
+    int i, n;
+
+    if (!event) return NULL;
+
+    memcpy(event, "data: ", 6);
+    n = 6;
+    for (i = 0; i < len; i++) {
+        if (json[i] == '\r' || json[i] == '\n') {
+            if (json[i] == '\r' && i + 1 < len && json[i + 1] == '\n') i++;
+            memcpy(event + n, "\ndata: ", 7);
+            n += 7;
+        } else {
+            event[n++] = json[i];
+        }
+    }
+    memcpy(event + n, "\n\n", 2);
+    *out_len = n + 2;
+    return event;
+}
+
+/*
+ * Stream one channel message to the viewers following its channel. json
+ * is the message as received, and need only stay valid for this call.
+ */
+void imc_feed_publish(const char *channel, const char *json, int len) {
+    struct iovec iov[3];
+    char *event = NULL;
+    int count = 3, event_len;
+    int i;
+
+    if (feed_viewer_count == 0 || !channel || !json) return;
+
+    if (memchr(json, '\n', len) || memchr(json, '\r', len)) {
+        if (!(event = imc_feed_lines(json, len, &event_len))) return;
+        iov[0].iov_base = event;
+        iov[0].iov_len = event_len;
+        count = 1;
+    } else {
+        iov[0].iov_base = "data: ";
+        iov[0].iov_len = 6;
+        iov[1].iov_base = (void *) json;
+        iov[1].iov_len = len;
+        iov[2].iov_base = "\n\n";
+        iov[2].iov_len = 2;
+    }
+
+    for (i = 0; i < IMC_FEED_MAX_VIEWERS; i++) {
+        IMC_FEED_VIEWER *v = &feed_viewers[i];
+
+        if (v->fd >= 0 && v->streaming && imc_feed_wants(v, channel)) {
+            imc_feed_send(v, iov, count);
+        }
+    }
+
+    IMC_FREE(event);
+}
+
+/*
+ * Close every viewer and stop listening
+ */
+void imc_feed_stop(void) {
+    int i;
+
+    for (i = 0; i < IMC_FEED_MAX_VIEWERS; i++) {
+        imc_feed_close(&feed_viewers[i], NULL);
+    }
+
+    if (feed_listener >= 0) {
+        close(feed_listener);
+        feed_listener = -1;
+    }
+}
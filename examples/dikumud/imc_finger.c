@@ -0,0 +1,323 @@
+/*
+ * MudVault Mesh Finger Records for DikuMUD/Merc
+ *
+ * Answers other MUDs' finger requests for our players. The MUD hands us a
+ * player's IMC_USER_INFO whenever it changes (at login, on save, ...); we
+ * serialize it once and append it to IMC_FINGER_FILE only if it differs
+ * from what we already have. In memory each known player costs a name, a
+ * file offset and a hash; the serialized record is read from the file the
+ * first time that player is fingered and kept, so repeat requests are a
+ * hash lookup and a copy. Player files are never touched.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+#define IMC_FINGER_BUCKETS     512
+#define IMC_FINGER_JSON_LEN    2048    /* Serialized IMC_USER_INFO, escaped */
+#define IMC_FINGER_LINE_LEN    (IMC_MAX_USERNAME_LEN + IMC_FINGER_JSON_LEN + 4)
+
+/* One player known to the finger index */
+typedef struct imc_finger {
+    char name[IMC_MAX_USERNAME_LEN];   /* Lowercased */
+    long offset;                       /* Latest record in IMC_FINGER_FILE, -1 if unsaved */
+    unsigned int hash;                 /* Of the serialized record */
+    char *json;                        /* Serialized record, NULL until needed */
+    struct imc_finger *next;           /* Hash chain */
+} IMC_FINGER;
+
+static IMC_FINGER *finger_table[IMC_FINGER_BUCKETS];
+static FILE *finger_fp = NULL;
+static int finger_count = 0;
+
+/* =================================================================== */
+/* INTERNALS                                                          */
+/* =================================================================== */
+
+/*
+ * FNV-1a hash of a string
+ */
+static unsigned int imc_finger_fnv(const char *str) {
+    unsigned int hash = 2166136261u;
+
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void imc_finger_key(char *key, const char *name) {
+    int i;
+
+    for (i = 0; name[i] && i < IMC_MAX_USERNAME_LEN - 1; i++) {
+        key[i] = tolower((unsigned char)name[i]);
+    }
+    key[i] = '\0';
+}
+
+/*
+ * Find a player's record, optionally creating it
+ */
+static IMC_FINGER *imc_finger_find(const char *name, bool create) {
+    char key[IMC_MAX_USERNAME_LEN];
+    unsigned int bucket;
+    IMC_FINGER *f;
+
+    imc_finger_key(key, name);
+    bucket = imc_finger_fnv(key) % IMC_FINGER_BUCKETS;
+
+    for (f = finger_table[bucket]; f; f = f->next) {
+        if (strcmp(f->name, key) == 0) return f;
+    }
+
+    if (!create) return NULL;
+
+    f = IMC_CREATE(IMC_FINGER);
+    if (!f) return NULL;
+
+    strcpy(f->name, key);
+    f->offset = -1;
+    f->next = finger_table[bucket];
+    finger_table[bucket] = f;
+    finger_count++;
+    return f;
+}
+
+/*
+ * Append ,"key":"value" for a non-empty string
+ */
+static void imc_finger_add(char *buf, int *len, const char *key, const char *value) {
+    char *escaped;
+
+    if (!value || !*value || *len >= IMC_FINGER_JSON_LEN) return;
+
+    escaped = imc_escape_json(value);
+    *len += snprintf(buf + *len, IMC_FINGER_JSON_LEN - *len, ",\"%s\":\"%s\"", key, escaped);
+    free(escaped);
+}
+
+/*
+ * Serialize a record. Returns FALSE if it does not fit.
+ */
+static bool imc_finger_serialize(const IMC_USER_INFO *info, char *buf) {
+    char *username = imc_escape_json(info->username);
+    char lastlogin[32];
+    int len;
+
+    len = snprintf(buf, IMC_FINGER_JSON_LEN, "{\"username\":\"%s\",\"level\":\"%d\"",
+                   username, info->level);
+    free(username);
+
+    imc_finger_add(buf, &len, "displayName", info->displayName);
+    imc_finger_add(buf, &len, "realName", info->realName);
+    imc_finger_add(buf, &len, "email", info->email);
+    imc_finger_add(buf, &len, "plan", info->plan);
+    imc_finger_add(buf, &len, "location", info->location);
+    imc_finger_add(buf, &len, "race", info->race);
+    imc_finger_add(buf, &len, "class", info->class);
+    imc_finger_add(buf, &len, "guild", info->guild);
+
+    if (info->lastLogin > 0) {
+        strftime(lastlogin, sizeof(lastlogin), "%Y-%m-%dT%H:%M:%SZ", gmtime(&info->lastLogin));
+        imc_finger_add(buf, &len, "lastLogin", lastlogin);
+    }
+
+    if (len + 2 > IMC_FINGER_JSON_LEN) return FALSE;
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return TRUE;
+}
+
+/*
+ * Write "name\tjson" to fp, returning the line's offset or -1
+ */
+static long imc_finger_write(FILE *fp, const char *name, const char *json) {
+    long offset;
+
+    if (!fp || fseek(fp, 0, SEEK_END) != 0 || (offset = ftell(fp)) < 0) return -1;
+    if (fprintf(fp, "%s\t%s\n", name, json) < 0) return -1;
+    return offset;
+}
+
+/*
+ * Read the record at offset into a fresh allocation
+ */
+static char *imc_finger_read(FILE *fp, long offset) {
+    char line[IMC_FINGER_LINE_LEN];
+    char *json;
+
+    if (!fp || offset < 0 || fseek(fp, offset, SEEK_SET) != 0) return NULL;
+    if (!fgets(line, sizeof(line), fp)) return NULL;
+
+    line[strcspn(line, "\n")] = '\0';
+    if (!(json = strchr(line, '\t'))) return NULL;
+    return strdup(json + 1);
+}
+
+/* =================================================================== */
+/* PUBLIC INTERFACE                                                   */
+/* =================================================================== */
+
+/*
+ * Index IMC_FINGER_FILE, keeping the latest record per player, and
+ * rewrite it without the superseded ones.
+ */
+void imc_finger_load(void) {
+    char line[IMC_FINGER_LINE_LEN];
+    char tmpfile[256];
+    FILE *fp, *out;
+    IMC_FINGER *f;
+    char *tab;
+    long offset;
+    int i;
+
+    if ((fp = fopen(IMC_FINGER_FILE, "r")) != NULL) {
+        for (offset = ftell(fp); fgets(line, sizeof(line), fp); offset = ftell(fp)) {
+            line[strcspn(line, "\n")] = '\0';
+            if (!(tab = strchr(line, '\t'))) continue;
+            *tab = '\0';
+
+            if ((f = imc_finger_find(line, TRUE)) != NULL) {
+                f->offset = offset;
+                f->hash = imc_finger_fnv(tab + 1);
+            }
+        }
+
+        /* Compact down to the latest record per player */
+        snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", IMC_FINGER_FILE);
+        if ((out = fopen(tmpfile, "w")) != NULL) {
+            for (i = 0; i < IMC_FINGER_BUCKETS; i++) {
+                for (f = finger_table[i]; f; f = f->next) {
+                    char *json = imc_finger_read(fp, f->offset);
+
+                    f->offset = json ? imc_finger_write(out, f->name, json) : -1;
+                    free(json);
+                }
+            }
+            fclose(out);
+            rename(tmpfile, IMC_FINGER_FILE);
+        }
+        fclose(fp);
+    }
+
+    finger_fp = fopen(IMC_FINGER_FILE, "a+");
+    if (!finger_fp) {
+        imc_log("Could not open finger file %s: %s", IMC_FINGER_FILE, strerror(errno));
+    }
+
+    imc_log("Indexed %d finger records", finger_count);
+}
+
+/*
+ * Record a player's finger information. Call whenever any of it changes;
+ * an unchanged record costs one serialization and a hash compare.
+ */
+void imc_finger_update(const IMC_USER_INFO *info) {
+    char json[IMC_FINGER_JSON_LEN];
+    IMC_FINGER *f;
+    unsigned int hash;
+
+    if (!info || !*info->username) return;
+
+    if (!imc_finger_serialize(info, json)) {
+        imc_log("Finger record for %s is too large", info->username);
+        return;
+    }
+
+    hash = imc_finger_fnv(json);
+    if (!(f = imc_finger_find(info->username, TRUE))) return;
+    if (f->offset >= 0 && f->hash == hash) return;
+
+    IMC_FREE(f->json);
+    f->json = strdup(json);
+    f->hash = hash;
+    f->offset = imc_finger_write(finger_fp, f->name, json);
+    if (finger_fp) fflush(finger_fp);
+}
+
+/*
+ * Answer a finger request from another MUD for one of our players
+ */
+void imc_finger_reply(const char *to_mud, const char *to_user, const char *name) {
+    char uuid[IMC_UUID_LEN];
+    char info[64];
+    IMC_FINGER *f;
+    char *mud, *user, *target, *reply;
+    size_t size;
+    int idle;
+
+    if (!to_mud || !name || !IMC_IS_CONNECTED()) return;
+
+    /* Read from disk the first time this player is fingered, then keep it */
+    if ((f = imc_finger_find(name, FALSE)) != NULL && !f->json) {
+        f->json = imc_finger_read(finger_fp, f->offset);
+    }
+
+    /* Idle time is not stored; online players get theirs spliced in live */
+    info[0] = '\0';
+    if (f && f->json) {
+        if ((idle = imc_who_idle(name)) >= 0) {
+            snprintf(info, sizeof(info), ",\"info\":{\"idle\":%d,", idle);
+        } else {
+            strcpy(info, ",\"info\":{");
+        }
+    }
+
+    mud = imc_escape_json(to_mud);
+    user = to_user ? imc_escape_json(to_user) : NULL;
+    target = imc_escape_json(name);
+
+    size = (f && f->json ? strlen(f->json) : 0) + strlen(mud) + strlen(target) +
+           (user ? strlen(user) : 0) + 512;
+    if ((reply = malloc(size)) != NULL) {
+        snprintf(reply, size,
+                 "{\"version\":\"%s\",\"id\":\"%s\",\"timestamp\":\"%s\",\"type\":\"finger\","
+                 "\"from\":{\"mud\":\"%s\"},\"to\":{\"mud\":\"%s\"%s%s%s},"
+                 "\"payload\":{\"user\":\"%s\",\"request\":false%s%s},"
+                 "\"metadata\":{\"priority\":%d,\"ttl\":%d,\"encoding\":\"utf-8\",\"language\":\"en\"}}",
+                 IMC_PROTOCOL_VERSION, imc_generate_uuid(uuid), imc_get_timestamp(),
+                 IMC_MUD_NAME, mud,
+                 user ? ",\"user\":\"" : "", user ? user : "", user ? "\"" : "",
+                 target,
+                 info, f && f->json ? f->json + 1 : "",
+                 IMC_MESSAGE_PRIORITY, IMC_MESSAGE_TTL);
+        imc_send_message(reply);
+        free(reply);
+    }
+
+    free(mud);
+    if (user) free(user);
+    free(target);
+}
+
+/*
+ * Free the index
+ */
+void imc_finger_free(void) {
+    IMC_FINGER *f, *next;
+    int i;
+
+    for (i = 0; i < IMC_FINGER_BUCKETS; i++) {
+        for (f = finger_table[i]; f; f = next) {
+            next = f->next;
+            free(f->json);
+            free(f);
+        }
+        finger_table[i] = NULL;
+    }
+    finger_count = 0;
+
+    if (finger_fp) {
+        fclose(finger_fp);
+        finger_fp = NULL;
+    }
+}
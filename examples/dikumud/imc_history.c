@@ -0,0 +1,1149 @@
+/*
+ * MudVault Mesh Message History for DikuMUD/Merc
+ *
+ * This file keeps the tell/channel/emote history in deflated blocks,
+ * persists it to IMC_HISTORY_FILE and maintains an inverted index over
+ * it so that 'imchistory search' never has to scan the log.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "interpreter.h"
+#include "handler.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+#include <zlib.h>                 /* Link with -lz */
+
+/* Longest token we index; field tokens carry a two character prefix */
+#define IMC_INDEX_TOKEN_LEN    (IMC_MAX_USERNAME_LEN + 8)
+
+/* Maximum number of terms in one search query */
+#define IMC_SEARCH_MAX_TERMS   16
+
+/*
+ * Posting list for one token. Sequence numbers are stored as varints,
+ * the first one absolute and every following one as the delta to the
+ * previous entry, so a list costs about one byte per message.
+ */
+typedef struct imc_posting {
+    char token[IMC_INDEX_TOKEN_LEN];
+    unsigned char *data;
+    int len;
+    int size;
+    long first;                    /* First sequence number in the list */
+    long last;                     /* Last sequence number in the list */
+    struct imc_posting *next;      /* Hash chain */
+} IMC_POSTING;
+
+static IMC_POSTING *index_table[IMC_INDEX_BUCKETS];
+static FILE *history_fp = NULL;
+
+static void imc_history_compact(void);
+
+/* =================================================================== */
+/* INDEX INTERNALS                                                    */
+/* =================================================================== */
+
+/*
+ * FNV-1a hash of a token
+ */
+static unsigned int imc_index_hash(const char *token) {
+    unsigned int hash = 2166136261u;
+
+    while (*token) {
+        hash ^= (unsigned char)*token++;
+        hash *= 16777619u;
+    }
+
+    return hash % IMC_INDEX_BUCKETS;
+}
+
+/*
+ * Find a posting list, optionally creating it
+ */
+static IMC_POSTING *imc_index_find(const char *token, bool create) {
+    unsigned int bucket = imc_index_hash(token);
+    IMC_POSTING *p;
+
+    for (p = index_table[bucket]; p; p = p->next) {
+        if (strcmp(p->token, token) == 0) return p;
+    }
+
+    if (!create) return NULL;
+
+    p = IMC_CREATE(IMC_POSTING);
+    if (!p) return NULL;
+
+    strncpy(p->token, token, IMC_INDEX_TOKEN_LEN - 1);
+    p->next = index_table[bucket];
+    index_table[bucket] = p;
+    return p;
+}
+
+/*
+ * Append a varint to a posting list
+ */
+static bool imc_posting_put(IMC_POSTING *p, unsigned long value) {
+    if (p->len + 10 > p->size) {
+        int new_size = p->size ? p->size * 2 : 16;
+        unsigned char *data = realloc(p->data, new_size);
+
+        if (!data) return FALSE;
+        p->data = data;
+        p->size = new_size;
+    }
+
+    while (value >= 0x80) {
+        p->data[p->len++] = (unsigned char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    p->data[p->len++] = (unsigned char)value;
+    return TRUE;
+}
+
+/*
+ * Decode a posting list into out[], keeping sequence numbers in [lo, hi]
+ */
+static int imc_posting_decode(const IMC_POSTING *p, long lo, long hi,
+                             long *out, int max) {
+    unsigned long value;
+    long seq = 0;
+    int pos = 0, shift, count = 0;
+
+    while (pos < p->len && count < max) {
+        value = 0;
+        shift = 0;
+        while (pos < p->len) {
+            unsigned char byte = p->data[pos++];
+            value |= (unsigned long)(byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+
+        seq = (seq == 0) ? (long)value : seq + (long)value;
+        if (seq > hi) break;
+        if (seq >= lo) out[count++] = seq;
+    }
+
+    return count;
+}
+
+/*
+ * Add a message to the posting list of one token
+ */
+static void imc_index_add_token(const char *token, long seq) {
+    IMC_POSTING *p;
+
+    if (!*token) return;
+
+    p = imc_index_find(token, TRUE);
+    if (!p || p->last == seq) return;    /* Token repeated in this message */
+
+    if (p->len == 0) {
+        if (imc_posting_put(p, (unsigned long)seq)) p->first = seq;
+    } else {
+        imc_posting_put(p, (unsigned long)(seq - p->last));
+    }
+    p->last = seq;
+}
+
+/*
+ * Build a "x:value" field token, lowercased
+ */
+static void imc_index_field_token(char *out, char prefix, const char *value,
+                                 int len) {
+    int i = 0;
+
+    out[i++] = prefix;
+    out[i++] = ':';
+    while (len-- > 0 && *value && i < IMC_INDEX_TOKEN_LEN - 1) {
+        out[i++] = tolower((unsigned char)*value++);
+    }
+    out[i] = '\0';
+}
+
+/*
+ * Index a "user@mud" (or bare local user) under the given prefixes
+ */
+static void imc_index_address(const char *addr, char user_prefix,
+                             char mud_prefix, long seq) {
+    char token[IMC_INDEX_TOKEN_LEN];
+    const char *at;
+
+    if (!addr || !*addr) return;
+
+    at = strchr(addr, '@');
+    imc_index_field_token(token, user_prefix, addr,
+                         at ? (int)(at - addr) : (int)strlen(addr));
+    imc_index_add_token(token, seq);
+
+    if (mud_prefix) {
+        const char *mud = at ? at + 1 : IMC_MUD_NAME;
+        imc_index_field_token(token, mud_prefix, mud, (int)strlen(mud));
+        imc_index_add_token(token, seq);
+    }
+}
+
+/*
+ * Split text into lowercase alphanumeric words and hand each to the
+ * callback. Words shorter than two characters are not worth indexing.
+ */
+static int imc_tokenize(const char *text,
+                       void (*emit)(const char *, void *), void *arg) {
+    char word[IMC_INDEX_TOKEN_LEN];
+    int len = 0, words = 0;
+
+    for (;; text++) {
+        if (*text && isalnum((unsigned char)*text)) {
+            if (len < IMC_INDEX_TOKEN_LEN - 1) {
+                word[len++] = tolower((unsigned char)*text);
+            }
+            continue;
+        }
+
+        if (len >= 2) {
+            word[len] = '\0';
+            emit(word, arg);
+            words++;
+        }
+        len = 0;
+
+        if (!*text) break;
+    }
+
+    return words;
+}
+
+static void imc_index_emit_word(const char *word, void *arg) {
+    imc_index_add_token(word, *(long *)arg);
+}
+
+/*
+ * Index every searchable field of a history entry
+ */
+static void imc_index_entry(const IMC_HISTORY *h) {
+    char token[IMC_INDEX_TOKEN_LEN];
+    long seq = h->seq;
+
+    switch (h->type) {
+        case IMC_MSG_TELL:
+            imc_index_add_token("t:tell", seq);
+            imc_index_address(h->to, 'r', 0, seq);
+            break;
+        case IMC_MSG_CHANNEL:
+            imc_index_add_token("t:channel", seq);
+            imc_index_field_token(token, 'c', h->to, (int)strlen(h->to));
+            imc_index_add_token(token, seq);
+            break;
+        case IMC_MSG_EMOTE:
+        case IMC_MSG_EMOTETO:
+            imc_index_add_token("t:emote", seq);
+            break;
+        default:
+            break;
+    }
+
+    imc_index_address(h->from, 'u', 'm', seq);
+    imc_tokenize(h->message, imc_index_emit_word, &seq);
+}
+
+/*
+ * Drop sequence numbers older than min_seq. Lists that become empty are
+ * freed; the rest are re-encoded with a new absolute base.
+ */
+static void imc_index_compact(long min_seq) {
+    IMC_POSTING *p, *next, **prev;
+    long *seqs, max = imc_data->history_seq - min_seq + 1;
+    int i, bucket, count;
+
+    if (max <= 0 || !(seqs = malloc(sizeof(long) * max))) return;
+
+    for (bucket = 0; bucket < IMC_INDEX_BUCKETS; bucket++) {
+        prev = &index_table[bucket];
+        for (p = *prev; p; p = next) {
+            next = p->next;
+
+            if (p->first >= min_seq) {
+                prev = &p->next;
+                continue;
+            }
+
+            count = imc_posting_decode(p, min_seq, p->last, seqs, (int)max);
+            if (count == 0) {
+                *prev = next;
+                IMC_FREE(p->data);
+                free(p);
+                continue;
+            }
+
+            p->len = 0;
+            imc_posting_put(p, (unsigned long)seqs[0]);
+            for (i = 1; i < count; i++) {
+                imc_posting_put(p, (unsigned long)(seqs[i] - seqs[i - 1]));
+            }
+            p->first = seqs[0];
+            prev = &p->next;
+        }
+    }
+
+    free(seqs);
+}
+
+/*
+ * Free the whole index
+ */
+static void imc_index_free(void) {
+    IMC_POSTING *p, *next;
+    int bucket;
+
+    for (bucket = 0; bucket < IMC_INDEX_BUCKETS; bucket++) {
+        for (p = index_table[bucket]; p; p = next) {
+            next = p->next;
+            IMC_FREE(p->data);
+            free(p);
+        }
+        index_table[bucket] = NULL;
+    }
+}
+
+/* =================================================================== */
+/* HISTORY BLOCKS                                                     */
+/* =================================================================== */
+
+/*
+ * Entries are packed into the open block as records:
+ *
+ *     type byte, varint seconds since the block's first entry,
+ *     then from, to and message as NUL-terminated strings
+ *
+ * A full block is sealed and deflated and a new one opened. Once there
+ * are IMC_HISTORY_BLOCKS sealed blocks the oldest is dropped. Reads
+ * inflate a sealed block into a small LRU cache and note where each
+ * record starts, so paging through history costs one inflate per block.
+ */
+
+/* Most records a block can hold: type, one varint byte, three empty strings */
+#define IMC_HISTORY_BLOCK_RECORDS  (IMC_HISTORY_BLOCK_SIZE / 5 + 1)
+
+typedef struct imc_history_block {
+    unsigned char *data;           /* Deflated records, NULL while open */
+    int len;                       /* Bytes in data */
+    int raw_len;                   /* Bytes of records */
+    bool deflated;                 /* FALSE if deflating did not help */
+    long first_seq;
+    int count;
+    time_t first_time;
+    time_t last_time;
+} IMC_HISTORY_BLOCK;
+
+/* A block's records, laid out for random access */
+typedef struct imc_history_raw {
+    long block;                    /* Block number held, -1 if none */
+    unsigned char *data;
+    unsigned short *offsets;       /* Where each record starts */
+    unsigned long used;            /* For LRU eviction */
+} IMC_HISTORY_RAW;
+
+static IMC_HISTORY_BLOCK history_blocks[IMC_HISTORY_BLOCKS + 1];
+static long block_first = 0;       /* Oldest block held */
+static long block_open = -1;       /* Block taking appends, -1 until loaded */
+static IMC_HISTORY_RAW open_raw;
+static IMC_HISTORY_RAW history_cache[IMC_HISTORY_CACHE];
+static unsigned long cache_clock = 0;
+static time_t history_last = 0;    /* Newest timestamp stored */
+static long log_first = 0;         /* Oldest block in the log when it was last compacted */
+
+#define IMC_HISTORY_BLOCK(n)  (&history_blocks[(n) % (IMC_HISTORY_BLOCKS + 1)])
+
+static bool imc_history_ready(void) {
+    return imc_data && block_open >= 0;
+}
+
+/*
+ * Oldest sequence number still held
+ */
+static long imc_history_oldest(void) {
+    long oldest = IMC_HISTORY_BLOCK(block_first)->first_seq;
+    return oldest > 1 ? oldest : 1;
+}
+
+/*
+ * Number of entries held
+ */
+static long imc_history_held(void) {
+    return imc_data->history_seq - imc_history_oldest() + 1;
+}
+
+static int imc_varint_put(unsigned char *p, unsigned long value) {
+    int n = 0;
+
+    while (value >= 0x80) {
+        p[n++] = (unsigned char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (unsigned char)value;
+    return n;
+}
+
+static unsigned long imc_varint_get(const unsigned char **p) {
+    unsigned long value = 0;
+    int shift = 0;
+
+    while (**p & 0x80) {
+        value |= (unsigned long)(*(*p)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (unsigned long)*(*p)++ << shift;
+    return value;
+}
+
+/*
+ * Fill a history view from the record at p
+ */
+static void imc_history_decode(IMC_HISTORY *h, const IMC_HISTORY_BLOCK *b,
+                              const unsigned char *p) {
+    h->type = (imc_msg_type_t)*p++;
+    h->timestamp = b->first_time + (time_t)imc_varint_get(&p);
+    h->from = (const char *)p;
+    h->to = h->from + strlen(h->from) + 1;
+    h->message = h->to + strlen(h->to) + 1;
+}
+
+/*
+ * Allocate the buffers a block layout needs
+ */
+static bool imc_history_raw_alloc(IMC_HISTORY_RAW *raw) {
+    raw->block = -1;
+    raw->data = malloc(IMC_HISTORY_BLOCK_SIZE);
+    raw->offsets = malloc(sizeof(unsigned short) * IMC_HISTORY_BLOCK_RECORDS);
+    return raw->data && raw->offsets;
+}
+
+static void imc_history_raw_free(IMC_HISTORY_RAW *raw) {
+    IMC_FREE(raw->data);
+    IMC_FREE(raw->offsets);
+    raw->block = -1;
+}
+
+/*
+ * Drop the oldest block and everything the index holds for it
+ */
+static void imc_history_drop_block(void) {
+    int i;
+
+    IMC_FREE(IMC_HISTORY_BLOCK(block_first)->data);
+    for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+        if (history_cache[i].block == block_first) history_cache[i].block = -1;
+    }
+    block_first++;
+
+    imc_index_compact(imc_history_oldest());
+}
+
+static void imc_history_open_block(void) {
+    IMC_HISTORY_BLOCK *b;
+
+    if (++block_open - block_first > IMC_HISTORY_BLOCKS) {
+        imc_history_drop_block();
+    }
+
+    b = IMC_HISTORY_BLOCK(block_open);
+    memset(b, 0, sizeof(*b));
+    b->first_seq = imc_data->history_seq + 1;
+    open_raw.block = block_open;
+
+    /*
+     * Once a whole window of blocks has rolled out of memory the log holds
+     * about twice what is kept, so rewrite it. Not while loading, since
+     * the log is still being read then.
+     */
+    if (history_fp && block_first - log_first >= IMC_HISTORY_BLOCKS) {
+        imc_history_compact();
+    }
+}
+
+/*
+ * Deflate the open block. Its records are still laid out, so they swap
+ * into the cache in place of the least recently used block.
+ */
+static void imc_history_seal_block(void) {
+    IMC_HISTORY_BLOCK *b = IMC_HISTORY_BLOCK(block_open);
+    IMC_HISTORY_RAW *slot = &history_cache[0], swap;
+    uLongf len = compressBound(b->raw_len);
+    unsigned char *data = malloc(len);
+    int i;
+
+    if (data && compress2(data, &len, open_raw.data, b->raw_len, Z_BEST_SPEED) == Z_OK &&
+        len < (uLongf)b->raw_len) {
+        b->data = realloc(data, len);
+        if (!b->data) b->data = data;
+        b->len = (int)len;
+        b->deflated = TRUE;
+    } else {
+        IMC_FREE(data);
+        if ((b->data = malloc(b->raw_len)) != NULL) {
+            memcpy(b->data, open_raw.data, b->raw_len);
+        }
+        b->len = b->raw_len;
+        b->deflated = FALSE;
+    }
+
+    for (i = 1; i < IMC_HISTORY_CACHE; i++) {
+        if (history_cache[i].used < slot->used) slot = &history_cache[i];
+    }
+    swap = *slot;
+    *slot = open_raw;
+    slot->used = ++cache_clock;
+    open_raw = swap;
+}
+
+/*
+ * Get a block's records laid out, inflating it if it is not cached
+ */
+static IMC_HISTORY_RAW *imc_history_raw(long n) {
+    IMC_HISTORY_BLOCK *b = IMC_HISTORY_BLOCK(n);
+    IMC_HISTORY_RAW *slot = &history_cache[0];
+    const unsigned char *p;
+    uLongf len = IMC_HISTORY_BLOCK_SIZE;
+    int i;
+
+    if (n == block_open) return &open_raw;
+
+    for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+        if (history_cache[i].block == n) {
+            history_cache[i].used = ++cache_clock;
+            return &history_cache[i];
+        }
+        if (history_cache[i].used < slot->used) slot = &history_cache[i];
+    }
+
+    if (!b->data) return NULL;
+
+    slot->block = -1;
+    if (b->deflated) {
+        if (uncompress(slot->data, &len, b->data, b->len) != Z_OK) {
+            imc_log("History block %ld is corrupt", n);
+            return NULL;
+        }
+    } else {
+        memcpy(slot->data, b->data, b->len);
+    }
+
+    for (i = 0, p = slot->data; i < b->count; i++) {
+        slot->offsets[i] = (unsigned short)(p - slot->data);
+        p++;
+        imc_varint_get(&p);
+        p += strlen((const char *)p) + 1;
+        p += strlen((const char *)p) + 1;
+        p += strlen((const char *)p) + 1;
+    }
+
+    slot->block = n;
+    slot->used = ++cache_clock;
+    return slot;
+}
+
+/*
+ * Block holding a sequence number
+ */
+static long imc_history_block_of(long seq) {
+    long lo = block_first, hi = block_open, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo + 1) / 2;
+        if (IMC_HISTORY_BLOCK(mid)->first_seq <= seq) lo = mid;
+        else hi = mid - 1;
+    }
+
+    return lo;
+}
+
+/*
+ * Read back one entry. The view is valid until the next history call.
+ */
+static IMC_HISTORY *imc_history_get(long seq) {
+    static IMC_HISTORY h;
+    IMC_HISTORY_BLOCK *b;
+    IMC_HISTORY_RAW *raw;
+    long n;
+
+    if (!imc_history_ready() || seq < imc_history_oldest() ||
+        seq > imc_data->history_seq) return NULL;
+
+    n = imc_history_block_of(seq);
+    b = IMC_HISTORY_BLOCK(n);
+    if (!(raw = imc_history_raw(n))) return NULL;
+
+    imc_history_decode(&h, b, raw->data + raw->offsets[seq - b->first_seq]);
+    h.seq = seq;
+    return &h;
+}
+
+static bool imc_history_after(time_t when, time_t t, bool strict) {
+    return strict ? when > t : when >= t;
+}
+
+/*
+ * First sequence number stored at or after t (strictly after, if strict),
+ * or one past the newest. Timestamps grow with the sequence number, so
+ * this finds the block from the block time ranges, then the entry in it.
+ */
+static long imc_history_seq_at(time_t t, bool strict) {
+    IMC_HISTORY_BLOCK *b;
+    IMC_HISTORY *h;
+    long lo = block_first, hi = block_open + 1, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        b = IMC_HISTORY_BLOCK(mid);
+        if (b->count > 0 && imc_history_after(b->last_time, t, strict)) hi = mid;
+        else lo = mid + 1;
+    }
+    if (lo > block_open) return imc_data->history_seq + 1;
+
+    b = IMC_HISTORY_BLOCK(lo);
+    lo = b->first_seq;
+    hi = b->first_seq + b->count - 1;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        h = imc_history_get(mid);
+        if (!h || imc_history_after(h->timestamp, t, strict)) hi = mid;
+        else lo = mid + 1;
+    }
+
+    return lo;
+}
+
+/*
+ * Store an entry in the open block and the index
+ */
+static IMC_HISTORY *imc_history_append(imc_msg_type_t type, const char *from,
+                                      const char *to, const char *message,
+                                      time_t timestamp) {
+    static IMC_HISTORY h;
+    IMC_HISTORY_BLOCK *b;
+    unsigned char *p;
+    int from_len, to_len, message_len;
+
+    if (!imc_history_ready()) return NULL;
+
+    from = from ? from : "";
+    to = to ? to : "";
+    message = message ? message : "";
+    from_len = (int)strnlen(from, IMC_MAX_USERNAME_LEN - 1);
+    to_len = (int)strnlen(to, IMC_MAX_USERNAME_LEN - 1);
+    message_len = (int)strnlen(message, IMC_MAX_MESSAGE_LEN - 1);
+
+    /* Keep time order, searches rely on it */
+    if (timestamp < history_last) timestamp = history_last;
+    history_last = timestamp;
+
+    b = IMC_HISTORY_BLOCK(block_open);
+    if (b->count >= IMC_HISTORY_BLOCK_RECORDS ||
+        b->raw_len + 14 + from_len + to_len + message_len > IMC_HISTORY_BLOCK_SIZE) {
+        imc_history_seal_block();
+        imc_history_open_block();
+        b = IMC_HISTORY_BLOCK(block_open);
+    }
+    if (b->count == 0) b->first_time = timestamp;
+
+    open_raw.offsets[b->count] = (unsigned short)b->raw_len;
+    p = open_raw.data + b->raw_len;
+    *p++ = (unsigned char)type;
+    p += imc_varint_put(p, (unsigned long)(timestamp - b->first_time));
+    memcpy(p, from, from_len);
+    p[from_len] = '\0';
+    p += from_len + 1;
+    memcpy(p, to, to_len);
+    p[to_len] = '\0';
+    p += to_len + 1;
+    memcpy(p, message, message_len);
+    p[message_len] = '\0';
+
+    imc_history_decode(&h, b, open_raw.data + b->raw_len);
+    h.seq = ++imc_data->history_seq;
+
+    b->raw_len = (int)(p + message_len + 1 - open_raw.data);
+    b->count++;
+    b->last_time = timestamp;
+
+    imc_index_entry(&h);
+    return &h;
+}
+
+/*
+ * Write one entry to the history log
+ */
+static void imc_history_write(FILE *fp, const IMC_HISTORY *h) {
+    char *from = imc_escape_json(h->from);
+    char *to = imc_escape_json(h->to);
+    char *message = imc_escape_json(h->message);
+
+    fprintf(fp, "%ld\t%d\t%s\t%s\t%s\n", (long)h->timestamp, (int)h->type,
+            from, to, message);
+
+    free(from);
+    free(to);
+    free(message);
+}
+
+/*
+ * Add a message to the history
+ */
+void imc_add_history(imc_msg_type_t type, const char *from, const char *to,
+                    const char *message) {
+    IMC_HISTORY *h = imc_history_append(type, from, to, message, time(NULL));
+
+    if (h && history_fp) {
+        imc_history_write(history_fp, h);
+        fflush(history_fp);
+    }
+}
+
+/*
+ * Rewrite the log down to the entries still held and reopen it for
+ * appending
+ */
+static void imc_history_compact(void) {
+    char tmpfile[256];
+    IMC_HISTORY *h;
+    FILE *fp;
+    long seq;
+
+    if (history_fp) {
+        fclose(history_fp);
+        history_fp = NULL;
+    }
+
+    snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", IMC_HISTORY_FILE);
+    if ((fp = fopen(tmpfile, "w")) != NULL) {
+        for (seq = imc_history_oldest(); seq <= imc_data->history_seq; seq++) {
+            if ((h = imc_history_get(seq)) != NULL) imc_history_write(fp, h);
+        }
+        fclose(fp);
+        rename(tmpfile, IMC_HISTORY_FILE);
+    }
+    log_first = block_first;
+
+    history_fp = fopen(IMC_HISTORY_FILE, "a");
+    if (!history_fp) {
+        imc_log("Could not open history file %s: %s", IMC_HISTORY_FILE,
+                strerror(errno));
+    }
+}
+
+/*
+ * Load the persisted history, keeping only what fits in the blocks, and
+ * rewrite the log so it never grows past the retention limit.
+ */
+void imc_history_load(void) {
+    char line[IMC_MAX_MESSAGE_LEN * 2 + 256];
+    FILE *fp;
+    long n, bytes = 0;
+    int i;
+
+    if (!imc_data) return;
+
+    if (block_open < 0) {
+        bool ok = imc_history_raw_alloc(&open_raw);
+
+        for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+            ok = imc_history_raw_alloc(&history_cache[i]) && ok;
+        }
+        if (!ok) {
+            imc_log("ERROR: Could not allocate history blocks");
+            imc_history_raw_free(&open_raw);
+            for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+                imc_history_raw_free(&history_cache[i]);
+            }
+            return;
+        }
+
+        block_first = 0;
+        imc_history_open_block();
+    }
+
+    if ((fp = fopen(IMC_HISTORY_FILE, "r")) != NULL) {
+        while (fgets(line, sizeof(line), fp)) {
+            char *fields[5], *p = line;
+            int n;
+
+            line[strcspn(line, "\n")] = '\0';
+            for (n = 0; n < 5 && p; n++) {
+                fields[n] = p;
+                p = (n < 4) ? strchr(p, '\t') : NULL;
+                if (p) *p++ = '\0';
+            }
+            if (n < 5) continue;
+
+            {
+                char *from = imc_unescape_json(fields[2]);
+                char *to = imc_unescape_json(fields[3]);
+                char *message = imc_unescape_json(fields[4]);
+
+                imc_history_append((imc_msg_type_t)atoi(fields[1]), from, to,
+                                  message, (time_t)atol(fields[0]));
+                free(from);
+                free(to);
+                free(message);
+            }
+        }
+        fclose(fp);
+    }
+
+    imc_history_compact();
+
+    for (n = block_first; n < block_open; n++) {
+        bytes += IMC_HISTORY_BLOCK(n)->len;
+    }
+    imc_log("Loaded %ld history entries, %ld sealed blocks in %ld bytes",
+            imc_history_held(), block_open - block_first, bytes);
+}
+
+/*
+ * Drop every block and reset the store to one empty open block
+ */
+static void imc_history_reset(void) {
+    int i;
+
+    for (; block_first <= block_open; block_first++) {
+        IMC_FREE(IMC_HISTORY_BLOCK(block_first)->data);
+    }
+    for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+        history_cache[i].block = -1;
+    }
+
+    block_first = 0;
+    block_open = -1;
+    log_first = 0;
+    history_last = 0;
+    imc_data->history_seq = 0;
+}
+
+/*
+ * Clear the history, the index and the log
+ */
+void imc_clear_history(void) {
+    imc_index_free();
+
+    if (imc_history_ready()) {
+        imc_history_reset();
+        imc_history_open_block();
+    }
+
+    if (history_fp) {
+        fclose(history_fp);
+        history_fp = fopen(IMC_HISTORY_FILE, "w");
+    }
+}
+
+/*
+ * Release history memory on shutdown (the log is kept)
+ */
+void imc_history_free(void) {
+    int i;
+
+    imc_index_free();
+
+    if (history_fp) {
+        fclose(history_fp);
+        history_fp = NULL;
+    }
+
+    if (imc_history_ready()) {
+        imc_history_reset();
+        imc_history_raw_free(&open_raw);
+        for (i = 0; i < IMC_HISTORY_CACHE; i++) {
+            imc_history_raw_free(&history_cache[i]);
+        }
+    }
+}
+
+/*
+ * Visit the last count entries of a channel, oldest first, straight from
+ * its posting list. Returns how many there are; *latest is set to the
+ * newest entry's sequence number, or 0 if there is none. visit may be
+ * NULL to only count them.
+ */
+int imc_history_channel(const char *channel, int count, long *latest,
+                       void (*visit)(const IMC_HISTORY *h, void *arg),
+                       void *arg) {
+    char token[IMC_INDEX_TOKEN_LEN];
+    IMC_POSTING *p;
+    IMC_HISTORY *h;
+    long *seqs, held;
+    int i, found, first;
+
+    *latest = 0;
+    if (!imc_history_ready() || !channel || count <= 0) return 0;
+
+    imc_index_field_token(token, 'c', channel, (int)strlen(channel));
+    if (!(p = imc_index_find(token, FALSE))) return 0;
+
+    held = imc_history_held();
+    if (held <= 0 || !(seqs = malloc(sizeof(long) * held))) return 0;
+
+    found = imc_posting_decode(p, imc_history_oldest(), imc_data->history_seq,
+                               seqs, (int)held);
+    first = found > count ? found - count : 0;
+
+    for (i = first; visit && i < found; i++) {
+        if ((h = imc_history_get(seqs[i])) != NULL) visit(h, arg);
+    }
+    if (found > 0) *latest = seqs[found - 1];
+
+    free(seqs);
+    return found - first;
+}
+
+/* =================================================================== */
+/* DISPLAY                                                            */
+/* =================================================================== */
+
+/*
+ * Show one history entry to a player
+ */
+static void imc_history_show_entry(CHAR_DATA *ch, const IMC_HISTORY *h) {
+    char line[MAX_STRING_LENGTH];
+    char when[32];
+
+    strftime(when, sizeof(when), "%m/%d %H:%M", localtime(&h->timestamp));
+
+    switch (h->type) {
+        case IMC_MSG_CHANNEL:
+            snprintf(line, sizeof(line), "%s [%s] %s: %s\r\n",
+                     when, h->to, h->from, h->message);
+            break;
+        case IMC_MSG_EMOTE:
+        case IMC_MSG_EMOTETO:
+            snprintf(line, sizeof(line), "%s %s %s\r\n",
+                     when, h->from, h->message);
+            break;
+        default:
+            snprintf(line, sizeof(line), "%s %s -> %s: %s\r\n",
+                     when, h->from, h->to, h->message);
+            break;
+    }
+
+    imc_send_to_char(ch, line);
+}
+
+/*
+ * Show the last count messages of one type
+ */
+void imc_show_history(CHAR_DATA *ch, imc_msg_type_t type, int count) {
+    IMC_HISTORY *h;
+    long seq, oldest;
+    int shown = 0;
+
+    if (!imc_history_ready() || imc_data->history_seq == 0) {
+        imc_send_to_char(ch, "No history.\r\n");
+        return;
+    }
+
+    /* Walk back to find the window, then print oldest first */
+    oldest = imc_history_oldest();
+    for (seq = imc_data->history_seq; seq >= oldest && shown < count; seq--) {
+        if ((h = imc_history_get(seq)) != NULL && h->type == type) shown++;
+    }
+
+    if (shown == 0) {
+        imc_send_to_char(ch, "No history.\r\n");
+        return;
+    }
+
+    for (seq++; seq <= imc_data->history_seq; seq++) {
+        if ((h = imc_history_get(seq)) != NULL && h->type == type) {
+            imc_history_show_entry(ch, h);
+        }
+    }
+}
+
+/* =================================================================== */
+/* SEARCH                                                             */
+/* =================================================================== */
+
+typedef struct imc_search_query {
+    char terms[IMC_SEARCH_MAX_TERMS][IMC_INDEX_TOKEN_LEN];
+    int nterms;
+    time_t since;
+    time_t until;
+} IMC_SEARCH_QUERY;
+
+static void imc_search_emit_word(const char *word, void *arg) {
+    IMC_SEARCH_QUERY *q = arg;
+
+    if (q->nterms < IMC_SEARCH_MAX_TERMS) {
+        strcpy(q->terms[q->nterms++], word);
+    }
+}
+
+/*
+ * Parse an age such as 90m, 36h, 2d or 1w into seconds
+ */
+static long imc_parse_age(const char *str) {
+    char *end;
+    long value = strtol(str, &end, 10);
+
+    switch (tolower((unsigned char)*end)) {
+        case 'w': return value * 7 * 24 * 3600;
+        case 'd': return value * 24 * 3600;
+        case 'h': return value * 3600;
+        case 'm': return value * 60;
+        default:  return value;
+    }
+}
+
+/*
+ * Parse "word user:x mud:x channel:x to:x type:x since:2d until:1d"
+ */
+static void imc_parse_search(const char *query, IMC_SEARCH_QUERY *q) {
+    char word[MAX_INPUT_LENGTH];
+    time_t now = time(NULL);
+    const char *value;
+    int len;
+
+    memset(q, 0, sizeof(*q));
+
+    while (*query) {
+        IMC_SKIP_SPACES(query);
+        for (len = 0; *query && *query != ' '; query++) {
+            if (len < MAX_INPUT_LENGTH - 1) word[len++] = *query;
+        }
+        word[len] = '\0';
+        if (!len) break;
+
+        value = strchr(word, ':');
+        if (value && q->nterms < IMC_SEARCH_MAX_TERMS) {
+            value++;
+            if (!strncmp(word, "user:", 5)) {
+                imc_index_field_token(q->terms[q->nterms++], 'u', value, (int)strlen(value));
+                continue;
+            } else if (!strncmp(word, "mud:", 4)) {
+                imc_index_field_token(q->terms[q->nterms++], 'm', value, (int)strlen(value));
+                continue;
+            } else if (!strncmp(word, "channel:", 8)) {
+                imc_index_field_token(q->terms[q->nterms++], 'c', value, (int)strlen(value));
+                continue;
+            } else if (!strncmp(word, "to:", 3)) {
+                imc_index_field_token(q->terms[q->nterms++], 'r', value, (int)strlen(value));
+                continue;
+            } else if (!strncmp(word, "type:", 5)) {
+                imc_index_field_token(q->terms[q->nterms++], 't', value, (int)strlen(value));
+                continue;
+            } else if (!strncmp(word, "since:", 6)) {
+                q->since = now - imc_parse_age(value);
+                continue;
+            } else if (!strncmp(word, "until:", 6)) {
+                q->until = now - imc_parse_age(value);
+                continue;
+            }
+        }
+
+        imc_tokenize(word, imc_search_emit_word, q);
+    }
+}
+
+/*
+ * Narrow [*lo, *hi] to the entries inside the query time range
+ */
+static void imc_search_time_bounds(const IMC_SEARCH_QUERY *q, long *lo, long *hi) {
+    long seq;
+
+    if (q->since && (seq = imc_history_seq_at(q->since, FALSE)) > *lo) {
+        *lo = seq;
+    }
+
+    if (q->until && (seq = imc_history_seq_at(q->until, TRUE) - 1) < *hi) {
+        *hi = seq;
+    }
+}
+
+/*
+ * Answer a history search from the index
+ */
+void imc_history_search(CHAR_DATA *ch, const char *query, int count) {
+    IMC_SEARCH_QUERY q;
+    IMC_POSTING *lists[IMC_SEARCH_MAX_TERMS];
+    IMC_HISTORY *h;
+    long *result = NULL, *other = NULL;
+    long lo, hi, seq, held;
+    int i, j, k, n, m, shown = 0;
+
+    if (!imc_history_ready() || imc_data->history_seq == 0) {
+        imc_send_to_char(ch, "No matching messages.\r\n");
+        return;
+    }
+
+    imc_parse_search(query, &q);
+
+    lo = imc_history_oldest();
+    hi = imc_data->history_seq;
+    imc_search_time_bounds(&q, &lo, &hi);
+
+    if (lo > hi) {
+        imc_send_to_char(ch, "No matching messages.\r\n");
+        return;
+    }
+
+    /* No terms: the time range alone selects the entries */
+    if (q.nterms == 0) {
+        for (seq = hi; seq >= lo && shown < count; seq--) shown++;
+        for (seq++; seq <= hi; seq++) {
+            if ((h = imc_history_get(seq)) != NULL) imc_history_show_entry(ch, h);
+        }
+        if (!shown) imc_send_to_char(ch, "No matching messages.\r\n");
+        return;
+    }
+
+    /* Every term must have a posting list; start from the shortest */
+    for (i = 0; i < q.nterms; i++) {
+        if (!(lists[i] = imc_index_find(q.terms[i], FALSE))) {
+            imc_send_to_char(ch, "No matching messages.\r\n");
+            return;
+        }
+        for (j = i; j > 0 && lists[j]->len < lists[j - 1]->len; j--) {
+            IMC_POSTING *tmp = lists[j];
+            lists[j] = lists[j - 1];
+            lists[j - 1] = tmp;
+        }
+    }
+
+    held = imc_history_held();
+    result = malloc(sizeof(long) * held);
+    other = malloc(sizeof(long) * held);
+    if (!result || !other) {
+        IMC_FREE(result);
+        IMC_FREE(other);
+        return;
+    }
+
+    n = imc_posting_decode(lists[0], lo, hi, result, (int)held);
+    for (i = 1; i < q.nterms && n > 0; i++) {
+        m = imc_posting_decode(lists[i], result[0], result[n - 1],
+                               other, (int)held);
+        for (j = k = 0, shown = 0; j < n && k < m; ) {
+            if (result[j] < other[k]) j++;
+            else if (result[j] > other[k]) k++;
+            else { result[shown++] = result[j]; j++; k++; }
+        }
+        n = shown;
+    }
+
+    if (n == 0) {
+        imc_send_to_char(ch, "No matching messages.\r\n");
+    } else {
+        for (i = (n > count ? n - count : 0); i < n; i++) {
+            if ((h = imc_history_get(result[i])) != NULL) imc_history_show_entry(ch, h);
+        }
+    }
+
+    free(result);
+    free(other);
+}
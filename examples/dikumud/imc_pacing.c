@@ -0,0 +1,331 @@
+/*
+ * MudVault Mesh Adaptive Send Pacing for DikuMUD/Merc
+ *
+ * Outbound messages are paced per message class with additive-increase/
+ * multiplicative-decrease. Every second a busy class is allowed a little
+ * more; every RATE_LIMITED error from the gateway halves it and honours
+ * the retry-after hint. Rejected messages are requeued while their TTL
+ * lasts, so under load we settle just below the gateway's limit.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+/* A message waiting to be sent, or sent and kept in case it is rejected */
+typedef struct imc_outbound {
+    char *json;
+    imc_pace_class_t pace_class;
+    time_t expires;                /* Submitted + IMC_MESSAGE_TTL */
+    int attempts;
+    struct imc_outbound *next;
+} IMC_OUTBOUND;
+
+/* Pacing state for one message class */
+typedef struct imc_pace {
+    const char *name;
+    double rate;                   /* Allowed messages per second */
+    double tokens;                 /* Token bucket, refilled at rate */
+    long last_refill;              /* Milliseconds */
+    time_t backoff_until;          /* Gateway retry-after hint */
+    bool rejected;                 /* Decreased since the last update */
+    bool throttled;                /* Had to queue since the last update */
+    IMC_OUTBOUND *head;
+    IMC_OUTBOUND *tail;
+    int queued;
+    long sent;
+    long rejections;
+    long retried;
+    long dropped;
+} IMC_PACE;
+
+static IMC_PACE pace[IMC_PACE_CLASSES] = {
+    [IMC_PACE_TELL]    = { .name = "tell" },
+    [IMC_PACE_CHANNEL] = { .name = "channel" },
+    [IMC_PACE_QUERY]   = { .name = "query" },
+    [IMC_PACE_OTHER]   = { .name = "other" }
+};
+
+/* Ring of recently sent messages, searched when a rejection arrives */
+static IMC_OUTBOUND *inflight[IMC_PACE_INFLIGHT_MAX];
+static int inflight_next = 0;
+
+/* =================================================================== */
+/* INTERNALS                                                          */
+/* =================================================================== */
+
+static long imc_pace_now_ms(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * Classes start at the initial rate with a full bucket
+ */
+static void imc_pace_init(IMC_PACE *p) {
+    if (p->rate > 0) return;
+
+    p->rate = IMC_PACE_INITIAL_RATE;
+    p->tokens = IMC_PACE_INITIAL_RATE;
+    p->last_refill = imc_pace_now_ms();
+}
+
+/*
+ * Refill the token bucket; a class may burst up to one second's worth
+ */
+static void imc_pace_refill(IMC_PACE *p) {
+    long now = imc_pace_now_ms();
+    double burst;
+
+    burst = p->rate < 1 ? 1 : p->rate;
+    p->tokens += p->rate * (now - p->last_refill) / 1000.0;
+    if (p->tokens > burst) p->tokens = burst;
+    p->last_refill = now;
+}
+
+static void imc_outbound_free(IMC_OUTBOUND *msg) {
+    if (!msg) return;
+    IMC_FREE(msg->json);
+    free(msg);
+}
+
+/*
+ * Put a message on the wire and remember it until it ages out of the
+ * in-flight ring
+ */
+static void imc_pace_transmit(IMC_PACE *p, IMC_OUTBOUND *msg) {
+    imc_send_raw(msg->json);
+
+    p->tokens -= 1;
+    p->sent++;
+    msg->attempts++;
+    msg->next = NULL;
+
+    imc_outbound_free(inflight[inflight_next]);
+    inflight[inflight_next] = msg;
+    inflight_next = (inflight_next + 1) % IMC_PACE_INFLIGHT_MAX;
+}
+
+/*
+ * Send whatever the class is currently allowed to send
+ */
+static void imc_pace_drain(IMC_PACE *p) {
+    IMC_OUTBOUND *msg;
+    time_t now = time(NULL);
+
+    if (!IMC_IS_CONNECTED() || now < p->backoff_until) return;
+
+    imc_pace_init(p);
+    imc_pace_refill(p);
+
+    while ((msg = p->head) != NULL && p->tokens >= 1) {
+        p->head = msg->next;
+        if (!p->head) p->tail = NULL;
+        p->queued--;
+
+        if (now >= msg->expires) {
+            p->dropped++;
+            imc_outbound_free(msg);
+            continue;
+        }
+
+        imc_pace_transmit(p, msg);
+    }
+
+    if (p->head) p->throttled = TRUE;
+}
+
+/*
+ * Back a class off after the gateway rejected one of its messages.
+ * A burst of rejections is one congestion event, so the rate is only
+ * cut once per update.
+ */
+static void imc_pace_backoff(IMC_PACE *p, int retry_after) {
+    imc_pace_init(p);
+    p->rejections++;
+
+    if (!p->rejected) {
+        p->rate *= IMC_PACE_DECREASE;
+        if (p->rate < IMC_PACE_MIN_RATE) p->rate = IMC_PACE_MIN_RATE;
+        p->tokens = 0;
+        p->rejected = TRUE;
+    }
+
+    if (retry_after > 0) {
+        p->backoff_until = time(NULL) + retry_after;
+    }
+}
+
+/* =================================================================== */
+/* PUBLIC INTERFACE                                                   */
+/* =================================================================== */
+
+/*
+ * Queue a message on its class and send it as soon as pacing allows
+ */
+void imc_pace_submit(const char *json, imc_pace_class_t pace_class) {
+    IMC_PACE *p;
+    IMC_OUTBOUND *msg;
+
+    if (!json || pace_class >= IMC_PACE_CLASSES) return;
+    p = &pace[pace_class];
+
+    if (p->queued >= IMC_PACE_QUEUE_MAX) {
+        p->dropped++;
+        imc_log("Pacing queue for %s messages full, dropping message", p->name);
+        return;
+    }
+
+    msg = IMC_CREATE(IMC_OUTBOUND);
+    if (!msg || !(msg->json = strdup(json))) {
+        IMC_FREE(msg);
+        return;
+    }
+    msg->pace_class = pace_class;
+    msg->expires = time(NULL) + IMC_MESSAGE_TTL;
+
+    /* Append so that queued messages keep their order */
+    if (p->tail) p->tail->next = msg;
+    else p->head = msg;
+    p->tail = msg;
+    p->queued++;
+
+    imc_pace_drain(p);
+}
+
+/*
+ * Once a second: grow the rate of classes that were held back without
+ * being rejected, then send what is now allowed
+ */
+void imc_pace_update(void) {
+    int i;
+
+    for (i = 0; i < IMC_PACE_CLASSES; i++) {
+        IMC_PACE *p = &pace[i];
+
+        if (!p->rejected && (p->throttled || p->queued > 0) && p->rate > 0) {
+            p->rate += IMC_PACE_INCREASE;
+            if (p->rate > IMC_PACE_MAX_RATE) p->rate = IMC_PACE_MAX_RATE;
+        }
+
+        p->rejected = FALSE;
+        p->throttled = FALSE;
+        imc_pace_drain(p);
+    }
+}
+
+/*
+ * Handle a RATE_LIMITED error from the gateway. Its details name the
+ * rejected message (messageId, messageType) and a retryAfter in seconds;
+ * the keys are unique within the error, so no nested lookup is needed.
+ */
+void imc_pace_rate_limited(const char *json) {
+    char *message_id = imc_json_get_string(json, "messageId");
+    char *type = imc_json_get_string(json, "messageType");
+    int retry_after = imc_json_get_int(json, "retryAfter");
+    IMC_OUTBOUND *msg = NULL;
+    char needle[64];
+    int i;
+
+    if (message_id) {
+        snprintf(needle, sizeof(needle), "\"id\":\"%s\"", message_id);
+        for (i = 0; i < IMC_PACE_INFLIGHT_MAX; i++) {
+            if (inflight[i] && strstr(inflight[i]->json, needle)) {
+                msg = inflight[i];
+                inflight[i] = NULL;
+                break;
+            }
+        }
+    }
+
+    if (msg) {
+        IMC_PACE *p = &pace[msg->pace_class];
+
+        imc_pace_backoff(p, retry_after);
+
+        /* Retry at the front of the queue while the TTL allows */
+        if (msg->attempts < IMC_PACE_MAX_ATTEMPTS && time(NULL) < msg->expires) {
+            msg->next = p->head;
+            p->head = msg;
+            if (!p->tail) p->tail = msg;
+            p->queued++;
+            p->retried++;
+        } else {
+            p->dropped++;
+            imc_outbound_free(msg);
+        }
+    } else if (type) {
+        imc_pace_backoff(&pace[imc_pace_class_for_type(type)], retry_after);
+    } else {
+        for (i = 0; i < IMC_PACE_CLASSES; i++) {
+            imc_pace_backoff(&pace[i], retry_after);
+        }
+    }
+
+    IMC_FREE(message_id);
+    IMC_FREE(type);
+}
+
+/*
+ * Map a message type to its pacing class
+ */
+imc_pace_class_t imc_pace_class_for_type(const char *type) {
+    if (!strcmp(type, "tell")) return IMC_PACE_TELL;
+    if (!strcmp(type, "channel")) return IMC_PACE_CHANNEL;
+    if (!strcmp(type, "who") || !strcmp(type, "finger") ||
+        !strcmp(type, "locate") || !strcmp(type, "mudlist") ||
+        !strcmp(type, "channels")) return IMC_PACE_QUERY;
+    return IMC_PACE_OTHER;
+}
+
+/*
+ * Show the current pacing rates (for imcstats)
+ */
+void imc_pace_show_stats(CHAR_DATA *ch) {
+    char line[MAX_STRING_LENGTH];
+    time_t now = time(NULL);
+    int i;
+
+    imc_send_to_char(ch, "Send Pacing:\r\n");
+    for (i = 0; i < IMC_PACE_CLASSES; i++) {
+        IMC_PACE *p = &pace[i];
+
+        snprintf(line, sizeof(line),
+                 "  %-8s %5.2f msg/s  queued %d  sent %ld  rejected %ld  "
+                 "retried %ld  dropped %ld%s\r\n",
+                 p->name, p->rate > 0 ? p->rate : IMC_PACE_INITIAL_RATE,
+                 p->queued, p->sent, p->rejections, p->retried, p->dropped,
+                 now < p->backoff_until ? "  (backing off)" : "");
+        imc_send_to_char(ch, line);
+    }
+}
+
+/*
+ * Free all queued and in-flight messages
+ */
+void imc_pace_free(void) {
+    IMC_OUTBOUND *msg, *next;
+    int i;
+
+    for (i = 0; i < IMC_PACE_CLASSES; i++) {
+        for (msg = pace[i].head; msg; msg = next) {
+            next = msg->next;
+            imc_outbound_free(msg);
+        }
+        pace[i].head = pace[i].tail = NULL;
+        pace[i].queued = 0;
+    }
+
+    for (i = 0; i < IMC_PACE_INFLIGHT_MAX; i++) {
+        imc_outbound_free(inflight[i]);
+        inflight[i] = NULL;
+    }
+}
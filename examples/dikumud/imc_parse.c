@@ -0,0 +1,216 @@
+/*
+ * MudVault Mesh Command Parsing for DikuMUD/Merc
+ *
+ * Shared front end for the player commands: name validation, one
+ * player@mud parser, and an abbreviation trie
+ * so subcommand dispatch costs one walk over the typed word instead
+ * of an is_abbrev() chain.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+/* Subcommand names are matched on the letters a-z only */
+#define IMC_TRIE_FANOUT        26
+
+struct imc_trie_node {
+    short child[IMC_TRIE_FANOUT];  /* Node index, 0 = none (0 is the root) */
+    short best;                    /* First table entry below this node */
+};
+
+/* =================================================================== */
+/* VALIDATION                                                         */
+/* =================================================================== */
+
+/*
+ * Same rules as the gateway: letters, digits, dashes and underscores
+ */
+static bool imc_valid_name(const char *str, int min_len, int max_len) {
+    int len = 0;
+
+    if (!str) return FALSE;
+
+    for (; *str; str++, len++) {
+        if (!isalnum((unsigned char)*str) && *str != '-' && *str != '_') {
+            return FALSE;
+        }
+    }
+
+    return len >= min_len && len <= max_len;
+}
+
+bool imc_validate_mudname(const char *mudname) {
+    return imc_valid_name(mudname, 3, IMC_MAX_MUDNAME_LEN);
+}
+
+bool imc_validate_username(const char *username) {
+    return imc_valid_name(username, 1, IMC_MAX_USERNAME_LEN);
+}
+
+bool imc_validate_channel(const char *channel) {
+    return imc_valid_name(channel, 1, IMC_MAX_CHANNEL_LEN);
+}
+
+/* =================================================================== */
+/* TARGET PARSING                                                     */
+/* =================================================================== */
+
+/*
+ * Parse "player@mud" into target. Returns IMC_TARGET_OK or the reason
+ * it was rejected; see imc_target_error().
+ */
+int imc_parse_target(const char *input, IMC_TARGET *target) {
+    const char *at;
+    size_t user_len, mud_len;
+
+    target->user[0] = '\0';
+    target->mud[0] = '\0';
+
+    if (!input || !(at = strchr(input, '@'))) return IMC_TARGET_NO_MUD;
+
+    user_len = at - input;
+    mud_len = strlen(at + 1);
+
+    if (user_len == 0 || user_len > IMC_MAX_USERNAME_LEN) {
+        return IMC_TARGET_BAD_USER;
+    }
+    if (mud_len == 0 || mud_len > IMC_MAX_MUDNAME_LEN) {
+        return IMC_TARGET_BAD_MUD;
+    }
+
+    memcpy(target->user, input, user_len);
+    target->user[user_len] = '\0';
+    memcpy(target->mud, at + 1, mud_len + 1);
+
+    if (!imc_validate_username(target->user)) return IMC_TARGET_BAD_USER;
+    if (!imc_validate_mudname(target->mud)) return IMC_TARGET_BAD_MUD;
+
+    return IMC_TARGET_OK;
+}
+
+/*
+ * Parse a comma-separated list of "player@mud" targets, at most max of
+ * them. *count is set to the number parsed.
+ */
+int imc_parse_targets(const char *input, IMC_TARGET *targets, int max, int *count) {
+    char item[IMC_MAX_USERNAME_LEN + IMC_MAX_MUDNAME_LEN + 2];
+    const char *comma;
+    size_t len;
+    int result;
+
+    *count = 0;
+    if (!input || !*input) return IMC_TARGET_NO_MUD;
+
+    for (;;) {
+        comma = strchr(input, ',');
+        len = comma ? (size_t)(comma - input) : strlen(input);
+
+        if (*count >= max) return IMC_TARGET_TOO_MANY;
+        if (len >= sizeof(item)) return IMC_TARGET_BAD_USER;
+
+        memcpy(item, input, len);
+        item[len] = '\0';
+        if ((result = imc_parse_target(item, &targets[*count])) != IMC_TARGET_OK) {
+            return result;
+        }
+        (*count)++;
+
+        if (!comma) return IMC_TARGET_OK;
+        input = comma + 1;
+    }
+}
+
+/*
+ * Player-facing text for an imc_parse_target() result
+ */
+const char *imc_target_error(int result) {
+    switch (result) {
+        case IMC_TARGET_NO_MUD:
+            return "You must specify the target as player@mudname.";
+        case IMC_TARGET_BAD_USER:
+            return "Invalid username format.";
+        case IMC_TARGET_BAD_MUD:
+            return "Invalid MUD name format.";
+        case IMC_TARGET_TOO_MANY:
+            return "Too many players named; send to fewer at once.";
+        default:
+            return "";
+    }
+}
+
+/* =================================================================== */
+/* SUBCOMMAND TRIE                                                    */
+/* =================================================================== */
+
+/*
+ * Build a trie over a subcommand table. Each entry must start with its
+ * 'const char *name'; entry_size is sizeof one entry. Every node
+ * remembers the first entry in table order that it leads to, so an
+ * abbreviation resolves exactly as an is_abbrev() chain in table order
+ * would.
+ */
+bool imc_cmd_trie_build(IMC_CMD_TRIE *trie, const void *table,
+                        size_t entry_size, int count) {
+    const char *name;
+    int i, nodes = 1, node, c;
+
+    trie->nodes = NULL;
+    trie->count = 0;
+
+    for (i = 0; i < count; i++) {
+        nodes += strlen(*(const char *const *)((const char *)table + i * entry_size));
+    }
+
+    if (!(trie->nodes = calloc(nodes, sizeof(struct imc_trie_node)))) {
+        return FALSE;
+    }
+    trie->count = 1;
+    trie->nodes[0].best = -1;
+
+    for (i = 0; i < count; i++) {
+        name = *(const char *const *)((const char *)table + i * entry_size);
+
+        for (node = 0; *name; name++) {
+            c = tolower((unsigned char)*name) - 'a';
+            if (c < 0 || c >= IMC_TRIE_FANOUT) break;
+
+            if (!trie->nodes[node].child[c]) {
+                trie->nodes[node].child[c] = trie->count;
+                trie->nodes[trie->count].best = i;
+                trie->count++;
+            }
+            node = trie->nodes[node].child[c];
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Index of the first table entry that 'word' abbreviates, or -1
+ */
+int imc_cmd_lookup(const IMC_CMD_TRIE *trie, const char *word) {
+    int node = 0, c;
+
+    if (!trie->nodes || !word || !*word) return -1;
+
+    for (; *word; word++) {
+        c = tolower((unsigned char)*word) - 'a';
+        if (c < 0 || c >= IMC_TRIE_FANOUT) return -1;
+        if (!(node = trie->nodes[node].child[c])) return -1;
+    }
+
+    return trie->nodes[node].best;
+}
+
+void imc_cmd_trie_free(IMC_CMD_TRIE *trie) {
+    IMC_FREE(trie->nodes);
+    trie->count = 0;
+}
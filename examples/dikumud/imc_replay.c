@@ -0,0 +1,436 @@
+/*
+ * MudVault Mesh Channel Replay for DikuMUD/Merc
+ *
+ * When a player joins a channel they are shown its last IMC_REPLAY_LINES
+ * lines. The lines come from the local history store; if that cannot be
+ * complete (we have not been connected long enough to have seen them),
+ * one bulk history request goes to the gateway instead. If the gateway
+ * refuses or does not answer, the local lines are shown after all.
+ *
+ * A replay is rendered once per channel into a plain and a colour copy
+ * and shared by every player joining before the channel moves on, then
+ * paged out IMC_REPLAY_PAGE lines per pulse so a large replay cannot
+ * stall the game loop.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+/* Rendered lines of one channel, shared by its pending replays */
+typedef struct imc_replay_block {
+    char channel[IMC_MAX_CHANNEL_LEN + 1];
+    long seq;                      /* Newest local channel entry at render */
+    char *text[2];                 /* NUL-separated lines: plain, colour */
+    size_t len[2];
+    size_t size[2];
+    int lines;
+    int refs;                      /* Replays still reading this block */
+    bool pending;                  /* Waiting for the gateway's history */
+    bool stale;                    /* Replaced, free once refs drops to 0 */
+    time_t requested;
+    struct imc_replay_block *next;
+} IMC_REPLAY_BLOCK;
+
+/* One player's progress through a block */
+typedef struct imc_replay {
+    CHAR_DATA *ch;
+    IMC_REPLAY_BLOCK *block;
+    bool color;
+    int line;                      /* Next line to send */
+    size_t offset;                 /* Where that line starts */
+    struct imc_replay *next;
+} IMC_REPLAY;
+
+static IMC_REPLAY_BLOCK *replay_blocks = NULL;
+static IMC_REPLAY *replays = NULL;
+
+/* =================================================================== */
+/* BLOCKS                                                             */
+/* =================================================================== */
+
+static void imc_replay_block_free(IMC_REPLAY_BLOCK *block) {
+    IMC_FREE(block->text[0]);
+    IMC_FREE(block->text[1]);
+    free(block);
+}
+
+/*
+ * Take a block out of the cache; it is freed when its last reader is done
+ */
+static void imc_replay_block_retire(IMC_REPLAY_BLOCK *block) {
+    IMC_REPLAY_BLOCK **prev;
+
+    for (prev = &replay_blocks; *prev; prev = &(*prev)->next) {
+        if (*prev == block) {
+            *prev = block->next;
+            break;
+        }
+    }
+
+    block->stale = TRUE;
+    if (block->refs == 0) imc_replay_block_free(block);
+}
+
+static IMC_REPLAY_BLOCK *imc_replay_block_find(const char *channel) {
+    IMC_REPLAY_BLOCK *block;
+
+    for (block = replay_blocks; block; block = block->next) {
+        if (!strcasecmp(block->channel, channel)) return block;
+    }
+    return NULL;
+}
+
+static IMC_REPLAY_BLOCK *imc_replay_block_create(const char *channel,
+                                                long seq) {
+    IMC_REPLAY_BLOCK *block = IMC_CREATE(IMC_REPLAY_BLOCK);
+
+    if (!block) return NULL;
+
+    strncpy(block->channel, channel, IMC_MAX_CHANNEL_LEN);
+    block->seq = seq;
+    block->next = replay_blocks;
+    replay_blocks = block;
+    return block;
+}
+
+/*
+ * Append one NUL-terminated line to a variant
+ */
+static void imc_replay_block_put(IMC_REPLAY_BLOCK *block, int variant,
+                                 const char *line) {
+    size_t len = strlen(line) + 1;
+
+    if (block->len[variant] + len > block->size[variant]) {
+        size_t size = block->size[variant] ? block->size[variant] * 2 : 1024;
+        char *text;
+
+        while (size < block->len[variant] + len) size *= 2;
+        if (!(text = realloc(block->text[variant], size))) return;
+        block->text[variant] = text;
+        block->size[variant] = size;
+    }
+
+    memcpy(block->text[variant] + block->len[variant], line, len);
+    block->len[variant] += len;
+}
+
+/*
+ * Render one channel line into both variants
+ */
+static void imc_replay_block_add(IMC_REPLAY_BLOCK *block, time_t when,
+                                 const char *from, const char *message) {
+    char line[MAX_STRING_LENGTH];
+    char stamp[16];
+
+    strftime(stamp, sizeof(stamp), "%H:%M", localtime(&when));
+
+    snprintf(line, sizeof(line), "[%s] %s %s%s%s: %s\r\n", block->channel,
+             stamp, from, strchr(from, '@') ? "" : "@",
+             strchr(from, '@') ? "" : IMC_MUD_NAME, message);
+    imc_replay_block_put(block, 0, line);
+
+    snprintf(line, sizeof(line), "%s[%s] %s %s%s%s: %s%s\r\n",
+             IMC_COLOR_CHANNEL, block->channel, stamp, from,
+             strchr(from, '@') ? "" : "@",
+             strchr(from, '@') ? "" : IMC_MUD_NAME, message, IMC_COLOR_NORMAL);
+    imc_replay_block_put(block, 1, line);
+
+    block->lines++;
+}
+
+/*
+ * Ask the gateway for the channel's recent history in one message
+ */
+static void imc_replay_request(const char *channel) {
+    char *json = imc_json_create_object();
+    char uuid[IMC_UUID_LEN];
+
+    imc_json_add_string(&json, "version", IMC_PROTOCOL_VERSION);
+    imc_json_add_string(&json, "id", imc_generate_uuid(uuid));
+    imc_json_add_string(&json, "timestamp", imc_get_timestamp());
+    imc_json_add_string(&json, "type", "channel");
+
+    char *from_obj = imc_json_create_object();
+    imc_json_add_string(&from_obj, "mud", IMC_MUD_NAME);
+    from_obj = imc_json_finalize(from_obj);
+    imc_json_add_object(&json, "from", from_obj);
+
+    char *to_obj = imc_json_create_object();
+    imc_json_add_string(&to_obj, "mud", "Gateway");
+    imc_json_add_string(&to_obj, "channel", channel);
+    to_obj = imc_json_finalize(to_obj);
+    imc_json_add_object(&json, "to", to_obj);
+
+    char *payload = imc_json_create_object();
+    imc_json_add_string(&payload, "channel", channel);
+    imc_json_add_string(&payload, "action", "history");
+    imc_json_add_int(&payload, "limit", IMC_REPLAY_LINES);
+    payload = imc_json_finalize(payload);
+    imc_json_add_object(&json, "payload", payload);
+
+    char *metadata = imc_json_create_object();
+    imc_json_add_int(&metadata, "priority", IMC_MESSAGE_PRIORITY);
+    imc_json_add_int(&metadata, "ttl", IMC_MESSAGE_TTL);
+    imc_json_add_string(&metadata, "encoding", "utf-8");
+    imc_json_add_string(&metadata, "language", "en");
+    metadata = imc_json_finalize(metadata);
+    imc_json_add_object(&json, "metadata", metadata);
+
+    json = imc_json_finalize(json);
+    imc_send_message(json);
+
+    free(json);
+    free(from_obj);
+    free(to_obj);
+    free(payload);
+    free(metadata);
+}
+
+/* =================================================================== */
+/* DELIVERY                                                           */
+/* =================================================================== */
+
+/*
+ * Send up to IMC_REPLAY_PAGE lines; returns TRUE when the replay is done
+ */
+static bool imc_replay_send_page(IMC_REPLAY *r) {
+    IMC_REPLAY_BLOCK *block = r->block;
+    const char *text = block->text[r->color ? 1 : 0];
+    int sent = 0;
+
+    if (block->pending) return FALSE;
+
+    if (r->line == 0 && block->lines > 0) {
+        char header[128];
+
+        snprintf(header, sizeof(header), "Recent messages on [%s]:\r\n",
+                 block->channel);
+        imc_send_to_char(r->ch, header);
+    }
+
+    while (r->line < block->lines && sent < IMC_REPLAY_PAGE && text) {
+        imc_send_to_char(r->ch, text + r->offset);
+        r->offset += strlen(text + r->offset) + 1;
+        r->line++;
+        sent++;
+    }
+
+    return r->line >= block->lines;
+}
+
+static void imc_replay_release(IMC_REPLAY *r) {
+    IMC_REPLAY_BLOCK *block = r->block;
+
+    if (--block->refs == 0 && block->stale) imc_replay_block_free(block);
+    free(r);
+}
+
+/*
+ * Add a line from the local history to a block
+ */
+static void imc_replay_history_add(const IMC_HISTORY *h, void *arg) {
+    imc_replay_block_add(arg, h->timestamp, h->from, h->message);
+}
+
+/*
+ * Give up on the gateway for a pending block: fill it from the local
+ * history so its readers get what we have, and take it out of the cache
+ * so the next join decides afresh.
+ */
+static void imc_replay_fallback(IMC_REPLAY_BLOCK *block) {
+    long latest;
+
+    block->pending = FALSE;
+    imc_history_channel(block->channel, IMC_REPLAY_LINES, &latest,
+                        imc_replay_history_add, block);
+    imc_replay_block_retire(block);
+}
+
+/* =================================================================== */
+/* PUBLIC INTERFACE                                                   */
+/* =================================================================== */
+
+/*
+ * Start replaying a channel to a player who just joined it
+ */
+void imc_replay_channel(CHAR_DATA *ch, const char *channel) {
+    IMC_REPLAY_BLOCK *block;
+    IMC_REPLAY *r;
+    long latest;
+    int count;
+
+    if (!ch || !channel || !*channel) return;
+
+    count = imc_history_channel(channel, IMC_REPLAY_LINES, &latest, NULL, NULL);
+    block = imc_replay_block_find(channel);
+
+    /* Reuse the cached render until the channel moves on */
+    if (block && !block->pending && block->seq != latest) {
+        imc_replay_block_retire(block);
+        block = NULL;
+    }
+
+    if (!block) {
+        /*
+         * Local history is complete once we have a full page of lines or
+         * have been connected (and recording) for the whole window
+         */
+        if (count < IMC_REPLAY_LINES && IMC_IS_CONNECTED() &&
+            IMC_UPTIME() < IMC_REPLAY_WINDOW) {
+            if (!(block = imc_replay_block_create(channel, latest))) return;
+            block->pending = TRUE;
+            block->requested = time(NULL);
+            imc_replay_request(channel);
+        } else {
+            if (count == 0) return;
+            if (!(block = imc_replay_block_create(channel, latest))) return;
+            imc_history_channel(channel, IMC_REPLAY_LINES, &latest,
+                                imc_replay_history_add, block);
+        }
+    }
+
+    if (!(r = IMC_CREATE(IMC_REPLAY))) return;
+    r->ch = ch;
+    r->block = block;
+    r->color = PRF_FLAGGED(ch, PRF_COLOR_1) || PRF_FLAGGED(ch, PRF_COLOR_2);
+    block->refs++;
+
+    /* First page right away, the rest over the next pulses */
+    if (imc_replay_send_page(r)) {
+        imc_replay_release(r);
+        return;
+    }
+
+    r->next = replays;
+    replays = r;
+}
+
+/*
+ * Fill a pending block from the gateway's history response
+ */
+void imc_replay_receive(const char *channel, const char *json) {
+    IMC_REPLAY_BLOCK *block;
+    const char *cursor;
+    char *entry;
+
+    if (!channel || !(block = imc_replay_block_find(channel)) || !block->pending) {
+        return;
+    }
+
+    cursor = imc_json_get_array(json, "history");
+    while ((entry = imc_json_array_next(&cursor)) != NULL) {
+        char *user = imc_json_get_string(entry, "user");
+        char *mud = imc_json_get_string(entry, "mud");
+        char *message = imc_json_get_string(entry, "message");
+        char *timestamp = imc_json_get_string(entry, "timestamp");
+        char from[IMC_MAX_USERNAME_LEN + IMC_MAX_MUDNAME_LEN + 2];
+        struct tm tm_info;
+        time_t when = time(NULL);
+
+        if (timestamp) {
+            memset(&tm_info, 0, sizeof(tm_info));
+            if (sscanf(timestamp, "%d-%d-%dT%d:%d:%d", &tm_info.tm_year,
+                       &tm_info.tm_mon, &tm_info.tm_mday, &tm_info.tm_hour,
+                       &tm_info.tm_min, &tm_info.tm_sec) == 6) {
+                tm_info.tm_year -= 1900;
+                tm_info.tm_mon -= 1;
+                when = timegm(&tm_info);
+            }
+        }
+
+        if (message) {
+            snprintf(from, sizeof(from), "%s@%s", user ? user : "Someone",
+                     mud ? mud : "Unknown");
+            imc_replay_block_add(block, when, from, message);
+        }
+
+        IMC_FREE(user);
+        IMC_FREE(mud);
+        IMC_FREE(message);
+        IMC_FREE(timestamp);
+        free(entry);
+    }
+
+    block->pending = FALSE;
+}
+
+/*
+ * The gateway refused a channel's history request
+ */
+void imc_replay_error(const char *channel) {
+    IMC_REPLAY_BLOCK *block;
+
+    if (channel && (block = imc_replay_block_find(channel)) != NULL && block->pending) {
+        imc_replay_fallback(block);
+    }
+}
+
+/*
+ * Once a pulse: page out running replays and expire unanswered requests
+ */
+void imc_replay_update(void) {
+    IMC_REPLAY *r, *next, **prev = &replays;
+    IMC_REPLAY_BLOCK *block, *next_block;
+    time_t now = time(NULL);
+
+    for (block = replay_blocks; block; block = next_block) {
+        next_block = block->next;
+        if (block->pending && now - block->requested > IMC_REPLAY_TIMEOUT) {
+            imc_replay_fallback(block);
+        }
+    }
+
+    for (r = replays; r; r = next) {
+        next = r->next;
+
+        if ((r->block->stale && r->block->lines == 0) ||
+            imc_replay_send_page(r)) {
+            *prev = next;
+            imc_replay_release(r);
+            continue;
+        }
+        prev = &r->next;
+    }
+}
+
+/*
+ * Stop replaying to a player. imc_player_logout() calls this, so a replay
+ * never outlives its character.
+ */
+void imc_replay_cancel(CHAR_DATA *ch) {
+    IMC_REPLAY *r, *next, **prev = &replays;
+
+    for (r = replays; r; r = next) {
+        next = r->next;
+        if (r->ch == ch) {
+            *prev = next;
+            imc_replay_release(r);
+            continue;
+        }
+        prev = &r->next;
+    }
+}
+
+void imc_replay_free(void) {
+    IMC_REPLAY *r, *next;
+    IMC_REPLAY_BLOCK *block, *next_block;
+
+    for (r = replays; r; r = next) {
+        next = r->next;
+        free(r);
+    }
+    replays = NULL;
+
+    for (block = replay_blocks; block; block = next_block) {
+        next_block = block->next;
+        imc_replay_block_free(block);
+    }
+    replay_blocks = NULL;
+}
@@ -0,0 +1,251 @@
+/*
+ * MudVault Mesh Who Cache for DikuMUD/Merc
+ *
+ * Answers other MUDs' who requests without walking character_list. Each
+ * online player owns a slot holding their entry already serialized, and
+ * the player hooks rewrite only that slot. The users array is joined from
+ * the slots the first time it is asked for after a change, so a who list
+ * that has not changed is answered with a single copy into the envelope.
+ * The slots double as the index of online players that incoming
+ * multitells are delivered through.
+ *
+ * Author: MudVault Mesh Development Team
+ * License: MIT
+ */
+
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "mudvault_mesh.h"
+
+/* One online player and their serialized who entry */
+typedef struct imc_who_slot {
+    CHAR_DATA *ch;
+    int level;
+    int idle;                      /* Seconds, as last reported */
+    int len;
+    char json[IMC_WHO_ENTRY_LEN];
+} IMC_WHO_SLOT;
+
+/* Slots are kept dense; a player logging out takes the last slot's place */
+static IMC_WHO_SLOT who_slots[IMC_WHO_MAX_PLAYERS];
+static int who_count = 0;
+
+/* "[entry,entry,...]", rebuilt from the slots when who_dirty is set */
+static char who_users[IMC_WHO_MAX_PLAYERS * IMC_WHO_ENTRY_LEN + 3];
+static int who_users_len = 0;
+static bool who_dirty = TRUE;
+
+/* Envelope around who_users */
+static char who_reply[sizeof(who_users) + 1024];
+
+/* =================================================================== */
+/* INTERNALS                                                          */
+/* =================================================================== */
+
+static IMC_WHO_SLOT *imc_who_find(CHAR_DATA *ch) {
+    int i;
+
+    for (i = 0; i < who_count; i++) {
+        if (who_slots[i].ch == ch) {
+            return &who_slots[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Serialize a player's entry into their slot. The title is read fresh each
+ * time, so any hook call also picks up a changed title.
+ */
+static void imc_who_serialize(IMC_WHO_SLOT *slot) {
+    char *name = imc_escape_json(imc_get_name(slot->ch));
+    char *title = imc_escape_json(imc_get_title(slot->ch));
+    int len;
+
+    len = snprintf(slot->json, sizeof(slot->json),
+                   "{\"username\":\"%s\",\"displayName\":\"%s\",%s%s%s"
+                   "\"level\":\"%d\",\"idle\":%d}",
+                   name, name,
+                   *title ? "\"title\":\"" : "", title, *title ? "\"," : "",
+                   slot->level, slot->idle);
+
+    /* A title too long for the slot is left out rather than cut mid-escape */
+    if (len < 0 || len >= (int) sizeof(slot->json)) {
+        len = snprintf(slot->json, sizeof(slot->json),
+                       "{\"username\":\"%s\",\"displayName\":\"%s\","
+                       "\"level\":\"%d\",\"idle\":%d}",
+                       name, name, slot->level, slot->idle);
+    }
+
+    slot->len = len;
+    who_dirty = TRUE;
+
+    free(name);
+    free(title);
+}
+
+static void imc_who_join(void) {
+    char *p = who_users;
+    int i;
+
+    *p++ = '[';
+    for (i = 0; i < who_count; i++) {
+        if (i > 0) *p++ = ',';
+        memcpy(p, who_slots[i].json, who_slots[i].len);
+        p += who_slots[i].len;
+    }
+    *p++ = ']';
+    *p = '\0';
+
+    who_users_len = p - who_users;
+    who_dirty = FALSE;
+}
+
+/* =================================================================== */
+/* PLAYER HOOKS                                                       */
+/* =================================================================== */
+
+void imc_player_login(CHAR_DATA *ch) {
+    IMC_WHO_SLOT *slot;
+
+    if (!ch || IS_NPC(ch)) return;
+
+    if (!(slot = imc_who_find(ch))) {
+        if (who_count >= IMC_WHO_MAX_PLAYERS) {
+            imc_debug("Who cache full, %s left out of who replies", imc_get_name(ch));
+            return;
+        }
+        slot = &who_slots[who_count++];
+        slot->ch = ch;
+        slot->idle = 0;
+    }
+
+    slot->level = imc_get_level(ch);
+    imc_who_serialize(slot);
+}
+
+void imc_player_logout(CHAR_DATA *ch) {
+    IMC_WHO_SLOT *slot = imc_who_find(ch);
+
+    /* A channel replay must not outlive the character it writes to */
+    imc_replay_cancel(ch);
+
+    if (!slot) return;
+
+    if (slot != &who_slots[who_count - 1]) {
+        *slot = who_slots[who_count - 1];
+    }
+    who_count--;
+    who_dirty = TRUE;
+}
+
+/*
+ * idle_time is in seconds. The entry is only rewritten when it changes,
+ * so this can be called every tick.
+ */
+void imc_player_idle(CHAR_DATA *ch, int idle_time) {
+    IMC_WHO_SLOT *slot = imc_who_find(ch);
+
+    if (idle_time < 0) idle_time = 0;
+    if (!slot || slot->idle == idle_time) return;
+
+    slot->idle = idle_time;
+    imc_who_serialize(slot);
+}
+
+void imc_player_levelup(CHAR_DATA *ch, int old_level, int new_level) {
+    IMC_WHO_SLOT *slot = imc_who_find(ch);
+
+    if (!slot || (old_level == new_level && slot->level == new_level)) return;
+
+    slot->level = new_level;
+    imc_who_serialize(slot);
+}
+
+/*
+ * Re-read everything shown in who, e.g. after a title change
+ */
+void imc_player_update(CHAR_DATA *ch) {
+    IMC_WHO_SLOT *slot = imc_who_find(ch);
+
+    if (!slot) return;
+
+    slot->level = imc_get_level(ch);
+    imc_who_serialize(slot);
+}
+
+/*
+ * Find an online player by name, for delivering incoming messages
+ */
+CHAR_DATA *imc_who_player(const char *name) {
+    int i;
+
+    if (!name) return NULL;
+
+    for (i = 0; i < who_count; i++) {
+        if (!strcasecmp(imc_get_name(who_slots[i].ch), name)) {
+            return who_slots[i].ch;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * An online player's idle time in seconds, or -1 if they are not online
+ */
+int imc_who_idle(const char *name) {
+    int i;
+
+    if (!name) return -1;
+
+    for (i = 0; i < who_count; i++) {
+        if (!strcasecmp(imc_get_name(who_slots[i].ch), name)) {
+            return who_slots[i].idle;
+        }
+    }
+    return -1;
+}
+
+/* =================================================================== */
+/* WHO REPLIES                                                        */
+/* =================================================================== */
+
+/*
+ * Answer a who request from another MUD with the cached users array
+ */
+void imc_who_reply(const char *to_mud, const char *to_user) {
+    char uuid[IMC_UUID_LEN];
+    char *mud, *user;
+    int len;
+
+    if (!to_mud || !IMC_IS_CONNECTED()) return;
+
+    if (who_dirty) {
+        imc_who_join();
+    }
+
+    mud = imc_escape_json(to_mud);
+    user = to_user ? imc_escape_json(to_user) : NULL;
+
+    len = snprintf(who_reply, sizeof(who_reply),
+                   "{\"version\":\"%s\",\"id\":\"%s\",\"timestamp\":\"%s\",\"type\":\"who\","
+                   "\"from\":{\"mud\":\"%s\"},\"to\":{\"mud\":\"%s\"%s%s%s},"
+                   "\"payload\":{\"users\":%s,\"request\":false},"
+                   "\"metadata\":{\"priority\":%d,\"ttl\":%d,\"encoding\":\"utf-8\",\"language\":\"en\"}}",
+                   IMC_PROTOCOL_VERSION, imc_generate_uuid(uuid), imc_get_timestamp(),
+                   IMC_MUD_NAME, mud,
+                   user ? ",\"user\":\"" : "", user ? user : "", user ? "\"" : "",
+                   who_users, IMC_MESSAGE_PRIORITY, IMC_MESSAGE_TTL);
+
+    if (len < 0 || len >= (int) sizeof(who_reply)) {
+        imc_log("Who reply to %s does not fit, not sent", to_mud);
+    } else {
+        imc_send_message(who_reply);
+    }
+
+    free(mud);
+    if (user) free(user);
+}
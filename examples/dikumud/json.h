@@ -9,6 +9,9 @@
 char *imc_json_get_string(const char *json, const char *key);
 int   imc_json_get_int(const char *json, const char *key);
 bool  imc_json_get_bool(const char *json, const char *key);
+const char *imc_json_get_array(const char *json, const char *key);
+char *imc_json_array_next(const char **cursor);
+char *imc_json_get_object(const char *json, const char *key);
 
 /* JSON generation functions */
 char *imc_json_create_object(void);
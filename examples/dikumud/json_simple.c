@@ -165,6 +165,120 @@ bool imc_json_get_bool(const char *json, const char *key) {
     return FALSE;
 }
 
+/*
+ * Find a JSON key holding an array and return a cursor just inside the
+ * opening bracket, for use with imc_json_array_next()
+ */
+const char *imc_json_get_array(const char *json, const char *key) {
+    char *search_key;
+    const char *value_start;
+    
+    if (!json || !key) return NULL;
+    
+    /* Build search pattern */
+    search_key = malloc(strlen(key) + 10);
+    sprintf(search_key, "\"%s\":", key);
+    
+    /* Find the key */
+    value_start = strstr(json, search_key);
+    free(search_key);
+    if (!value_start) return NULL;
+    
+    /* Move past the key to the value */
+    value_start = strchr(value_start, ':') + 1;
+    
+    /* Skip whitespace */
+    while (*value_start == ' ' || *value_start == '\t' || 
+           *value_start == '\n' || *value_start == '\r') {
+        value_start++;
+    }
+    
+    return *value_start == '[' ? value_start + 1 : NULL;
+}
+
+/*
+ * Return a copy of the object held by a JSON key, or NULL. Lookups on the
+ * copy only see that object's own keys.
+ */
+char *imc_json_get_object(const char *json, const char *key) {
+    char *search_key;
+    const char *value_start;
+    
+    if (!json || !key) return NULL;
+    
+    /* Build search pattern */
+    search_key = malloc(strlen(key) + 10);
+    sprintf(search_key, "\"%s\":", key);
+    
+    /* Find the key */
+    value_start = strstr(json, search_key);
+    free(search_key);
+    if (!value_start) return NULL;
+    
+    /* Move past the key to the value */
+    value_start = strchr(value_start, ':') + 1;
+    
+    /* Skip whitespace */
+    while (*value_start == ' ' || *value_start == '\t' || 
+           *value_start == '\n' || *value_start == '\r') {
+        value_start++;
+    }
+    
+    /* The object is copied out the same way as an array element */
+    return *value_start == '{' ? imc_json_array_next(&value_start) : NULL;
+}
+
+/*
+ * Return a copy of the next object in an array and advance the cursor,
+ * or NULL at the end of the array. Brackets inside strings are skipped.
+ */
+char *imc_json_array_next(const char **cursor) {
+    const char *start, *p;
+    char *result;
+    int depth = 0;
+    bool in_string = FALSE;
+    
+    if (!cursor || !*cursor) return NULL;
+    
+    /* Find the start of the next object */
+    for (p = *cursor; *p && *p != '{'; p++) {
+        if (*p == ']') {
+            *cursor = p;
+            return NULL;
+        }
+    }
+    if (!*p) {
+        *cursor = p;
+        return NULL;
+    }
+    
+    /* Find its matching closing brace */
+    for (start = p; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && *(p + 1)) p++;
+            else if (*p == '"') in_string = FALSE;
+        } else if (*p == '"') {
+            in_string = TRUE;
+        } else if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && --depth == 0) {
+            break;
+        }
+    }
+    
+    if (!*p) {
+        *cursor = p;
+        return NULL; /* Unterminated object */
+    }
+    
+    result = malloc(p - start + 2);
+    memcpy(result, start, p - start + 1);
+    result[p - start + 1] = '\0';
+    
+    *cursor = p + 1;
+    return result;
+}
+
 /* =================================================================== */
 /* JSON GENERATION FUNCTIONS                                          */
 /* =================================================================== */
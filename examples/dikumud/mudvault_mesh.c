@@ -50,18 +50,32 @@ int imc_startup(void) {
     imc_data->socket = -1;
     imc_data->state = IMC_DISCONNECTED;
     imc_data->buflen = 0;
+    imc_data->bufstart = 0;
+    imc_data->msgstart = -1;
+    imc_data->msglen = 0;
+    imc_data->batched = FALSE;
+    imc_data->capabilities = 0;
     imc_data->last_ping = 0;
     imc_data->last_pong = 0;
     imc_data->connect_time = 0;
     imc_data->reconnect_attempts = 0;
     imc_data->channels = NULL;
     imc_data->muds = NULL;
-    imc_data->history = NULL;
+    imc_data->history_seq = 0;
     imc_data->users = NULL;
     
     /* Load configuration */
     imc_load_config();
     
+    /* Load persisted history and rebuild the search index */
+    imc_history_load();
+    
+    /* Index the finger records of our players */
+    imc_finger_load();
+    
+    /* Start serving the local live feed */
+    imc_feed_start();
+    
     /* Attempt initial connection */
     if (imc_connect() < 0) {
         imc_log("Initial connection failed, will retry later");
@@ -86,6 +100,12 @@ void imc_shutdown(void) {
     
     /* Free all allocated memory */
     /* TODO: Implement proper cleanup of all linked lists */
+    imc_history_free();
+    imc_finger_free();
+    imc_feed_stop();
+    imc_digest_free();
+    imc_pace_free();
+    imc_replay_free();
     
     IMC_FREE(imc_data);
     imc_log("MudVault Mesh shutdown complete");
@@ -115,6 +135,11 @@ void imc_loop(void) {
             
         case IMC_CONNECTING:
         case IMC_AUTHENTICATING:
+            /* Read the auth reply */
+            if (imc_data->state == IMC_AUTHENTICATING) {
+                imc_process_input();
+            }
+            
             /* Check for timeout */
             if (now - imc_data->connect_time > IMC_TIMEOUT) {
                 imc_log("Connection timeout");
@@ -126,6 +151,9 @@ void imc_loop(void) {
             /* Process incoming data */
             imc_process_input();
             
+            /* Release paced messages and adjust send rates */
+            imc_pace_update();
+            
             /* Send periodic ping */
             if (now - imc_data->last_ping > IMC_PING_INTERVAL) {
                 char *ping = imc_create_ping();
@@ -148,6 +176,15 @@ void imc_loop(void) {
             break;
     }
     
+    /* Page out channel replays */
+    imc_replay_update();
+    
+    /* Serve live feed viewers */
+    imc_feed_update();
+    
+    /* Send channel digests that are due */
+    imc_digest_update();
+    
     /* Reset rate limiting counters */
     static time_t last_rate_reset = 0;
     if (now - last_rate_reset >= 60) {
@@ -200,6 +237,11 @@ int imc_connect(void) {
     imc_data->state = IMC_CONNECTED;
     imc_data->connect_time = time(NULL);
     imc_data->buflen = 0;
+    imc_data->bufstart = 0;
+    imc_data->msgstart = -1;
+    imc_data->msglen = 0;
+    imc_data->batched = FALSE;
+    imc_data->capabilities = 0;
     
     /* Send authentication message */
     if (!imc_authenticate()) {
@@ -225,6 +267,9 @@ void imc_disconnect(void) {
     
     imc_data->state = IMC_DISCONNECTED;
     imc_data->buflen = 0;
+    imc_data->bufstart = 0;
+    imc_data->msgstart = -1;
+    imc_data->msglen = 0;
     imc_data->connect_time = time(NULL);
     
     imc_log("Disconnected from MudVault Mesh gateway");
@@ -274,51 +319,157 @@ bool imc_authenticate(void) {
 /* =================================================================== */
 
 /*
- * Process incoming data from the gateway
+ * Hand one complete message to the parser. It is terminated where it lies;
+ * the byte after it belongs to the next frame (or is free space), so it is
+ * put back afterwards. With batching on, each newline-separated line of the
+ * message is parsed on its own.
  */
-void imc_process_input(void) {
-    char *line_start, *line_end;
-    int bytes_read;
-    
-    if (!imc_data || imc_data->socket < 0) return;
+static void imc_dispatch_message(char *msg, int len) {
+    char saved = msg[len];
+    char *line, *nl, *end = msg + len;
+    int sock = imc_data->socket;
     
-    /* Read available data */
-    bytes_read = imc_websocket_recv(imc_data->socket, 
-                                   imc_data->buffer + imc_data->buflen,
-                                   IMC_BUFFER_SIZE - imc_data->buflen - 1);
+    msg[len] = '\0';
     
-    if (bytes_read <= 0) {
-        if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            imc_log("Socket error: %s", strerror(errno));
-            imc_disconnect();
+    if (!imc_data->batched) {
+        if (len > 0) {
+            imc_parse_message(msg);
+        }
+    } else {
+        for (line = msg; line < end && imc_data->socket == sock; line = nl + 1) {
+            nl = memchr(line, '\n', end - line);
+            if (!nl) nl = end;
+            *nl = '\0';
+            if (nl > line) {
+                imc_parse_message(line);
+            }
         }
-        return;
     }
     
-    imc_data->buflen += bytes_read;
-    imc_data->buffer[imc_data->buflen] = '\0';
+    msg[len] = saved;
+}
+
+/*
+ * Act on one decoded frame. Each text message is dispatched as soon as its
+ * final frame arrives. Returns FALSE if the connection was dropped.
+ */
+static bool imc_handle_frame(IMC_WS_FRAME *frame) {
+    int sock = imc_data->socket;
+    char *msg;
+    int len;
+    
+    switch (frame->opcode) {
+        case WS_OPCODE_TEXT:
+        case WS_OPCODE_BINARY:
+            if (frame->fin) {
+                imc_dispatch_message(frame->payload, frame->len);
+                return imc_data->socket == sock;
+            }
+            imc_data->msgstart = frame->payload - imc_data->buffer;
+            imc_data->msglen = frame->len;
+            return TRUE;
+            
+        case WS_OPCODE_CONTINUATION:
+            if (imc_data->msgstart < 0) {
+                imc_log("WebSocket continuation frame with no message to continue");
+                imc_disconnect();
+                return FALSE;
+            }
+            /* Fragments are rare; slide this one down against the rest */
+            memmove(imc_data->buffer + imc_data->msgstart + imc_data->msglen,
+                    frame->payload, frame->len);
+            imc_data->msglen += frame->len;
+            if (!frame->fin) return TRUE;
+            
+            msg = imc_data->buffer + imc_data->msgstart;
+            len = imc_data->msglen;
+            imc_data->msgstart = -1;
+            imc_data->msglen = 0;
+            imc_dispatch_message(msg, len);
+            return imc_data->socket == sock;
+            
+        case WS_OPCODE_PING:
+            imc_websocket_send_control(sock, WS_OPCODE_PONG, frame->payload, frame->len);
+            return TRUE;
+            
+        case WS_OPCODE_PONG:
+            return TRUE;
+            
+        case WS_OPCODE_CLOSE:
+            imc_log("WebSocket close frame received");
+            imc_disconnect();
+            return FALSE;
+            
+        default:
+            imc_debug("Ignoring WebSocket frame with opcode %d", frame->opcode);
+            return TRUE;
+    }
+}
+
+/*
+ * Process incoming data from the gateway. Reads until the socket is empty
+ * and dispatches every message whose last byte has arrived. Frames are
+ * decoded in place; once everything read has been consumed the buffer
+ * starts over at the front, so bytes are only moved when a frame straddles
+ * the end of the buffer.
+ */
+void imc_process_input(void) {
+    IMC_WS_FRAME frame;
+    int sock, bytes_read, used, keep;
     
-    /* Process complete messages */
-    line_start = imc_data->buffer;
-    while ((line_end = strchr(line_start, '\n')) != NULL) {
-        *line_end = '\0';
+    if (!imc_data || imc_data->socket < 0) return;
+    sock = imc_data->socket;
+    
+    for (;;) {
+        /* Out of room: move the unfinished frame or message to the front */
+        if (imc_data->buflen == IMC_BUFFER_SIZE - 1) {
+            keep = imc_data->msgstart >= 0 ? imc_data->msgstart : imc_data->bufstart;
+            if (keep == 0) {
+                imc_log("Incoming message does not fit in %d bytes", IMC_BUFFER_SIZE);
+                imc_disconnect();
+                return;
+            }
+            memmove(imc_data->buffer, imc_data->buffer + keep, imc_data->buflen - keep);
+            imc_data->buflen -= keep;
+            imc_data->bufstart -= keep;
+            if (imc_data->msgstart >= 0) {
+                imc_data->msgstart -= keep;
+            }
+        }
         
-        /* Parse and handle the message */
-        if (strlen(line_start) > 0) {
-            imc_parse_message(line_start);
+        /* One byte is kept back so a message can always be terminated */
+        bytes_read = recv(sock, imc_data->buffer + imc_data->buflen,
+                          IMC_BUFFER_SIZE - 1 - imc_data->buflen, 0);
+        if (bytes_read == 0) {
+            imc_log("Gateway closed the connection");
+            imc_disconnect();
+            return;
         }
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                imc_log("Socket error: %s", strerror(errno));
+                imc_disconnect();
+            }
+            return;
+        }
+        imc_data->buflen += bytes_read;
         
-        line_start = line_end + 1;
-    }
-    
-    /* Move remaining data to start of buffer */
-    if (line_start > imc_data->buffer) {
-        int remaining = imc_data->buflen - (line_start - imc_data->buffer);
-        if (remaining > 0) {
-            memmove(imc_data->buffer, line_start, remaining);
+        while ((used = imc_websocket_decode(imc_data->buffer + imc_data->bufstart,
+                                            imc_data->buflen - imc_data->bufstart,
+                                            IMC_BUFFER_SIZE - 1, &frame)) > 0) {
+            imc_data->bufstart += used;
+            if (!imc_handle_frame(&frame)) return;
+        }
+        if (used < 0) {
+            imc_disconnect();
+            return;
+        }
+        
+        if (imc_data->bufstart == imc_data->buflen && imc_data->msgstart < 0) {
+            imc_data->bufstart = 0;
+            imc_data->buflen = 0;
         }
-        imc_data->buflen = remaining;
-        imc_data->buffer[imc_data->buflen] = '\0';
     }
 }
 
@@ -326,6 +477,28 @@ void imc_process_input(void) {
  * Send a message to the gateway
  */
 void imc_send_message(const char *json) {
+    char *type;
+
+    if (!imc_data || !json) return;
+
+    /*
+     * Connection control goes straight out; everything else is paced so
+     * we stay under the gateway's rate limits.
+     */
+    type = imc_json_get_string(json, "type");
+    if (!type || !strcmp(type, "auth") || !strcmp(type, "ping") ||
+        !strcmp(type, "pong")) {
+        imc_send_raw(json);
+    } else {
+        imc_pace_submit(json, imc_pace_class_for_type(type));
+    }
+    if (type) free(type);
+}
+
+/*
+ * Send a message immediately, bypassing pacing
+ */
+void imc_send_raw(const char *json) {
     if (!imc_data || imc_data->socket < 0 || !json) return;
     
     if (imc_websocket_send(imc_data->socket, json) < 0) {
@@ -342,7 +515,7 @@ void imc_send_message(const char *json) {
  * Parse an incoming JSON message
  */
 bool imc_parse_message(const char *json) {
-    char *type_str, *from_mud, *from_user, *to_mud, *to_user;
+    char *type_str, *from, *to, *from_mud, *from_user, *to_mud, *to_user;
     imc_msg_type_t type;
     
     if (!json || strlen(json) == 0) return FALSE;
@@ -371,6 +544,7 @@ bool imc_parse_message(const char *json) {
     else if (strcmp(type_str, "ping") == 0) type = IMC_MSG_PING;
     else if (strcmp(type_str, "pong") == 0) type = IMC_MSG_PONG;
     else if (strcmp(type_str, "error") == 0) type = IMC_MSG_ERROR;
+    else if (strcmp(type_str, "multitell") == 0) type = IMC_MSG_MULTITELL;
     else {
         imc_log("Unknown message type: %s", type_str);
         free(type_str);
@@ -378,11 +552,15 @@ bool imc_parse_message(const char *json) {
     }
     free(type_str);
     
-    /* Extract routing information */
-    from_mud = imc_json_get_string(json, "from.mud");
-    from_user = imc_json_get_string(json, "from.user");
-    to_mud = imc_json_get_string(json, "to.mud");
-    to_user = imc_json_get_string(json, "to.user");
+    /* Extract routing information from the envelope's from and to objects */
+    from = imc_json_get_object(json, "from");
+    to = imc_json_get_object(json, "to");
+    from_mud = imc_json_get_string(from, "mud");
+    from_user = imc_json_get_string(from, "user");
+    to_mud = imc_json_get_string(to, "mud");
+    to_user = imc_json_get_string(to, "user");
+    if (from) free(from);
+    if (to) free(to);
     
     /* Handle the message */
     imc_handle_message(type, from_mud, from_user, to_mud, to_user, json);
@@ -404,6 +582,7 @@ void imc_handle_message(imc_msg_type_t type, const char *from_mud,
                        const char *to_user, const char *payload) {
     CHAR_DATA *ch;
     char *message, *channel, *action;
+    bool digested;
     
     switch (type) {
         case IMC_MSG_TELL:
@@ -417,38 +596,99 @@ void imc_handle_message(imc_msg_type_t type, const char *from_mud,
                         from_user ? from_user : "Someone", 
                         from_mud ? from_mud : "Unknown", 
                         message));
-                    imc_add_history(IMC_MSG_TELL, 
-                        sprintf(buf2, "%s@%s", from_user, from_mud), 
-                        to_user, message);
+                    snprintf(buf2, sizeof(buf2), "%s@%s",
+                             from_user ? from_user : "Someone",
+                             from_mud ? from_mud : "Unknown");
+                    imc_add_history(IMC_MSG_TELL, buf2, to_user, message);
                 }
                 free(message);
             }
             break;
             
+        case IMC_MSG_MULTITELL:
+            /*
+             * One envelope carries every recipient on this MUD; each is
+             * looked up in the who cache's index of online players
+             */
+            {
+                const char *body = strstr(payload, "\"payload\":");
+                const char *cursor = body ? imc_json_get_array(body, "recipients") : NULL;
+                char from[IMC_MAX_USERNAME_LEN + IMC_MAX_MUDNAME_LEN + 2];
+                char line[MAX_STRING_LENGTH];
+                char *recipient, *user;
+                bool color;
+                
+                snprintf(from, sizeof(from), "%s@%s",
+                         from_user ? from_user : "Someone",
+                         from_mud ? from_mud : "Unknown");
+                
+                message = body ? imc_json_get_string(body, "message") : NULL;
+                while (message && (recipient = imc_json_array_next(&cursor)) != NULL) {
+                    user = imc_json_get_string(recipient, "user");
+                    if (user && (ch = imc_who_player(user)) != NULL) {
+                        color = PRF_FLAGGED(ch, PRF_COLOR_1) || PRF_FLAGGED(ch, PRF_COLOR_2);
+                        snprintf(line, sizeof(line), "%s%s tells you: %s%s\r\n",
+                                 color ? IMC_COLOR_TELL : "", from, message,
+                                 color ? IMC_COLOR_NORMAL : "");
+                        imc_send_to_char(ch, line);
+                        imc_add_history(IMC_MSG_TELL, from, user, message);
+                    }
+                    if (user) free(user);
+                    free(recipient);
+                }
+                if (message) free(message);
+            }
+            break;
+            
         case IMC_MSG_CHANNEL:
             /* Handle channel message */
-            channel = imc_json_get_string(payload, "payload.channel");
-            message = imc_json_get_string(payload, "payload.message");
-            action = imc_json_get_string(payload, "payload.action");
-            
-            if (channel && message) {
-                /* Broadcast to all players on this channel */
-                for (ch = character_list; ch; ch = ch->next) {
-                    if (IS_NPC(ch)) continue;
-                    if (!imc_is_on_channel(channel, imc_get_name(ch))) continue;
+            {
+                const char *body = strstr(payload, "\"payload\":");
+                char line[MAX_STRING_LENGTH];
+                
+                channel = body ? imc_json_get_string(body, "channel") : NULL;
+                message = body ? imc_json_get_string(body, "message") : NULL;
+                action = body ? imc_json_get_string(body, "action") : NULL;
+                
+                if (channel && action && strcmp(action, "history") == 0) {
+                    /* Bulk history for a channel replay */
+                    imc_replay_receive(channel, payload);
+                } else if (channel && message) {
+                    /* Local viewers get the message as received */
+                    imc_feed_publish(channel, payload, strlen(payload));
                     
+                    /* Players taking this channel as a digest get it in the next block */
+                    digested = imc_digest_channel(channel, from_user, from_mud, message, action);
+                    
+                    /* Format once, in plain and color, for every listener */
+                    snprintf(buf2, sizeof(buf2), "%s@%s",
+                             from_user ? from_user : "Someone",
+                             from_mud ? from_mud : "Unknown");
                     if (action && strcmp(action, "join") == 0) {
-                        IMC_SEND_CHANNEL_COLOR(ch, sprintf(buf,
-                            "[%s] %s@%s has joined the channel.\r\n",
-                            channel, from_user, from_mud));
+                        snprintf(buf, sizeof(buf), "[%s] %s has joined the channel.\r\n",
+                                 channel, buf2);
                     } else if (action && strcmp(action, "leave") == 0) {
-                        IMC_SEND_CHANNEL_COLOR(ch, sprintf(buf,
-                            "[%s] %s@%s has left the channel.\r\n",
-                            channel, from_user, from_mud));
+                        snprintf(buf, sizeof(buf), "[%s] %s has left the channel.\r\n",
+                                 channel, buf2);
                     } else {
-                        IMC_SEND_CHANNEL_COLOR(ch, sprintf(buf,
-                            "[%s] %s@%s: %s\r\n",
-                            channel, from_user, from_mud, message));
+                        snprintf(buf, sizeof(buf), "[%s] %s: %s\r\n",
+                                 channel, buf2, message);
+                    }
+                    snprintf(line, sizeof(line), "%s%s%s",
+                             IMC_COLOR_CHANNEL, buf, IMC_COLOR_NORMAL);
+                    
+                    /* Broadcast to all players on this channel */
+                    for (ch = character_list; ch; ch = ch->next) {
+                        if (IS_NPC(ch)) continue;
+                        if (!imc_is_on_channel(channel, imc_get_name(ch))) continue;
+                        if (digested && imc_digest_subscribed(channel, imc_get_name(ch))) continue;
+                        
+                        imc_send_to_char(ch, PRF_FLAGGED(ch, PRF_COLOR_1) || PRF_FLAGGED(ch, PRF_COLOR_2)
+                                             ? line : buf);
+                    }
+                    
+                    if (!action || strcmp(action, "message") == 0) {
+                        imc_add_history(IMC_MSG_CHANNEL, buf2, channel, message);
                     }
                 }
             }
@@ -459,9 +699,24 @@ void imc_handle_message(imc_msg_type_t type, const char *from_mud,
             break;
             
         case IMC_MSG_WHO:
+            /* Someone asking who is on here is answered from the who cache */
+            if (imc_json_get_bool(payload, "request")) {
+                imc_who_reply(from_mud, from_user);
+            }
             /* Handle who response - this is more complex, see full implementation */
             break;
             
+        case IMC_MSG_FINGER:
+            /* Requests for our players are answered from the finger index */
+            if (imc_json_get_bool(payload, "request")) {
+                const char *body = strstr(payload, "\"payload\":");
+                char *target = body ? imc_json_get_string(body, "user") : NULL;
+                
+                imc_finger_reply(from_mud, from_user, target ? target : to_user);
+                if (target) free(target);
+            }
+            break;
+            
         case IMC_MSG_PING:
             /* Respond to ping */
             {
@@ -479,12 +734,37 @@ void imc_handle_message(imc_msg_type_t type, const char *from_mud,
             imc_data->last_pong = time(NULL);
             break;
             
+        case IMC_MSG_AUTH:
+            /*
+             * The gateway's reply lists the capabilities it enabled for this
+             * session; a gateway that predates negotiation lists none.
+             */
+            if (imc_data->state == IMC_AUTHENTICATING) {
+                imc_data->capabilities = imc_json_get_int(payload, "capabilities") & IMC_CAPABILITIES;
+                imc_data->batched = (imc_data->capabilities & IMC_CAP_BATCHING) != 0;
+                imc_data->state = IMC_AUTHENTICATED;
+                imc_log("Authenticated with MudVault Mesh gateway (capabilities 0x%x)",
+                        imc_data->capabilities);
+            }
+            break;
+            
         case IMC_MSG_ERROR:
             /* Handle error message */
             {
-                int code = imc_json_get_int(payload, "payload.code");
-                char *error_msg = imc_json_get_string(payload, "payload.message");
+                const char *body = strstr(payload, "\"payload\":");
+                int code = body ? imc_json_get_int(body, "code") : 0;
+                char *error_msg = body ? imc_json_get_string(body, "message") : NULL;
+                char *details = body ? imc_json_get_object(body, "details") : NULL;
+                char *channel_name = details ? imc_json_get_string(details, "channel") : NULL;
                 imc_log("ERROR %d: %s", code, error_msg ? error_msg : "Unknown error");
+                if (code == IMC_GW_ERR_RATE_LIMITED) {
+                    imc_pace_rate_limited(body);
+                } else if (channel_name) {
+                    /* A refused history request; replay what we have locally */
+                    imc_replay_error(channel_name);
+                }
+                if (channel_name) free(channel_name);
+                if (details) free(details);
                 if (error_msg) free(error_msg);
             }
             break;
@@ -500,33 +780,123 @@ void imc_handle_message(imc_msg_type_t type, const char *from_mud,
 /* =================================================================== */
 
 /*
- * Generate a UUID for message IDs
+ * Fill buf with random bytes from the kernel, falling back to the clock
+ * and pid when /dev/urandom is unavailable
  */
-char *imc_generate_uuid(void) {
-    static char uuid[40];
+static void imc_random_bytes(unsigned char *buf, size_t len) {
     struct timeval tv;
-    
+    unsigned long mix;
+    size_t got = 0;
+    FILE *fp;
+
+    if ((fp = fopen("/dev/urandom", "rb")) != NULL) {
+        got = fread(buf, 1, len, fp);
+        fclose(fp);
+    }
+    if (got == len) return;
+
+    gettimeofday(&tv, NULL);
+    mix = (unsigned long)tv.tv_sec * 1000003UL ^ (unsigned long)tv.tv_usec ^
+          ((unsigned long)getpid() << 16);
+    for (; got < len; got++) {
+        mix = mix * 6364136223846793005UL + 1442695040888963407UL;
+        buf[got] = (unsigned char)(mix >> 56);
+    }
+}
+
+/*
+ * Write the low 'digits' nibbles of val as lowercase hex
+ */
+static char *imc_put_hex(char *out, unsigned long long val, int digits) {
+    static const char hex[] = "0123456789abcdef";
+    int i;
+
+    for (i = digits - 1; i >= 0; i--) {
+        out[i] = hex[val & 0xF];
+        val >>= 4;
+    }
+    return out + digits;
+}
+
+/*
+ * Generate a UUIDv7 message ID into buf (IMC_UUID_LEN bytes)
+ *
+ * The layout is 48 bits of Unix milliseconds, a 12-bit sequence and 62
+ * bits chosen once per process from /dev/urandom. The sequence restarts
+ * each millisecond and borrows the next millisecond when it runs out, so
+ * IDs from one process are strictly increasing and never repeat, and the
+ * random tail keeps separate processes apart.
+ */
+char *imc_generate_uuid(char *buf) {
+    static unsigned long long node = 0;
+    static unsigned long long last_ms = 0;
+    static unsigned int seq = 0;
+    struct timeval tv;
+    unsigned long long ms;
+    char *p = buf;
+
+    if (!node) {
+        unsigned char seed[8];
+        int i;
+
+        imc_random_bytes(seed, sizeof(seed));
+        for (i = 0; i < 8; i++) node = (node << 8) | seed[i];
+        node = (node & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+    }
+
     gettimeofday(&tv, NULL);
-    sprintf(uuid, "%08x-%04x-%04x-%04x-%012lx",
-            (unsigned int)tv.tv_sec,
-            (unsigned short)((tv.tv_usec >> 16) & 0xFFFF),
-            (unsigned short)(tv.tv_usec & 0xFFFF),
-            (unsigned short)(rand() & 0xFFFF),
-            (unsigned long)((rand() << 16) | rand()));
-    
-    return strdup(uuid);
+    ms = (unsigned long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+    if (ms > last_ms) {
+        last_ms = ms;
+        seq = 0;
+    } else if (++seq > 0xFFF) {
+        last_ms++;
+        seq = 0;
+    }
+
+    p = imc_put_hex(p, last_ms >> 16, 8);
+    *p++ = '-';
+    p = imc_put_hex(p, last_ms & 0xFFFF, 4);
+    *p++ = '-';
+    p = imc_put_hex(p, 0x7000 | seq, 4);
+    *p++ = '-';
+    p = imc_put_hex(p, node >> 48, 4);
+    *p++ = '-';
+    p = imc_put_hex(p, node & 0xFFFFFFFFFFFFULL, 12);
+    *p = '\0';
+
+    return buf;
 }
 
 /*
  * Get current timestamp in ISO format
+ *
+ * The string is cached and only rebuilt when the second changes; within
+ * the same minute just the seconds digits are rewritten. The result is
+ * valid until the next call.
  */
-char *imc_get_timestamp(void) {
-    static char timestamp[64];
+const char *imc_get_timestamp(void) {
+    static char timestamp[32];
+    static time_t cached = 0;
     time_t now = time(NULL);
-    struct tm *tm_info = gmtime(&now);
-    
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", tm_info);
-    return strdup(timestamp);
+    struct tm tm_info;
+
+    if (now == cached) return timestamp;
+
+    if (cached && now > cached && now / 60 == cached / 60) {
+        int sec = (int)(now % 60);
+
+        /* "YYYY-MM-DDTHH:MM:SSZ" - seconds live at offset 17 */
+        timestamp[17] = '0' + sec / 10;
+        timestamp[18] = '0' + sec % 10;
+    } else {
+        gmtime_r(&now, &tm_info);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &tm_info);
+    }
+
+    cached = now;
+    return timestamp;
 }
 
 /*
@@ -634,11 +1004,11 @@ void imc_save_config(void) {
  */
 char *imc_create_auth(void) {
     char *json = imc_json_create_object();
-    char *uuid = imc_generate_uuid();
-    char *timestamp = imc_get_timestamp();
+    char uuid[IMC_UUID_LEN];
+    const char *timestamp = imc_get_timestamp();
     
     imc_json_add_string(&json, "version", IMC_PROTOCOL_VERSION);
-    imc_json_add_string(&json, "id", uuid);
+    imc_json_add_string(&json, "id", imc_generate_uuid(uuid));
     imc_json_add_string(&json, "timestamp", timestamp);
     imc_json_add_string(&json, "type", "auth");
     
@@ -656,6 +1026,12 @@ char *imc_create_auth(void) {
     char *payload = imc_json_create_object();
     imc_json_add_string(&payload, "mudName", IMC_MUD_NAME);
     imc_json_add_string(&payload, "token", IMC_API_KEY);
+    imc_json_add_int(&payload, "capabilities", IMC_CAPABILITIES);
+    
+    /* Parameters for the capabilities offered */
+    char *params = imc_json_create_object();
+    imc_json_add_int(&params, "maxBatchBytes", IMC_BUFFER_SIZE - 16);
+    imc_json_add_object(&payload, "params", params);
     imc_json_add_object(&json, "payload", payload);
     
     /* Add metadata object */
@@ -666,10 +1042,9 @@ char *imc_create_auth(void) {
     imc_json_add_string(&metadata, "language", "en");
     imc_json_add_object(&json, "metadata", metadata);
     
-    free(uuid);
-    free(timestamp);
     free(from_obj);
     free(to_obj);
+    free(params);
     free(payload);
     free(metadata);
     
@@ -681,11 +1056,11 @@ char *imc_create_auth(void) {
  */
 char *imc_create_ping(void) {
     char *json = imc_json_create_object();
-    char *uuid = imc_generate_uuid();
-    char *timestamp = imc_get_timestamp();
+    char uuid[IMC_UUID_LEN];
+    const char *timestamp = imc_get_timestamp();
     
     imc_json_add_string(&json, "version", IMC_PROTOCOL_VERSION);
-    imc_json_add_string(&json, "id", uuid);
+    imc_json_add_string(&json, "id", imc_generate_uuid(uuid));
     imc_json_add_string(&json, "timestamp", timestamp);
     imc_json_add_string(&json, "type", "ping");
     
@@ -711,8 +1086,6 @@ char *imc_create_ping(void) {
     imc_json_add_string(&metadata, "language", "en");
     imc_json_add_object(&json, "metadata", metadata);
     
-    free(uuid);
-    free(timestamp);
     free(from_obj);
     free(to_obj);
     free(payload);
@@ -721,5 +1094,77 @@ char *imc_create_ping(void) {
     return imc_json_finalize(json);
 }
 
+/*
+ * Create a multitell: one message for several players, which the gateway
+ * splits into one envelope per destination MUD
+ */
+char *imc_create_multitell(const char *from_user, const IMC_TARGET *targets,
+                           int count, const char *message) {
+    char uuid[IMC_UUID_LEN];
+    char *user, *text, *recipients, *json, *p;
+    size_t size;
+    int i;
+
+    if (!from_user || !targets || count <= 0 || !message) return NULL;
+
+    /* Usernames and MUD names are already validated, so need no escaping */
+    size = 3;
+    for (i = 0; i < count; i++) {
+        size += strlen(targets[i].mud) + strlen(targets[i].user) + 24;
+    }
+    if (!(recipients = malloc(size))) return NULL;
+
+    p = recipients;
+    *p++ = '[';
+    for (i = 0; i < count; i++) {
+        p += sprintf(p, "%s{\"mud\":\"%s\",\"user\":\"%s\"}",
+                     i > 0 ? "," : "", targets[i].mud, targets[i].user);
+    }
+    *p++ = ']';
+    *p = '\0';
+
+    user = imc_escape_json(from_user);
+    text = imc_escape_json(message);
+
+    size = strlen(recipients) + strlen(user) + strlen(text) + 512;
+    if ((json = malloc(size)) != NULL) {
+        snprintf(json, size,
+                 "{\"version\":\"%s\",\"id\":\"%s\",\"timestamp\":\"%s\",\"type\":\"multitell\","
+                 "\"from\":{\"mud\":\"%s\",\"user\":\"%s\"},\"to\":{\"mud\":\"Gateway\"},"
+                 "\"payload\":{\"message\":\"%s\",\"recipients\":%s},"
+                 "\"metadata\":{\"priority\":%d,\"ttl\":%d,\"encoding\":\"utf-8\",\"language\":\"en\"}}",
+                 IMC_PROTOCOL_VERSION, imc_generate_uuid(uuid), imc_get_timestamp(),
+                 IMC_MUD_NAME, user, text, recipients,
+                 IMC_MESSAGE_PRIORITY, IMC_MESSAGE_TTL);
+    }
+
+    free(recipients);
+    free(user);
+    free(text);
+    return json;
+}
+
+/*
+ * Send one message to several players. A gateway that did not agree to
+ * multitells at authentication gets one tell per player instead.
+ */
+void imc_send_multitell(const char *from_user, const IMC_TARGET *targets,
+                        int count, const char *message) {
+    char *json;
+    int i;
+
+    if (!(imc_data->capabilities & IMC_CAP_MULTITELL)) {
+        for (i = 0; i < count; i++) {
+            imc_send_tell(from_user, targets[i].mud, targets[i].user, message);
+        }
+        return;
+    }
+
+    if ((json = imc_create_multitell(from_user, targets, count, message)) != NULL) {
+        imc_send_message(json);
+        free(json);
+    }
+}
+
 /* Additional message creation functions would go here... */
 /* This is a partial implementation to show the structure */
\ No newline at end of file
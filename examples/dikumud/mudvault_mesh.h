@@ -55,9 +55,19 @@ typedef enum {
     IMC_MSG_PING,
     IMC_MSG_PONG,
     IMC_MSG_ERROR,
+    IMC_MSG_MULTITELL,
     IMC_MSG_UNKNOWN
 } imc_msg_type_t;
 
+/* Outbound pacing classes */
+typedef enum {
+    IMC_PACE_TELL = 0,
+    IMC_PACE_CHANNEL,
+    IMC_PACE_QUERY,
+    IMC_PACE_OTHER,
+    IMC_PACE_CLASSES
+} imc_pace_class_t;
+
 /* Channel actions */
 typedef enum {
     IMC_CHAN_MESSAGE = 0,
@@ -100,14 +110,14 @@ typedef struct imc_channel {
     struct imc_channel *next;
 } IMC_CHANNEL;
 
-/* Message history entry */
+/* Message history entry, as read back from the history blocks */
 typedef struct imc_history {
-    char message[IMC_MAX_MESSAGE_LEN];
-    char from[IMC_MAX_USERNAME_LEN];
-    char to[IMC_MAX_USERNAME_LEN];
+    const char *message;
+    const char *from;
+    const char *to;
     time_t timestamp;
     imc_msg_type_t type;
-    struct imc_history *next;
+    long seq;                      /* Sequence number, used as index offset */
 } IMC_HISTORY;
 
 /* Connected MUD information */
@@ -124,19 +134,64 @@ typedef struct imc_mud_info {
     struct imc_mud_info *next;
 } IMC_MUD_INFO;
 
+/* A parsed player@mud target */
+typedef struct imc_target {
+    char user[IMC_MAX_USERNAME_LEN + 1];
+    char mud[IMC_MAX_MUDNAME_LEN + 1];
+} IMC_TARGET;
+
+/* WebSocket opcodes */
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT         0x1
+#define WS_OPCODE_BINARY       0x2
+#define WS_OPCODE_CLOSE        0x8
+#define WS_OPCODE_PING         0x9
+#define WS_OPCODE_PONG         0xA
+
+/* Capability bits negotiated in the auth exchange; must match the gateway */
+#define IMC_CAP_BATCHING       (1 << 0)    /* Several newline-separated messages per frame */
+#define IMC_CAP_COMPRESSION    (1 << 1)    /* Reserved */
+#define IMC_CAP_BINARY         (1 << 2)    /* Reserved */
+#define IMC_CAP_RESUME         (1 << 3)    /* Reserved */
+#define IMC_CAP_INTEREST       (1 << 4)    /* Reserved */
+#define IMC_CAP_DIRECTORY      (1 << 5)    /* Reserved */
+#define IMC_CAP_MULTITELL      (1 << 6)    /* One envelope for several recipients */
+
+/* What this client implements */
+#define IMC_CAPABILITIES       ((IMC_FRAME_BATCHES ? IMC_CAP_BATCHING : 0) | IMC_CAP_MULTITELL)
+
+/* A WebSocket frame decoded in place in the input buffer */
+typedef struct imc_ws_frame {
+    int opcode;
+    bool fin;                      /* Last frame of its message */
+    char *payload;                 /* Unmasked, points into the input buffer */
+    int len;
+} IMC_WS_FRAME;
+
+/* Abbreviation trie over a subcommand table */
+typedef struct imc_cmd_trie {
+    struct imc_trie_node *nodes;
+    int count;
+} IMC_CMD_TRIE;
+
 /* Main IMC data structure */
 typedef struct imc_data {
     int socket;                     /* WebSocket connection */
     imc_state_t state;             /* Connection state */
     char buffer[IMC_BUFFER_SIZE];  /* Input buffer */
     int buflen;                    /* Buffer length */
+    int bufstart;                  /* Offset of the first undecoded frame */
+    int msgstart;                  /* Offset of a fragmented message, -1 if none */
+    int msglen;                    /* Bytes of that message reassembled so far */
+    bool batched;                  /* Messages in a frame are newline-separated */
+    int capabilities;              /* Agreed with the gateway at authentication */
     time_t last_ping;              /* Last ping sent */
     time_t last_pong;              /* Last pong received */
     time_t connect_time;           /* When we connected */
     int reconnect_attempts;        /* Reconnection attempts */
     IMC_CHANNEL *channels;         /* Channel list */
     IMC_MUD_INFO *muds;           /* Connected MUDs */
-    IMC_HISTORY *history;         /* Message history */
+    long history_seq;             /* Last history sequence number */
     IMC_USER_INFO *users;         /* Cached user info */
 } IMC_DATA;
 
@@ -166,6 +221,7 @@ bool imc_authenticate(void);
 /* Message handling */
 void imc_process_input(void);
 void imc_send_message(const char *json);
+void imc_send_raw(const char *json);
 bool imc_parse_message(const char *json);
 void imc_handle_message(imc_msg_type_t type, const char *from_mud, 
                        const char *from_user, const char *to_mud, 
@@ -192,6 +248,8 @@ char *imc_create_pong(long timestamp);
 /* Message sending functions */
 void imc_send_tell(const char *from_user, const char *to_mud, 
                   const char *to_user, const char *message);
+void imc_send_multitell(const char *from_user, const IMC_TARGET *targets, 
+                       int count, const char *message);
 void imc_send_emote(const char *from_user, const char *to_mud, 
                    const char *action);
 void imc_send_emoteto(const char *from_user, const char *to_mud, 
@@ -232,16 +290,58 @@ void imc_add_history(imc_msg_type_t type, const char *from, const char *to,
                     const char *message);
 void imc_show_history(CHAR_DATA *ch, imc_msg_type_t type, int count);
 void imc_clear_history(void);
+void imc_history_load(void);
+void imc_history_free(void);
+void imc_history_search(CHAR_DATA *ch, const char *query, int count);
+int  imc_history_channel(const char *channel, int count, long *latest,
+                        void (*visit)(const IMC_HISTORY *h, void *arg),
+                        void *arg);
+
+/* Channel replay on join */
+void imc_replay_channel(CHAR_DATA *ch, const char *channel);
+void imc_replay_receive(const char *channel, const char *json);
+void imc_replay_error(const char *channel);
+void imc_replay_update(void);
+void imc_replay_cancel(CHAR_DATA *ch);
+void imc_replay_free(void);
 
 /* Player integration functions */
 void imc_player_login(CHAR_DATA *ch);
 void imc_player_logout(CHAR_DATA *ch);
 void imc_player_idle(CHAR_DATA *ch, int idle_time);
 void imc_player_levelup(CHAR_DATA *ch, int old_level, int new_level);
+void imc_player_update(CHAR_DATA *ch);
+
+/* Who replies for our own MUD */
+void imc_who_reply(const char *to_mud, const char *to_user);
+CHAR_DATA *imc_who_player(const char *name);
+int imc_who_idle(const char *name);
+
+/* Finger records for our own players */
+void imc_finger_load(void);
+void imc_finger_update(const IMC_USER_INFO *info);
+void imc_finger_reply(const char *to_mud, const char *to_user, const char *name);
+void imc_finger_free(void);
+
+/* Live channel feed for local viewers */
+void imc_feed_start(void);
+void imc_feed_update(void);
+void imc_feed_publish(const char *channel, const char *json, int len);
+void imc_feed_stop(void);
+
+/* Channel digests */
+bool imc_digest_toggle(const char *channel, const char *name);
+void imc_digest_remove(const char *channel, const char *name);
+bool imc_digest_subscribed(const char *channel, const char *name);
+bool imc_digest_channel(const char *channel, const char *from_user,
+                        const char *from_mud, const char *message,
+                        const char *action);
+void imc_digest_update(void);
+void imc_digest_free(void);
 
 /* Utility functions */
-char *imc_generate_uuid(void);
-char *imc_get_timestamp(void);
+char *imc_generate_uuid(char *buf);
+const char *imc_get_timestamp(void);
 bool imc_validate_mudname(const char *mudname);
 bool imc_validate_username(const char *username);
 bool imc_validate_channel(const char *channel);
@@ -254,13 +354,17 @@ void imc_debug(const char *fmt, ...);
 int  imc_websocket_connect(const char *host, int port);
 bool imc_websocket_handshake(int sock, const char *host, int port);
 int  imc_websocket_send(int sock, const char *data);
-int  imc_websocket_recv(int sock, char *buffer, int bufsize);
+int  imc_websocket_decode(char *buf, int len, int bufsize, IMC_WS_FRAME *frame);
+int  imc_websocket_send_control(int sock, int opcode, const char *data, int len);
 void imc_websocket_close(int sock);
 
 /* JSON utility functions */
 char *imc_json_get_string(const char *json, const char *key);
 int   imc_json_get_int(const char *json, const char *key);
 bool  imc_json_get_bool(const char *json, const char *key);
+const char *imc_json_get_array(const char *json, const char *key);
+char *imc_json_get_object(const char *json, const char *key);
+char *imc_json_array_next(const char **cursor);
 char *imc_json_create_object(void);
 void  imc_json_add_string(char **json, const char *key, const char *value);
 void  imc_json_add_int(char **json, const char *key, int value);
@@ -268,10 +372,28 @@ void  imc_json_add_bool(char **json, const char *key, bool value);
 void  imc_json_add_object(char **json, const char *key, const char *object);
 char *imc_json_finalize(char *json);
 
+/* Command parsing */
+int  imc_parse_target(const char *input, IMC_TARGET *target);
+int  imc_parse_targets(const char *input, IMC_TARGET *targets, int max, 
+                      int *count);
+const char *imc_target_error(int result);
+bool imc_cmd_trie_build(IMC_CMD_TRIE *trie, const void *table,
+                        size_t entry_size, int count);
+int  imc_cmd_lookup(const IMC_CMD_TRIE *trie, const char *word);
+void imc_cmd_trie_free(IMC_CMD_TRIE *trie);
+
 /* Rate limiting */
 bool imc_check_rate_limit(const char *type, const char *identifier);
 void imc_reset_rate_limits(void);
 
+/* Adaptive send pacing */
+void imc_pace_submit(const char *json, imc_pace_class_t pace_class);
+void imc_pace_update(void);
+void imc_pace_rate_limited(const char *json);
+imc_pace_class_t imc_pace_class_for_type(const char *type);
+void imc_pace_show_stats(CHAR_DATA *ch);
+void imc_pace_free(void);
+
 /* Configuration */
 void imc_load_config(void);
 void imc_save_config(void);
@@ -298,6 +420,7 @@ ACMD(do_channels);
 ACMD(do_channel);
 ACMD(do_chjoin);
 ACMD(do_chleave);
+ACMD(do_chdigest);
 ACMD(do_chwho);
 ACMD(do_imchelp);
 ACMD(do_imcadmin);
@@ -318,6 +441,7 @@ DO_FUN(do_channels);
 DO_FUN(do_channel);
 DO_FUN(do_chjoin);
 DO_FUN(do_chleave);
+DO_FUN(do_chdigest);
 DO_FUN(do_chwho);
 DO_FUN(do_imchelp);
 DO_FUN(do_imcadmin);
@@ -333,6 +457,9 @@ DO_FUN(do_imcdebug);
 #define IMC_GET_STATE()        (imc_data ? imc_data->state : IMC_DISCONNECTED)
 #define IMC_UPTIME()           (imc_data ? time(NULL) - imc_data->connect_time : 0)
 
+/* Size of the buffer imc_generate_uuid() writes into, with terminator */
+#define IMC_UUID_LEN           37
+
 /* Color macros for messages */
 #define IMC_SEND_COLOR(ch, color, msg) \
     do { \
@@ -387,4 +514,14 @@ DO_FUN(do_imcdebug);
 #define IMC_ERR_NETWORK         -9
 #define IMC_ERR_MEMORY          -10
 
+/* imc_parse_target() and imc_parse_targets() results */
+#define IMC_TARGET_OK           0
+#define IMC_TARGET_NO_MUD       -1
+#define IMC_TARGET_BAD_USER     -2
+#define IMC_TARGET_BAD_MUD      -3
+#define IMC_TARGET_TOO_MANY     -4
+
+/* Gateway error codes (ErrorCodes in the gateway's types) */
+#define IMC_GW_ERR_RATE_LIMITED 1006
+
 #endif /* MUDVAULT_MESH_H */
\ No newline at end of file
@@ -20,7 +20,7 @@
 
 /*
  * imctell - Send a tell to a player on another MUD
- * Usage: imctell player@mudname message
+ * Usage: imctell player@mudname[,player@mudname...] message
  */
 #ifdef CIRCLE_MUD
 ACMD(do_imctell)
@@ -29,7 +29,8 @@ DO_FUN(do_imctell)
 #endif
 {
     char target[MAX_INPUT_LENGTH], message[MAX_INPUT_LENGTH];
-    char *at_pos, *mudname, *username;
+    IMC_TARGET to[IMC_TELL_MAX_TARGETS];
+    int count, result;
     
     if (!IMC_IS_CONNECTED()) {
         send_to_char(ch, "MudVault Mesh is not connected.\r\n");
@@ -44,29 +45,14 @@ DO_FUN(do_imctell)
     two_arguments(argument, target, message);
     
     if (!*target || !*message) {
-        send_to_char(ch, "Usage: imctell <player@mudname> <message>\r\n");
-        send_to_char(ch, "Example: imctell john@othermud Hello there!\r\n");
+        send_to_char(ch, "Usage: imctell <player@mudname>[,<player@mudname>...] <message>\r\n");
+        send_to_char(ch, "Example: imctell john@othermud,mary@thirdmud Hello there!\r\n");
         return;
     }
     
-    /* Parse target into username@mudname */
-    at_pos = strchr(target, '@');
-    if (!at_pos) {
-        send_to_char(ch, "You must specify the target as player@mudname.\r\n");
-        return;
-    }
-    
-    *at_pos = '\0';
-    username = target;
-    mudname = at_pos + 1;
-    
-    if (!IMC_VALID_USERNAME(username)) {
-        send_to_char(ch, "Invalid username format.\r\n");
-        return;
-    }
-    
-    if (!IMC_VALID_MUDNAME(mudname)) {
-        send_to_char(ch, "Invalid MUD name format.\r\n");
+    /* Parse targets into username@mudname, several separated by commas */
+    if ((result = imc_parse_targets(target, to, IMC_TELL_MAX_TARGETS, &count)) != IMC_TARGET_OK) {
+        send_to_char(ch, "%s\r\n", imc_target_error(result));
         return;
     }
     
@@ -82,16 +68,19 @@ DO_FUN(do_imctell)
         return;
     }
     
-    /* Send the tell */
-    imc_send_tell(imc_get_name(ch), mudname, username, message);
+    /* Send the tell; several recipients share one multitell */
+    if (count == 1) {
+        imc_send_tell(imc_get_name(ch), to[0].mud, to[0].user, message);
+    } else {
+        imc_send_multitell(imc_get_name(ch), to, count, message);
+    }
     
     /* Confirm to sender */
     IMC_SEND_TELL_COLOR(ch, sprintf(buf, 
-        "You tell %s@%s: %s\r\n", username, mudname, message));
+        "You tell %s: %s\r\n", target, message));
     
     /* Add to history */
-    imc_add_history(IMC_MSG_TELL, imc_get_name(ch), 
-                   sprintf(buf2, "%s@%s", username, mudname), message);
+    imc_add_history(IMC_MSG_TELL, imc_get_name(ch), target, message);
 }
 
 /*
@@ -143,7 +132,8 @@ ACMD(do_imcemote) {
  */
 ACMD(do_imcemoteto) {
     char target[MAX_INPUT_LENGTH], action[MAX_INPUT_LENGTH];
-    char *at_pos, *mudname, *username;
+    IMC_TARGET to;
+    int result;
     
     if (!IMC_IS_CONNECTED()) {
         send_to_char(ch, "MudVault Mesh is not connected.\r\n");
@@ -159,23 +149,18 @@ ACMD(do_imcemoteto) {
     }
     
     /* Parse target */
-    at_pos = strchr(target, '@');
-    if (!at_pos) {
-        send_to_char(ch, "You must specify the target as player@mudname.\r\n");
+    if ((result = imc_parse_target(target, &to)) != IMC_TARGET_OK) {
+        send_to_char(ch, "%s\r\n", imc_target_error(result));
         return;
     }
     
-    *at_pos = '\0';
-    username = target;
-    mudname = at_pos + 1;
-    
     /* Send the directed emote */
-    imc_send_emoteto(imc_get_name(ch), mudname, username, action);
+    imc_send_emoteto(imc_get_name(ch), to.mud, to.user, action);
     
     /* Confirm to sender */
     IMC_SEND_EMOTE_COLOR(ch, sprintf(buf, 
         "You emote to %s@%s: %s %s %s\r\n", 
-        username, mudname, imc_get_name(ch), action, username));
+        to.user, to.mud, imc_get_name(ch), action, to.user));
 }
 
 /* =================================================================== */
@@ -228,7 +213,8 @@ ACMD(do_imcwho) {
  */
 ACMD(do_imcfinger) {
     char target[MAX_INPUT_LENGTH];
-    char *at_pos, *mudname, *username;
+    IMC_TARGET to;
+    int result;
     
     if (!IMC_IS_CONNECTED()) {
         send_to_char(ch, "MudVault Mesh is not connected.\r\n");
@@ -248,25 +234,15 @@ ACMD(do_imcfinger) {
     }
     
     /* Parse target */
-    at_pos = strchr(target, '@');
-    if (!at_pos) {
-        send_to_char(ch, "You must specify the target as player@mudname.\r\n");
-        return;
-    }
-    
-    *at_pos = '\0';
-    username = target;
-    mudname = at_pos + 1;
-    
-    if (!IMC_VALID_USERNAME(username) || !IMC_VALID_MUDNAME(mudname)) {
-        send_to_char(ch, "Invalid username or MUD name format.\r\n");
+    if ((result = imc_parse_target(target, &to)) != IMC_TARGET_OK) {
+        send_to_char(ch, "%s\r\n", imc_target_error(result));
         return;
     }
     
     /* Send finger request */
-    imc_send_finger_request(mudname, username);
+    imc_send_finger_request(to.mud, to.user);
     
-    send_to_char(ch, "Requesting information about %s@%s...\r\n", username, mudname);
+    send_to_char(ch, "Requesting information about %s@%s...\r\n", to.user, to.mud);
 }
 
 /*
@@ -346,6 +322,7 @@ ACMD(do_imcstats) {
             time(NULL) - imc_data->last_ping);
         send_to_char(ch, "Last Pong: %ld seconds ago\r\n", 
             time(NULL) - imc_data->last_pong);
+        imc_pace_show_stats(ch);
     } else {
         send_to_char(ch, "Reconnect attempts: %d/%d\r\n", 
             imc_data->reconnect_attempts, IMC_MAX_RECONNECTS);
@@ -429,6 +406,7 @@ ACMD(do_channel) {
     
     /* Send channel message */
     imc_send_channel_message(imc_get_name(ch), channel_name, message);
+    imc_add_history(IMC_MSG_CHANNEL, imc_get_name(ch), channel_name, message);
     
     /* Echo to sender */
     IMC_SEND_CHANNEL_COLOR(ch, sprintf(buf, 
@@ -475,6 +453,9 @@ ACMD(do_chjoin) {
     
     IMC_SEND_INFO_COLOR(ch, sprintf(buf, 
         "You have joined channel '%s'.\r\n", channel_name));
+    
+    /* Catch them up on what was said recently */
+    imc_replay_channel(ch, channel_name);
 }
 
 /*
@@ -508,11 +489,43 @@ ACMD(do_chleave) {
     
     /* Leave the channel */
     imc_leave_channel(channel_name, imc_get_name(ch));
+    imc_digest_remove(channel_name, imc_get_name(ch));
     
     IMC_SEND_INFO_COLOR(ch, sprintf(buf, 
         "You have left channel '%s'.\r\n", channel_name));
 }
 
+/*
+ * chdigest - Take a channel as a periodic digest instead of line by line
+ */
+ACMD(do_chdigest) {
+    char channel_name[MAX_INPUT_LENGTH];
+    
+    one_argument(argument, channel_name);
+    
+    if (!*channel_name) {
+        send_to_char(ch, "Usage: chdigest <channel>\r\n");
+        return;
+    }
+    
+    if (!IMC_VALID_CHANNEL(channel_name)) {
+        send_to_char(ch, "Invalid channel name format.\r\n");
+        return;
+    }
+    
+    if (!imc_is_on_channel(channel_name, imc_get_name(ch))) {
+        send_to_char(ch, "You are not on channel '%s'.\r\n", channel_name);
+        return;
+    }
+    
+    if (imc_digest_toggle(channel_name, imc_get_name(ch))) {
+        send_to_char(ch, "Channel '%s' will now arrive as a digest every %d seconds.\r\n",
+                     channel_name, IMC_DIGEST_INTERVAL);
+    } else {
+        send_to_char(ch, "Channel '%s' will now arrive line by line.\r\n", channel_name);
+    }
+}
+
 /*
  * chwho - Show who is on a channel
  */
@@ -549,9 +562,28 @@ ACMD(do_chwho) {
  */
 ACMD(do_imchistory) {
     char type[MAX_INPUT_LENGTH], count_str[MAX_INPUT_LENGTH];
+    char *query;
     int count = 10;
     imc_msg_type_t msg_type = IMC_MSG_TELL;
     
+    /* imchistory search <terms> - answered from the history index */
+    query = one_argument(argument, type);
+    if (strcmp(type, "search") == 0) {
+        IMC_SKIP_SPACES(query);
+        if (!*query) {
+            send_to_char(ch, "Usage: imchistory search <words> [user:<name>] [mud:<mud>]\r\n");
+            send_to_char(ch, "       [channel:<channel>] [to:<name>] [type:<type>] [since:<age>] [until:<age>]\r\n");
+            send_to_char(ch, "Example: imchistory search user:bob channel:gossip since:7d until:6d\r\n");
+            return;
+        }
+        
+        send_to_char(ch, "History Search: %s\r\n", query);
+        send_to_char(ch, "====================\r\n");
+        
+        imc_history_search(ch, query, IMC_HISTORY_SEARCH_MAX);
+        return;
+    }
+    
     two_arguments(argument, type, count_str);
     
     if (*count_str) {
@@ -601,11 +633,13 @@ ACMD(do_imchelp) {
     send_to_char(ch, "  channels                        - List available channels\r\n");
     send_to_char(ch, "  chjoin <channel>                - Join a channel\r\n");
     send_to_char(ch, "  chleave <channel>               - Leave a channel\r\n");
+    send_to_char(ch, "  chdigest <channel>              - Toggle digest delivery\r\n");
     send_to_char(ch, "  channel <channel> <message>     - Send message to channel\r\n");
     send_to_char(ch, "  chwho <channel>                 - See who's on a channel\r\n\r\n");
     
     send_to_char(ch, "Utility:\r\n");
     send_to_char(ch, "  imchistory [type] [count]       - Show message history\r\n");
+    send_to_char(ch, "  imchistory search <query>       - Search message history\r\n");
     send_to_char(ch, "  imchelp                         - This help screen\r\n\r\n");
     
     if (GET_LEVEL(ch) >= LVL_IMMORT) {
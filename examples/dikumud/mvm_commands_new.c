@@ -34,11 +34,35 @@ ACMD(do_mvm_stats);
 ACMD(do_mvm_help);
 
 /* Helper functions */
-char *parse_player_mud(char *input, char **player, char **mud);
 bool is_valid_mud_name(char *name);
 bool is_valid_player_name(char *name);
 void show_mvm_help(struct char_data *ch);
 
+/*
+ * Subcommand table. Order sets abbreviation priority, so "l" is still
+ * locate; the name must stay the first member for imc_cmd_trie_build().
+ */
+static const struct mvm_subcommand {
+    const char *name;
+    ACMD((*func));
+} mvm_subcommands[] = {
+    { "tell",     do_mvm_tell },
+    { "who",      do_mvm_who },
+    { "finger",   do_mvm_finger },
+    { "locate",   do_mvm_locate },
+    { "channels", do_mvm_channels },
+    { "join",     do_mvm_join },
+    { "leave",    do_mvm_leave },
+    { "list",     do_mvm_list },
+    { "stats",    do_mvm_stats },
+    { "help",     do_mvm_help }
+};
+
+#define MVM_NUM_SUBCOMMANDS \
+    ((int)(sizeof(mvm_subcommands) / sizeof(mvm_subcommands[0])))
+
+static IMC_CMD_TRIE mvm_trie;
+
 /* =================================================================== */
 /* MAIN MVM COMMAND - Handles all subcommands                         */
 /* =================================================================== */
@@ -46,6 +70,7 @@ void show_mvm_help(struct char_data *ch);
 ACMD(do_mvm) {
     char subcmd[MAX_INPUT_LENGTH];
     char *args;
+    int i;
     
     /* Check if mesh is active */
     if (!mvm_is_active()) {
@@ -62,59 +87,54 @@ ACMD(do_mvm) {
     }
     
     /* Route to appropriate subcommand */
-    if (is_abbrev(subcmd, "tell")) {
-        do_mvm_tell(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "who")) {
-        do_mvm_who(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "finger")) {
-        do_mvm_finger(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "locate")) {
-        do_mvm_locate(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "channels")) {
-        do_mvm_channels(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "join")) {
-        do_mvm_join(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "leave")) {
-        do_mvm_leave(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "list")) {
-        do_mvm_list(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "stats")) {
-        do_mvm_stats(ch, args, cmd, subcmd);
-    } else if (is_abbrev(subcmd, "help")) {
-        do_mvm_help(ch, args, cmd, subcmd);
-    } else {
+    if (!mvm_trie.nodes &&
+        !imc_cmd_trie_build(&mvm_trie, mvm_subcommands,
+                            sizeof(mvm_subcommands[0]), MVM_NUM_SUBCOMMANDS)) {
+        send_to_char(ch, "MudVault Mesh commands are unavailable right now.\r\n");
+        return;
+    }
+    
+    if ((i = imc_cmd_lookup(&mvm_trie, subcmd)) < 0) {
         send_to_char(ch, "Unknown MudVault Mesh subcommand '%s'. Type 'mvm help' for usage.\r\n", subcmd);
+        return;
     }
+    
+    mvm_subcommands[i].func(ch, args, cmd, i);
 }
 
 /*
- * mvm tell <player@mud> <message>
- * Send a tell to a player on another MUD
+ * mvm tell <player@mud>[,<player@mud>...] <message>
+ * Send a tell to one or more players on other MUDs
  */
 ACMD(do_mvm_tell) {
     char target[MAX_INPUT_LENGTH];
-    char *player, *mud, *message;
+    char *message;
+    IMC_TARGET to[IMC_TELL_MAX_TARGETS];
+    int count, result;
     
     /* Parse arguments */
     argument = one_argument(argument, target);
     message = argument;
     
     if (!*target || !*message) {
-        send_to_char(ch, "Usage: mvm tell <player@mud> <message>\r\n");
+        send_to_char(ch, "Usage: mvm tell <player@mud>[,<player@mud>...] <message>\r\n");
         return;
     }
     
-    /* Parse player@mud format */
-    if (!parse_player_mud(target, &player, &mud)) {
-        send_to_char(ch, "Invalid format. Use: player@mudname\r\n");
+    /* Parse player@mud format, several separated by commas */
+    if ((result = imc_parse_targets(target, to, IMC_TELL_MAX_TARGETS, &count)) != IMC_TARGET_OK) {
+        send_to_char(ch, "%s\r\n", imc_target_error(result));
         return;
     }
     
-    /* Send the tell */
-    if (mvm_send_tell(ch, player, mud, message)) {
-        send_to_char(ch, "You tell %s@%s: %s\r\n", player, mud, message);
+    /* Several recipients share one multitell */
+    if (count > 1) {
+        imc_send_multitell(imc_get_name(ch), to, count, message);
+        send_to_char(ch, "You tell %s: %s\r\n", target, message);
+    } else if (mvm_send_tell(ch, to[0].user, to[0].mud, message)) {
+        send_to_char(ch, "You tell %s@%s: %s\r\n", to[0].user, to[0].mud, message);
     } else {
-        send_to_char(ch, "Failed to send tell to %s@%s.\r\n", player, mud);
+        send_to_char(ch, "Failed to send tell to %s@%s.\r\n", to[0].user, to[0].mud);
     }
 }
 
@@ -150,7 +170,7 @@ ACMD(do_mvm_who) {
 void show_mvm_help(struct char_data *ch) {
     send_to_char(ch, "\r\nMudVault Mesh Commands:\r\n");
     send_to_char(ch, "========================\r\n\r\n");
-    send_to_char(ch, "mvm tell <player@mud> <message> - Send tell to player on another MUD\r\n");
+    send_to_char(ch, "mvm tell <player@mud>[,...] <message> - Send tell to players on other MUDs\r\n");
     send_to_char(ch, "mvm who [mud]                   - Show who's online (all MUDs or specific)\r\n");
     send_to_char(ch, "mvm finger <player@mud>         - Get detailed info about a player\r\n");
     send_to_char(ch, "mvm locate <player>             - Find which MUD a player is on\r\n");
@@ -164,21 +184,3 @@ void show_mvm_help(struct char_data *ch) {
     send_to_char(ch, "  mvm who othermud\r\n");
     send_to_char(ch, "  mvm join gossip\r\n");
 }
-
-/*
- * Parse "player@mud" format
- */
-char *parse_player_mud(char *input, char **player, char **mud) {
-    char *at_sign;
-    static char buffer[MAX_INPUT_LENGTH];
-    
-    strcpy(buffer, input);
-    at_sign = strchr(buffer, '@');
-    if (!at_sign) return FALSE;
-    
-    *at_sign = '\0';
-    *player = buffer;
-    *mud = at_sign + 1;
-    
-    return (*player && **player && *mud && **mud);
-}
\ No newline at end of file
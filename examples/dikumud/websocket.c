@@ -21,10 +21,6 @@
 
 /* WebSocket constants */
 #define WS_MAGIC_STRING "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
-#define WS_OPCODE_TEXT 0x1
-#define WS_OPCODE_CLOSE 0x8
-#define WS_OPCODE_PING 0x9
-#define WS_OPCODE_PONG 0xA
 
 /* WebSocket frame structure */
 typedef struct {
@@ -353,97 +349,88 @@ int imc_websocket_send(int sock, const char *data) {
 }
 
 /*
- * Receive WebSocket frame
+ * Send a control frame (close, ping or pong). Control payloads are at most
+ * 125 bytes, so the frame always fits on the stack.
  */
-int imc_websocket_recv(int sock, char *buffer, int bufsize) {
-    unsigned char header[14];
-    int header_len = 2;
-    int bytes_read, payload_len, i;
-    unsigned char mask[4];
-    bool masked;
+int imc_websocket_send_control(int sock, int opcode, const char *data, int len) {
+    unsigned char frame[2 + 4 + 125];
+    int i, bytes_sent;
     
-    /* Read basic header */
-    bytes_read = recv(sock, header, 2, 0);
-    if (bytes_read <= 0) {
-        if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            imc_log("WebSocket recv error: %s", strerror(errno));
-        }
-        return bytes_read;
+    if (len < 0 || len > 125) return -1;
+    
+    frame[0] = 0x80 | opcode; /* FIN=1 */
+    frame[1] = 0x80 | len;    /* MASK=1 */
+    for (i = 0; i < 4; i++) {
+        frame[2 + i] = rand() % 256;
+    }
+    for (i = 0; i < len; i++) {
+        frame[6 + i] = data[i] ^ frame[2 + (i % 4)];
     }
     
-    if (bytes_read < 2) {
-        /* Incomplete header */
-        return 0;
+    bytes_sent = send(sock, frame, 6 + len, 0);
+    if (bytes_sent < 0) {
+        imc_log("Failed to send WebSocket control frame: %s", strerror(errno));
     }
+    return bytes_sent;
+}
+
+/*
+ * Decode the frame at the start of buf without copying it: the payload is
+ * unmasked where it lies and frame->payload points at it. Returns the
+ * frame's total length, 0 if fewer than that many bytes have arrived, or
+ * -1 if the frame could never fit in a buffer of bufsize bytes.
+ */
+int imc_websocket_decode(char *buf, int len, int bufsize, IMC_WS_FRAME *frame) {
+    unsigned char *p = (unsigned char *) buf;
+    unsigned char *mask = NULL;
+    long payload_len;
+    int header_len = 2, i;
+    
+    if (len < 2) return 0;
     
-    /* Parse header */
-    masked = (header[1] & 0x80) != 0;
-    payload_len = header[1] & 0x7F;
+    frame->fin = (p[0] & 0x80) != 0;
+    frame->opcode = p[0] & 0x0F;
+    payload_len = p[1] & 0x7F;
     
     /* Handle extended payload length */
     if (payload_len == 126) {
-        bytes_read = recv(sock, header + 2, 2, 0);
-        if (bytes_read < 2) return 0;
-        payload_len = (header[2] << 8) | header[3];
-        header_len += 2;
+        if (len < 4) return 0;
+        payload_len = (p[2] << 8) | p[3];
+        header_len = 4;
     } else if (payload_len == 127) {
-        bytes_read = recv(sock, header + 2, 8, 0);
-        if (bytes_read < 8) return 0;
-        /* For simplicity, only handle 32-bit lengths */
-        payload_len = (header[6] << 24) | (header[7] << 16) | 
-                     (header[8] << 8) | header[9];
-        header_len += 8;
+        if (len < 10) return 0;
+        /* Anything past 31 bits is far beyond any buffer we have */
+        if (p[2] || p[3] || p[4] || p[5] || (p[6] & 0x80)) return -1;
+        payload_len = ((long) p[6] << 24) | (p[7] << 16) | (p[8] << 8) | p[9];
+        header_len = 10;
     }
     
-    /* Read mask if present */
-    if (masked) {
-        bytes_read = recv(sock, mask, 4, 0);
-        if (bytes_read < 4) return 0;
+    if (p[1] & 0x80) {
+        mask = p + header_len;
+        header_len += 4;
     }
     
-    /* Check buffer size */
-    if (payload_len >= bufsize) {
-        imc_log("WebSocket frame too large: %d bytes", payload_len);
+    if (header_len + payload_len >= bufsize) {
+        imc_log("WebSocket frame too large: %ld bytes", payload_len);
         return -1;
     }
+    if (len < header_len + payload_len) return 0;
     
-    /* Read payload */
-    bytes_read = recv(sock, buffer, payload_len, 0);
-    if (bytes_read <= 0) return bytes_read;
-    
-    /* Unmask payload if necessary */
-    if (masked) {
-        for (i = 0; i < bytes_read; i++) {
-            buffer[i] ^= mask[i % 4];
+    if (mask) {
+        for (i = 0; i < payload_len; i++) {
+            p[header_len + i] ^= mask[i % 4];
         }
     }
     
-    /* Null-terminate */
-    buffer[bytes_read] = '\0';
-    
-    /* Handle control frames */
-    unsigned char opcode = header[0] & 0x0F;
-    if (opcode == WS_OPCODE_CLOSE) {
-        imc_log("WebSocket close frame received");
-        return -1;
-    } else if (opcode == WS_OPCODE_PING) {
-        /* Respond with pong */
-        /* TODO: Implement ping/pong handling */
-        return 0;
-    } else if (opcode == WS_OPCODE_PONG) {
-        /* Pong received */
-        return 0;
-    }
-    
-    return bytes_read;
+    frame->payload = buf + header_len;
+    frame->len = (int) payload_len;
+    return header_len + (int) payload_len;
 }
 
 /*
  * Close WebSocket connection
  */
 void imc_websocket_close(int sock) {
-    unsigned char close_frame[2] = {0x88, 0x00}; /* Close frame */
-    
-    send(sock, close_frame, 2, 0);
+    imc_websocket_send_control(sock, WS_OPCODE_CLOSE, NULL, 0);
     close(sock);
 }
\ No newline at end of file
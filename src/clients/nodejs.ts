@@ -1,10 +1,11 @@
 import WebSocket from 'ws';
 import { EventEmitter } from 'events';
-import { MudVaultMessage, MessageEndpoint, UserInfo } from '../types';
+import { MudVaultMessage, MessageEndpoint, UserInfo, TellRecipient } from '../types';
 import { validateMessage } from '../utils/validation';
 import { 
   createMessage, 
   createTellMessage, 
+  createMultiTellMessage,
   createChannelMessage, 
   createWhoRequestMessage,
   createFingerRequestMessage,
@@ -295,6 +296,17 @@ export class MudVaultClient extends EventEmitter {
     this.sendMessage(tellMessage);
   }
 
+  // One line to several users, possibly on different MUDs
+  public sendMultiTell(recipients: TellRecipient[], message: string, user?: string): void {
+    const multiTellMessage = createMultiTellMessage(
+      { mud: this.options.mudName, user: user || 'System' },
+      recipients,
+      message
+    );
+
+    this.sendMessage(multiTellMessage);
+  }
+
   public sendChannelMessage(channel: string, message: string, user?: string): void {
     const channelMessage = createChannelMessage(
       { mud: this.options.mudName, user: user || 'System' },
@@ -1,4 +1,5 @@
 import dotenv from 'dotenv';
+import cluster from 'cluster';
 import express from 'express';
 import cors from 'cors';
 import helmet from 'helmet';
@@ -9,6 +10,7 @@ import redisService from './services/redis';
 import userService from './services/user';
 import channelService from './services/channel';
 import logger from './utils/logger';
+import { runWorkers, workerCount } from './services/workers';
 
 // Load environment variables
 dotenv.config();
@@ -230,9 +232,14 @@ async function startServer() {
   }
 }
 
-// Start the server
+// Start the server, or a primary that runs one per worker
 if (require.main === module) {
-  startServer();
+  const workers = workerCount();
+  if (workers > 1 && cluster.isPrimary) {
+    runWorkers(workers);
+  } else {
+    startServer();
+  }
 }
 
 export default app;
\ No newline at end of file
@@ -0,0 +1,166 @@
+/**
+ * Generic cell rate algorithm limiter. Each key keeps one number, its
+ * theoretical arrival time (TAT); a request is allowed when pushing the TAT
+ * forward by one emission interval keeps it within the burst allowance of
+ * now. Decisions are made in memory with no I/O.
+ *
+ * To keep the limit roughly global across gateway nodes, reconcile() adds
+ * each key's local usage to a shared Redis counter in one pipeline and
+ * charges the usage other nodes added since the last sync to the local TAT.
+ */
+
+export interface GcraOptions {
+  keyPrefix: string;
+  points: number;          // Requests allowed per duration
+  duration: number;        // Seconds
+  blockDuration?: number;  // Seconds a key stays blocked once it goes over
+  tolerance?: number;      // Fraction of the full burst allowed at once
+}
+
+export interface GcraResult {
+  allowed: boolean;
+  remainingPoints: number;
+  msBeforeNext: number;
+}
+
+// The subset of a node-redis client reconcile() needs
+export interface GcraPipeline {
+  incrBy(key: string, increment: number): GcraPipeline;
+  pExpire(key: string, milliseconds: number): GcraPipeline;
+  execAsPipeline(): Promise<unknown[]>;
+}
+
+export interface GcraStore {
+  multi(): GcraPipeline;
+}
+
+interface KeyState {
+  tat: number;
+  blockedUntil: number;
+  pending: number;  // Local usage not yet added to the shared counter
+  synced: number;   // Shared counter value at the last sync, -1 before the first
+}
+
+export class GcraLimiter {
+  public readonly keyPrefix: string;
+  public readonly points: number;
+  public readonly burstPoints: number;  // Largest cost a single consume can be allowed
+  private readonly interval: number;
+  private readonly burst: number;
+  private readonly blockMs: number;
+  private readonly counterTtlMs: number;
+  private states: Map<string, KeyState> = new Map();
+
+  constructor(options: GcraOptions) {
+    const tolerance = options.tolerance ?? parseFloat(process.env.RATE_LIMIT_TOLERANCE || '1');
+
+    this.keyPrefix = options.keyPrefix;
+    this.points = options.points;
+    this.interval = (options.duration * 1000) / options.points;
+    this.burstPoints = Math.max(1, Math.floor(options.points * tolerance));
+    this.burst = this.interval * Math.max(1, options.points * tolerance);
+    this.blockMs = (options.blockDuration || 0) * 1000;
+    this.counterTtlMs = options.duration * 2000;
+  }
+
+  public consume(key: string, cost: number = 1): GcraResult {
+    const now = Date.now();
+    let state = this.states.get(key);
+    if (!state) {
+      state = { tat: now, blockedUntil: 0, pending: 0, synced: -1 };
+      this.states.set(key, state);
+    }
+
+    if (state.blockedUntil > now) {
+      return { allowed: false, remainingPoints: 0, msBeforeNext: state.blockedUntil - now };
+    }
+
+    const tat = Math.max(state.tat, now) + this.interval * cost;
+    if (tat - now > this.burst) {
+      if (this.blockMs > 0) {
+        state.blockedUntil = now + this.blockMs;
+        return { allowed: false, remainingPoints: 0, msBeforeNext: this.blockMs };
+      }
+      return { allowed: false, remainingPoints: 0, msBeforeNext: Math.ceil(tat - now - this.burst) };
+    }
+
+    state.tat = tat;
+    state.pending += cost;
+    return {
+      allowed: true,
+      remainingPoints: Math.floor((this.burst - (tat - now)) / this.interval),
+      msBeforeNext: Math.ceil(tat - now)
+    };
+  }
+
+  public get(key: string): GcraResult | null {
+    const state = this.states.get(key);
+    if (!state) {
+      return null;
+    }
+
+    const now = Date.now();
+    const used = Math.max(state.tat - now, 0);
+    const blocked = state.blockedUntil > now;
+    return {
+      allowed: !blocked && used + this.interval <= this.burst,
+      remainingPoints: blocked ? 0 : Math.floor((this.burst - used) / this.interval),
+      msBeforeNext: blocked ? state.blockedUntil - now : Math.ceil(used)
+    };
+  }
+
+  public delete(key: string): void {
+    this.states.delete(key);
+  }
+
+  public size(): number {
+    return this.states.size;
+  }
+
+  /**
+   * Push local usage to the shared counters and pull in everyone else's.
+   * Keys that have fully recovered and have nothing to report are dropped.
+   */
+  public async reconcile(store: GcraStore): Promise<void> {
+    const now = Date.now();
+    const keys: string[] = [];
+    const sent: number[] = [];
+    const pipeline = store.multi();
+
+    for (const [key, state] of this.states) {
+      if (state.pending === 0 && state.tat <= now && state.blockedUntil <= now) {
+        this.states.delete(key);
+        continue;
+      }
+
+      const counter = `${this.keyPrefix}:${key}`;
+      pipeline.incrBy(counter, state.pending).pExpire(counter, this.counterTtlMs);
+      keys.push(key);
+      sent.push(state.pending);
+    }
+
+    if (keys.length === 0) {
+      return;
+    }
+
+    const replies = await pipeline.execAsPipeline();
+
+    for (let i = 0; i < keys.length; i++) {
+      const state = this.states.get(keys[i]);
+      const total = Number(replies[i * 2]);
+      if (!state || !Number.isFinite(total)) {
+        continue;
+      }
+
+      state.pending = Math.max(state.pending - sent[i], 0);
+
+      // Counter growth beyond our own contribution came from other nodes
+      const remote = state.synced < 0 ? 0 : total - state.synced - sent[i];
+      if (remote > 0) {
+        const current = Date.now();
+        state.tat = Math.min(Math.max(state.tat, current) + this.interval * remote, current + this.burst);
+      }
+      state.synced = total;
+    }
+  }
+}
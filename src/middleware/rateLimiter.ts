@@ -1,8 +1,8 @@
-import { RateLimiterRedis } from 'rate-limiter-flexible';
 import { Request, Response, NextFunction } from 'express';
 import { createClient } from 'redis';
 import logger from '../utils/logger';
 import { AuthenticatedRequest } from './auth';
+import { GcraLimiter, GcraStore } from './gcra';
 
 const redisClient = createClient({
   url: process.env.REDIS_URL || 'redis://localhost:6379',
@@ -14,8 +14,7 @@ redisClient.connect().catch(console.error);
 // Rate limiting configurations
 const rateLimiterConfigs = {
   // Global API rate limiter
-  api: new RateLimiterRedis({
-    storeClient: redisClient,
+  api: new GcraLimiter({
     keyPrefix: 'rl_api',
     points: parseInt(process.env.RATE_LIMIT_MAX_REQUESTS || '100'),
     duration: parseInt(process.env.RATE_LIMIT_WINDOW_MS || '60000') / 1000,
@@ -23,8 +22,7 @@ const rateLimiterConfigs = {
   }),
 
   // Per-MUD rate limiter
-  mud: new RateLimiterRedis({
-    storeClient: redisClient,
+  mud: new GcraLimiter({
     keyPrefix: 'rl_mud',
     points: 200, // More generous for authenticated MUDs
     duration: 60,
@@ -32,8 +30,7 @@ const rateLimiterConfigs = {
   }),
 
   // Authentication endpoint rate limiter
-  auth: new RateLimiterRedis({
-    storeClient: redisClient,
+  auth: new GcraLimiter({
     keyPrefix: 'rl_auth',
     points: 20, // More reasonable for auth attempts
     duration: 300, // 5 minutes
@@ -41,8 +38,7 @@ const rateLimiterConfigs = {
   }),
 
   // WebSocket connection rate limiter
-  websocket: new RateLimiterRedis({
-    storeClient: redisClient,
+  websocket: new GcraLimiter({
     keyPrefix: 'rl_ws',
     points: 25, // 25 connections per IP (better for MUD reconnections)
     duration: 60,
@@ -50,8 +46,7 @@ const rateLimiterConfigs = {
   }),
 
   // Message rate limiter (for WebSocket messages)
-  message: new RateLimiterRedis({
-    storeClient: redisClient,
+  message: new GcraLimiter({
     keyPrefix: 'rl_msg',
     points: 300, // 300 messages per minute per MUD (more generous)
     duration: 60,
@@ -59,8 +54,7 @@ const rateLimiterConfigs = {
   }),
 
   // Channel message rate limiter
-  channel: new RateLimiterRedis({
-    storeClient: redisClient,
+  channel: new GcraLimiter({
     keyPrefix: 'rl_channel',
     points: 150, // 150 channel messages per minute (more generous)
     duration: 60,
@@ -68,8 +62,7 @@ const rateLimiterConfigs = {
   }),
 
   // Tell message rate limiter
-  tell: new RateLimiterRedis({
-    storeClient: redisClient,
+  tell: new GcraLimiter({
     keyPrefix: 'rl_tell',
     points: 30, // 30 tells per minute
     duration: 60,
@@ -77,34 +70,63 @@ const rateLimiterConfigs = {
   })
 };
 
+// Limiters for checkPriorityRateLimit, one per priority level
+const priorityLimiters: Map<number, GcraLimiter> = new Map();
+
+/*
+ * Limits are decided in memory; usage is shared with other gateway nodes
+ * through Redis counters every RATE_LIMIT_SYNC_MS, so a limit holds across
+ * the cluster to within about one sync interval of traffic.
+ */
+let reconciling = false;
+
+async function reconcileLimiters(): Promise<void> {
+  if (reconciling || !redisClient.isReady) {
+    return;
+  }
+
+  reconciling = true;
+  try {
+    const store = redisClient as unknown as GcraStore;
+    for (const limiter of [...Object.values(rateLimiterConfigs), ...priorityLimiters.values()]) {
+      await limiter.reconcile(store);
+    }
+  } catch (error) {
+    logger.error('Rate limit reconciliation failed:', error);
+  } finally {
+    reconciling = false;
+  }
+}
+
+setInterval(reconcileLimiters, parseInt(process.env.RATE_LIMIT_SYNC_MS || '1000')).unref();
+
 export function createRateLimitMiddleware(limiterType: keyof typeof rateLimiterConfigs) {
-  return async (req: Request, res: Response, next: NextFunction) => {
+  return (req: Request, res: Response, next: NextFunction) => {
     const limiter = rateLimiterConfigs[limiterType];
     const key = getKey(req, limiterType);
 
-    try {
-      await limiter.consume(key);
+    const result = limiter.consume(key);
+    if (result.allowed) {
       next();
-    } catch (rateLimiterRes: any) {
-      const remainingPoints = rateLimiterRes?.remainingPoints || 0;
-      const totalHits = rateLimiterRes?.totalHits || 0;
-      const msBeforeNext = rateLimiterRes?.msBeforeNext || 0;
-
-      res.set({
-        'Retry-After': Math.round(msBeforeNext / 1000) || 1,
-        'X-RateLimit-Limit': limiter.points,
-        'X-RateLimit-Remaining': remainingPoints,
-        'X-RateLimit-Reset': new Date(Date.now() + msBeforeNext).toISOString(),
-      });
-
-      logger.warn(`Rate limit exceeded for ${limiterType}: ${key} (${totalHits} hits)`);
-      
-      res.status(429).json({
-        error: 'Too Many Requests',
-        message: `Rate limit exceeded for ${limiterType}`,
-        retryAfter: Math.round(msBeforeNext / 1000),
-      });
+      return;
     }
+
+    const msBeforeNext = result.msBeforeNext;
+
+    res.set({
+      'Retry-After': Math.round(msBeforeNext / 1000) || 1,
+      'X-RateLimit-Limit': limiter.points,
+      'X-RateLimit-Remaining': result.remainingPoints,
+      'X-RateLimit-Reset': new Date(Date.now() + msBeforeNext).toISOString(),
+    });
+
+    logger.warn(`Rate limit exceeded for ${limiterType}: ${key}`);
+    
+    res.status(429).json({
+      error: 'Too Many Requests',
+      message: `Rate limit exceeded for ${limiterType}`,
+      retryAfter: Math.round(msBeforeNext / 1000),
+    });
   };
 }
 
@@ -124,38 +146,52 @@ function getKey(req: Request, limiterType: string): string {
 }
 
 export async function checkWebSocketRateLimit(ip: string): Promise<boolean> {
-  try {
-    await rateLimiterConfigs.websocket.consume(ip);
+  if (rateLimiterConfigs.websocket.consume(ip).allowed) {
     return true;
-  } catch (rateLimiterRes) {
-    logger.warn(`WebSocket rate limit exceeded for IP: ${ip}`);
-    return false;
   }
+  logger.warn(`WebSocket rate limit exceeded for IP: ${ip}`);
+  return false;
 }
 
-export async function checkMessageRateLimit(mudName: string, messageType?: string): Promise<boolean> {
-  try {
-    // Check general message rate limit
-    await rateLimiterConfigs.message.consume(mudName);
-    
-    // Check specific message type rate limits
-    if (messageType === 'channel') {
-      await rateLimiterConfigs.channel.consume(mudName);
-    } else if (messageType === 'tell') {
-      await rateLimiterConfigs.tell.consume(mudName);
-    }
-    
-    return true;
-  } catch (rateLimiterRes) {
-    logger.warn(`Message rate limit exceeded for MUD: ${mudName}, type: ${messageType || 'general'}`);
-    return false;
+export async function consumeMessageRateLimit(
+  mudName: string,
+  messageType?: string,
+  destinations: number = 1
+): Promise<{ allowed: boolean; retryAfter: number }> {
+  // Check general message rate limit, then the specific message type limits
+  let result = rateLimiterConfigs.message.consume(mudName);
+  
+  if (result.allowed && messageType === 'channel') {
+    result = rateLimiterConfigs.channel.consume(mudName);
+  } else if (result.allowed && messageType === 'tell') {
+    result = rateLimiterConfigs.tell.consume(mudName);
+  } else if (result.allowed && messageType === 'multitell') {
+    // One tell per MUD it is split for, however many users each gets. A
+    // multitell to more MUDs than the burst allows costs the full burst,
+    // so it can still go out from an idle MUD.
+    const tells = Math.min(destinations, rateLimiterConfigs.tell.burstPoints);
+    result = rateLimiterConfigs.tell.consume(mudName, tells);
   }
+
+  if (result.allowed) {
+    return { allowed: true, retryAfter: 0 };
+  }
+
+  logger.warn(`Message rate limit exceeded for MUD: ${mudName}, type: ${messageType || 'general'}`);
+  return { allowed: false, retryAfter: Math.ceil(result.msBeforeNext / 1000) || 1 };
+}
+
+export async function checkMessageRateLimit(mudName: string, messageType?: string): Promise<boolean> {
+  return (await consumeMessageRateLimit(mudName, messageType)).allowed;
 }
 
 export async function resetRateLimit(key: string, limiterType: keyof typeof rateLimiterConfigs): Promise<void> {
+  const limiter = rateLimiterConfigs[limiterType];
+  limiter.delete(key);
+
+  // Clear the shared counter too, or the next sync would charge it back
   try {
-    const limiter = rateLimiterConfigs[limiterType];
-    await limiter.delete(key);
+    await redisClient.del(`${limiter.keyPrefix}:${key}`);
     logger.info(`Rate limit reset for ${limiterType}: ${key}`);
   } catch (error) {
     logger.error(`Error resetting rate limit for ${limiterType}: ${key}`, error);
@@ -163,39 +199,33 @@ export async function resetRateLimit(key: string, limiterType: keyof typeof rate
 }
 
 export async function getRateLimitInfo(key: string, limiterType: keyof typeof rateLimiterConfigs): Promise<any> {
-  try {
-    const limiter = rateLimiterConfigs[limiterType];
-    const res = await limiter.get(key);
-    
-    if (!res) {
-      return {
-        points: limiter.points,
-        remaining: limiter.points,
-        reset: null,
-        blocked: false
-      };
-    }
-
+  const limiter = rateLimiterConfigs[limiterType];
+  const res = limiter.get(key);
+  
+  if (!res) {
     return {
       points: limiter.points,
-      remaining: res.remainingPoints,
-      reset: new Date(Date.now() + res.msBeforeNext),
-      blocked: res.msBeforeNext > 0 && res.remainingPoints <= 0
+      remaining: limiter.points,
+      reset: null,
+      blocked: false
     };
-  } catch (error) {
-    logger.error(`Error getting rate limit info for ${limiterType}: ${key}`, error);
-    return null;
   }
+
+  return {
+    points: limiter.points,
+    remaining: res.remainingPoints,
+    reset: new Date(Date.now() + res.msBeforeNext),
+    blocked: !res.allowed
+  };
 }
 
 export function createBurstProtection(points: number, duration: number, blockDuration: number) {
-  return new RateLimiterRedis({
-    storeClient: redisClient,
+  // GCRA already spaces requests evenly across the duration
+  return new GcraLimiter({
     keyPrefix: 'rl_burst',
     points,
     duration,
     blockDuration,
-    execEvenly: true, // Spread requests evenly across duration
   });
 }
 
@@ -209,27 +239,29 @@ export async function checkPriorityRateLimit(mudName: string, priority: number):
   const multiplier = Math.max(0.5, (11 - priority) / 10); // Higher priority = more generous limits
   const adjustedPoints = Math.floor(rateLimiterConfigs.message.points * multiplier);
   
-  const priorityLimiter = new RateLimiterRedis({
-    storeClient: redisClient,
-    keyPrefix: `rl_priority_${priority}`,
-    points: adjustedPoints,
-    duration: 60,
-    blockDuration: 60,
-  });
+  let priorityLimiter = priorityLimiters.get(priority);
+  if (!priorityLimiter) {
+    priorityLimiter = new GcraLimiter({
+      keyPrefix: `rl_priority_${priority}`,
+      points: adjustedPoints,
+      duration: 60,
+      blockDuration: 60,
+    });
+    priorityLimiters.set(priority, priorityLimiter);
+  }
 
-  try {
-    await priorityLimiter.consume(mudName);
+  if (priorityLimiter.consume(mudName).allowed) {
     return true;
-  } catch (rateLimiterRes) {
-    logger.warn(`Priority rate limit exceeded for MUD: ${mudName}, priority: ${priority}`);
-    return false;
   }
+  logger.warn(`Priority rate limit exceeded for MUD: ${mudName}, priority: ${priority}`);
+  return false;
 }
 
 export default {
   createRateLimitMiddleware,
   checkWebSocketRateLimit,
   checkMessageRateLimit,
+  consumeMessageRateLimit,
   resetRateLimit,
   getRateLimitInfo,
   apiRateLimit,
@@ -3,6 +3,7 @@ import { Channel, ChannelMessage, MudVaultMessage, MessageEndpoint } from '../ty
 import { createChannelMessage } from '../utils/message';
 import logger from '../utils/logger';
 import redisService from './redis';
+import persistence from './persistence';
 
 export class ChannelService extends EventEmitter {
   private channels: Map<string, Channel> = new Map();
@@ -21,6 +22,8 @@ export class ChannelService extends EventEmitter {
         const channelData = await redisService.get(`channel:${channelName}`);
         if (channelData) {
           const channel: Channel = JSON.parse(channelData);
+          const history = await redisService.lrange(`channel_history:${channelName}`, 0, 99);
+          channel.history = history.map(entry => JSON.parse(entry)).reverse();
           this.channels.set(channelName, channel);
         }
       }
@@ -33,7 +36,8 @@ export class ChannelService extends EventEmitter {
 
   private async saveChannelToRedis(channel: Channel): Promise<void> {
     try {
-      await redisService.set(`channel:${channel.name}`, JSON.stringify(channel));
+      // History is persisted separately in channel_history:<name>
+      await redisService.set(`channel:${channel.name}`, JSON.stringify({ ...channel, history: [] }));
       await redisService.sadd('active_channels', channel.name);
     } catch (error) {
       logger.error(`Error saving channel ${channel.name} to Redis:`, error);
@@ -76,14 +80,9 @@ export class ChannelService extends EventEmitter {
 
     const userKey = `${user.user}@${user.mud}`;
     
-    if (channel.banned.includes(userKey)) {
-      throw new Error(`User ${userKey} is banned from channel ${channelName}`);
-    }
-
-    if (channel.mudRestricted && channel.allowedMuds && channel.allowedMuds.length > 0) {
-      if (!channel.allowedMuds.includes(user.mud)) {
-        throw new Error(`MUD ${user.mud} is not allowed in channel ${channelName}`);
-      }
+    const denied = this.getAccessDenial(channel, user);
+    if (denied) {
+      throw new Error(denied);
     }
 
     if (!this.userChannels.has(userKey)) {
@@ -93,7 +92,7 @@ export class ChannelService extends EventEmitter {
     this.userChannels.get(userKey)!.add(channelName);
 
     const joinMessage = createChannelMessage(user, channelName, '', 'join');
-    await this.addMessageToChannel(channelName, joinMessage);
+    this.addMessageToChannel(channelName, joinMessage);
 
     await redisService.sadd(`channel_members:${channelName}`, userKey);
 
@@ -116,7 +115,7 @@ export class ChannelService extends EventEmitter {
     }
 
     const leaveMessage = createChannelMessage(user, channelName, '', 'leave');
-    await this.addMessageToChannel(channelName, leaveMessage);
+    this.addMessageToChannel(channelName, leaveMessage);
 
     await redisService.srem(`channel_members:${channelName}`, userKey);
 
@@ -143,7 +142,7 @@ export class ChannelService extends EventEmitter {
     }
 
     const channelMessage = createChannelMessage(from, channelName, message, 'message');
-    await this.addMessageToChannel(channelName, channelMessage);
+    this.addMessageToChannel(channelName, channelMessage);
 
     this.emit('messagePosted', { 
       channel: channelName, 
@@ -152,7 +151,7 @@ export class ChannelService extends EventEmitter {
     });
   }
 
-  private async addMessageToChannel(channelName: string, message: MudVaultMessage): Promise<void> {
+  private addMessageToChannel(channelName: string, message: MudVaultMessage): void {
     const channel = this.channels.get(channelName);
     if (!channel) {
       return;
@@ -173,12 +172,37 @@ export class ChannelService extends EventEmitter {
       channel.history = channel.history.slice(-100);
     }
 
-    await this.saveChannelToRedis(channel);
+    // History lives in its own list, so the channel record needs no rewrite
+    persistence.append(`channel_history:${channelName}`, JSON.stringify(channelMessage), 1000); // Keep last 1000 messages
+  }
+
+  /**
+   * Why a user may not join or read a channel, or null if they may
+   */
+  public getAccessDenial(channel: Channel, user: MessageEndpoint): string | null {
+    const userKey = `${user.user}@${user.mud}`;
+
+    if (channel.banned.includes(userKey)) {
+      return `User ${userKey} is banned from channel ${channel.name}`;
+    }
+
+    if (channel.mudRestricted && channel.allowedMuds && channel.allowedMuds.length > 0) {
+      if (!channel.allowedMuds.includes(user.mud)) {
+        return `MUD ${user.mud} is not allowed in channel ${channel.name}`;
+      }
+    }
 
-    // Also store in Redis for persistence
-    const historyKey = `channel_history:${channelName}`;
-    await redisService.lpush(historyKey, JSON.stringify(channelMessage));
-    await redisService.ltrim(historyKey, 0, 999); // Keep last 1000 messages
+    return null;
+  }
+
+  /**
+   * Why a user may not read a channel's history, or null if they may.
+   * Mesh channels need no record to carry traffic, so only a channel that
+   * has one can restrict its history.
+   */
+  public getHistoryDenial(channelName: string, user: MessageEndpoint): string | null {
+    const channel = this.channels.get(channelName);
+    return channel ? this.getAccessDenial(channel, user) : null;
   }
 
   public getChannel(name: string): Channel | undefined {
@@ -204,10 +228,36 @@ export class ChannelService extends EventEmitter {
     }
   }
 
-  public async getChannelHistory(channelName: string, limit: number = 50): Promise<ChannelMessage[]> {
+  /**
+   * Latest history entries, newest first. Given a type, only entries of
+   * that type count towards the limit, so the list is read in pages until
+   * enough are found.
+   */
+  public async getChannelHistory(channelName: string, limit: number = 50, type?: ChannelMessage['type']): Promise<ChannelMessage[]> {
     try {
-      const historyData = await redisService.lrange(`channel_history:${channelName}`, 0, limit - 1);
-      return historyData.map(data => JSON.parse(data));
+      if (!type) {
+        const historyData = await redisService.lrange(`channel_history:${channelName}`, 0, limit - 1);
+        return historyData.map(data => JSON.parse(data));
+      }
+
+      const history: ChannelMessage[] = [];
+      const pageSize = Math.max(limit * 2, 50);
+
+      for (let start = 0; history.length < limit; start += pageSize) {
+        const page = await redisService.lrange(`channel_history:${channelName}`, start, start + pageSize - 1);
+
+        for (const data of page) {
+          const entry: ChannelMessage = JSON.parse(data);
+          if (entry.type === type) {
+            history.push(entry);
+            if (history.length >= limit) break;
+          }
+        }
+
+        if (page.length < pageSize) break;
+      }
+
+      return history;
     } catch (error) {
       logger.error(`Error getting history for channel ${channelName}:`, error);
       return [];
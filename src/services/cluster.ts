@@ -0,0 +1,155 @@
+import { EventEmitter } from 'events';
+import os from 'os';
+import logger from '../utils/logger';
+import redisService from './redis';
+
+const CLUSTER_CHANNEL = 'mesh:cluster';
+const NODE_CHANNEL_PREFIX = 'mesh:node:';
+
+const HEARTBEAT_MS = parseInt(process.env.GATEWAY_HEARTBEAT_MS || '10000');
+const NODE_TIMEOUT_MS = HEARTBEAT_MS * 3 + 5000;
+
+// Wire kinds; every bus message is "<kind>\t<origin node>\t<arg>\t<body>"
+enum Kind {
+  Forward = 'F',   // arg: target MUD, body: frame (sent to the owning node only)
+  Broadcast = 'B', // body: frame
+  Claim = 'C',     // arg: MUD now held by origin
+  Release = 'R',   // arg: MUD no longer held by origin
+  Heartbeat = 'H'  // arg: 'hello' when the origin has just started
+}
+
+/**
+ * Links gateway nodes that share a Redis. Each node announces the MUDs it
+ * holds, and every node keeps a local map of which peer holds the rest, so
+ * routing to a remote MUD costs one map lookup and one publish. Broadcasts
+ * are published once on the shared channel, so each node sees them exactly
+ * once and fans them out to its own connections.
+ *
+ * Emits 'forward' (mudName, frame) and 'broadcast' (frame) for traffic
+ * from other nodes.
+ */
+export class ClusterBus extends EventEmitter {
+  private owners: Map<string, string> = new Map(); // MUD -> node holding it
+  private lastHeard: Map<string, number> = new Map(); // node -> last heartbeat
+  private heartbeat: NodeJS.Timeout | null = null;
+  private localMuds: () => string[] = () => [];
+
+  constructor(
+    public readonly nodeId: string = process.env.GATEWAY_NODE_ID || `${os.hostname()}-${process.pid}`
+  ) {
+    super();
+  }
+
+  public async start(localMuds: () => string[]): Promise<void> {
+    this.localMuds = localMuds;
+
+    await redisService.subscribe(CLUSTER_CHANNEL, (raw) => this.receive(raw));
+    await redisService.subscribe(NODE_CHANNEL_PREFIX + this.nodeId, (raw) => this.receive(raw));
+
+    this.heartbeat = setInterval(() => this.tick(), HEARTBEAT_MS);
+    this.heartbeat.unref();
+
+    // Peers answer the hello with claims for what they hold
+    this.publish(CLUSTER_CHANNEL, Kind.Heartbeat, 'hello', '');
+    logger.info(`Cluster node ${this.nodeId} joined`);
+  }
+
+  public stop(): void {
+    if (this.heartbeat) {
+      clearInterval(this.heartbeat);
+      this.heartbeat = null;
+    }
+  }
+
+  /**
+   * Node holding mudName (normalized), if it is held by a peer
+   */
+  public ownerOf(mudName: string): string | undefined {
+    return this.owners.get(mudName);
+  }
+
+  public claim(mudName: string): void {
+    this.owners.delete(mudName);
+    this.publish(CLUSTER_CHANNEL, Kind.Claim, mudName, '');
+  }
+
+  public release(mudName: string): void {
+    this.publish(CLUSTER_CHANNEL, Kind.Release, mudName, '');
+  }
+
+  public forward(node: string, mudName: string, frame: Buffer): void {
+    this.publish(NODE_CHANNEL_PREFIX + node, Kind.Forward, mudName, frame.toString('utf8'));
+  }
+
+  public broadcast(frame: Buffer): void {
+    this.publish(CLUSTER_CHANNEL, Kind.Broadcast, '', frame.toString('utf8'));
+  }
+
+  private publish(channel: string, kind: Kind, arg: string, body: string): void {
+    redisService.publish(channel, `${kind}\t${this.nodeId}\t${arg}\t${body}`).catch((error) => {
+      logger.error(`Cluster publish to ${channel} failed:`, error);
+    });
+  }
+
+  private receive(raw: string): void {
+    const originEnd = raw.indexOf('\t', 2);
+    const argEnd = originEnd < 0 ? -1 : raw.indexOf('\t', originEnd + 1);
+    if (raw[1] !== '\t' || argEnd < 0) {
+      logger.warn('Ignoring malformed cluster message', { preview: raw.substring(0, 100) });
+      return;
+    }
+
+    const origin = raw.substring(2, originEnd);
+    if (origin === this.nodeId) {
+      return;
+    }
+
+    const arg = raw.substring(originEnd + 1, argEnd);
+    this.lastHeard.set(origin, Date.now());
+
+    switch (raw[0]) {
+      case Kind.Forward:
+        this.emit('forward', arg, Buffer.from(raw.substring(argEnd + 1), 'utf8'));
+        break;
+      case Kind.Broadcast:
+        this.emit('broadcast', Buffer.from(raw.substring(argEnd + 1), 'utf8'));
+        break;
+      case Kind.Claim:
+        this.owners.set(arg, origin);
+        break;
+      case Kind.Release:
+        if (this.owners.get(arg) === origin) {
+          this.owners.delete(arg);
+        }
+        break;
+      case Kind.Heartbeat:
+        if (arg === 'hello') {
+          for (const mudName of this.localMuds()) {
+            this.claim(mudName);
+          }
+        }
+        break;
+    }
+  }
+
+  // Heartbeat, and forget MUDs held by nodes that have gone quiet
+  private tick(): void {
+    const now = Date.now();
+
+    this.publish(CLUSTER_CHANNEL, Kind.Heartbeat, '', '');
+
+    for (const [node, heard] of this.lastHeard) {
+      if (now - heard > NODE_TIMEOUT_MS) {
+        this.lastHeard.delete(node);
+        for (const [mudName, owner] of this.owners) {
+          if (owner === node) {
+            this.owners.delete(mudName);
+          }
+        }
+        logger.warn(`Cluster node ${node} timed out`);
+      }
+    }
+  }
+}
+
+export default ClusterBus;
@@ -1,8 +1,9 @@
-import { Client, GatewayIntentBits, EmbedBuilder, SlashCommandBuilder, ChannelType } from 'discord.js';
+import { Client, GatewayIntentBits, EmbedBuilder, SlashCommandBuilder, ChannelType, RESTEvents } from 'discord.js';
 import { EventEmitter } from 'events';
 import { MudVaultClient } from '../clients/nodejs';
 import { MudVaultMessage } from '../types';
 import winston from 'winston';
+import { DiscordOutbox, OutboxBatch, OutboxLine } from './discordOutbox';
 
 interface DiscordConfig {
   enabled: boolean;
@@ -30,6 +31,7 @@ export class DiscordService extends EventEmitter {
   private logger: winston.Logger;
   private discordClient: Client;
   private imcClient: MudVaultClient;
+  private outbox: DiscordOutbox;
   private userMappings: Map<string, UserMapping> = new Map();
   private verificationCodes: Map<string, { discordId: string; mudName: string; mudUsername: string; expires: Date }> = new Map();
 
@@ -59,6 +61,21 @@ export class DiscordService extends EventEmitter {
       ]
     });
 
+    // Mesh channel traffic goes out through a per-channel scheduler, paced
+    // by the rate-limit buckets Discord reports for each channel
+    this.outbox = new DiscordOutbox((targetId, batch) => this.sendOutboxBatch(targetId, batch));
+    this.discordClient.rest.on(RESTEvents.Response, (request, response) => {
+      const route = /^\/channels\/(\d+)\/messages$/.exec(request.path);
+      const remaining = response.headers.get('x-ratelimit-remaining');
+      const resetAfter = response.headers.get('x-ratelimit-reset-after');
+      if (route && remaining !== null && resetAfter !== null) {
+        this.outbox.updateRateLimit(route[1], {
+          remaining: Number(remaining),
+          resetAfterMs: Number(resetAfter) * 1000
+        });
+      }
+    });
+
     // Initialize IMC client  
     this.imcClient = new MudVaultClient({
       mudName: config.mudName,
@@ -96,6 +113,7 @@ export class DiscordService extends EventEmitter {
 
   async stop(): Promise<void> {
     this.logger.info('Stopping Discord service...');
+    this.outbox.stop();
     await this.imcClient.disconnect();
     await this.discordClient.destroy();
     this.logger.info('Discord service stopped');
@@ -344,73 +362,86 @@ export class DiscordService extends EventEmitter {
       hasSpecificMapping: !!specificChannelId
     });
     
-    // Convert ANSI colors and create embed
-    const formattedContent = this.convertAnsiToDiscord((message.payload as any).message);
-    
-    const embed = new EmbedBuilder()
-      .setAuthor({
-        name: message.from.mud,
-        iconURL: 'https://cdn.discordapp.com/emojis/🌍.png' // Earth emoji for MUD icon
-      })
-      .setTitle(message.from.user || 'Unknown')
-      .setDescription(`\`\`\`ansi\n${formattedContent}\n\`\`\``)
-      .setTimestamp(new Date(message.timestamp))
-      .setFooter({
-        text: `#${mudChannelName}`
-      })
-      .setColor(this.getChannelColor(mudChannelName));
+    // Queued per Discord channel; the outbox coalesces and paces the sends
+    const line: OutboxLine = {
+      channel: mudChannelName,
+      mud: message.from.mud,
+      user: message.from.user || 'Unknown',
+      text: (message.payload as any).message,
+      timestamp: message.timestamp
+    };
 
-    // Send to specific channel if mapped
     if (specificChannelId) {
-      const specificChannel = this.discordClient.channels.cache.get(specificChannelId);
-      if (specificChannel && specificChannel.type === ChannelType.GuildText) {
-        this.logger.debug('DEBUG: Sending to specific Discord channel', {
-          channelId: specificChannelId,
-          channelName: specificChannel.name
-        });
-        await specificChannel.send({ embeds: [embed] });
-      } else {
-        this.logger.warn('DEBUG: Specific channel not found or not text channel', {
-          channelId: specificChannelId,
-          found: !!specificChannel,
-          type: specificChannel?.type
-        });
-      }
+      this.outbox.enqueue(specificChannelId, line);
     } else {
       this.logger.debug('DEBUG: No specific channel mapping found for', mudChannelName);
     }
     
     // Always send to bridge channel as well (admin overview)
-    const bridgeChannel = this.discordClient.channels.cache.get(bridgeChannelId);
-    if (bridgeChannel && bridgeChannel.type === ChannelType.GuildText) {
-      this.logger.debug('DEBUG: Sending to bridge channel', {
-        channelId: bridgeChannelId,
-        channelName: bridgeChannel.name
+    this.outbox.enqueue(bridgeChannelId, line);
+  }
+
+  private async sendOutboxBatch(targetId: string, batch: OutboxBatch): Promise<void> {
+    const channel = this.discordClient.channels.cache.get(targetId);
+    if (!channel || channel.type !== ChannelType.GuildText) {
+      this.logger.warn('DEBUG: Discord channel not found or not text channel', {
+        channelId: targetId,
+        found: !!channel,
+        type: channel?.type
       });
-      
-      // Add channel prefix for bridge channel to show which channel it's from
-      const bridgeEmbed = new EmbedBuilder()
+      return;
+    }
+
+    this.logger.debug('DEBUG: Sending batch to Discord channel', {
+      channelId: targetId,
+      channelName: channel.name,
+      lines: batch.lines.length,
+      skipped: batch.skipped
+    });
+    await channel.send({ embeds: [this.formatChannelBatch(batch, targetId === this.config.bridgeChannelId)] });
+  }
+
+  // One line keeps the single-message layout; several share one embed
+  private formatChannelBatch(batch: OutboxBatch, bridge: boolean): EmbedBuilder {
+    const first = batch.lines[0];
+    const last = batch.lines[batch.lines.length - 1];
+    const count = batch.lines.length;
+    const embed = new EmbedBuilder()
+      .setTimestamp(new Date(last.timestamp))
+      .setColor(this.getChannelColor(first.channel));
+
+    if (count === 1) {
+      embed
         .setAuthor({
-          name: message.from.mud,
-          iconURL: 'https://cdn.discordapp.com/emojis/🌍.png'
-        })
-        .setTitle(`[#${mudChannelName}] ${message.from.user || 'Unknown'}`)
-        .setDescription(`\`\`\`ansi\n${formattedContent}\n\`\`\``)
-        .setTimestamp(new Date(message.timestamp))
-        .setFooter({
-          text: `from #${mudChannelName}`
+          name: first.mud,
+          iconURL: 'https://cdn.discordapp.com/emojis/🌍.png' // Earth emoji for MUD icon
         })
-        .setColor(this.getChannelColor(mudChannelName));
-        
-      await bridgeChannel.send({ embeds: [bridgeEmbed] });
-      this.logger.debug('DEBUG: Successfully sent to bridge channel');
+        .setTitle(bridge ? `[#${first.channel}] ${first.user}` : first.user)
+        .setDescription(this.formatAnsiBlock(this.convertAnsiToDiscord(first.text)));
     } else {
-      this.logger.warn('DEBUG: Bridge channel not found or not text channel', {
-        channelId: bridgeChannelId,
-        found: !!bridgeChannel,
-        type: bridgeChannel?.type
-      });
+      const text = batch.lines
+        .map(line => `${bridge ? `[#${line.channel}] ` : ''}${line.user}@${line.mud}: ${this.convertAnsiToDiscord(line.text)}`)
+        .join('\n');
+      embed
+        .setTitle(bridge ? 'Mesh channels' : `#${first.channel}`)
+        .setDescription(this.formatAnsiBlock(text));
     }
+
+    const footer = count === 1
+      ? (bridge ? `from #${first.channel}` : `#${first.channel}`)
+      : (bridge ? `${count} messages` : `#${first.channel} · ${count} messages`);
+    embed.setFooter({
+      text: batch.skipped > 0
+        ? `${footer} · ${batch.skipped} earlier message${batch.skipped === 1 ? '' : 's'} skipped`
+        : footer
+    });
+
+    return embed;
+  }
+
+  private formatAnsiBlock(text: string): string {
+    const limit = 4096 - '```ansi\n\n```'.length;
+    return `\`\`\`ansi\n${text.length > limit ? text.slice(0, limit - 1) + '…' : text}\n\`\`\``;
   }
 
   private async handleIMCTellMessage(message: MudVaultMessage): Promise<void> {
@@ -822,6 +853,7 @@ export class DiscordService extends EventEmitter {
         pending: this.verificationCodes.size,
         expired: pendingVerifications.filter(v => v.expires < new Date()).length
       },
+      outbox: this.outbox.getStats(),
       channels: {
         configured: this.config.channels.length,
         mappings: Object.keys(this.config.channelMappings).length,
@@ -0,0 +1,225 @@
+export interface OutboxLine {
+  channel: string;          // Mesh channel the line came from
+  mud: string;
+  user: string;
+  text: string;
+  timestamp: string;
+}
+
+export interface OutboxBatch {
+  lines: OutboxLine[];
+  skipped: number;          // Lines dropped since the previous batch to this target
+}
+
+// A route's rate-limit bucket, as reported by Discord's X-RateLimit headers
+export interface RateLimitState {
+  remaining: number;
+  resetAfterMs: number;
+}
+
+/**
+ * Delivers one batch to a Discord channel. It may return the bucket state
+ * Discord reported for the request, and should throw on failure; an error
+ * with a retryAfter in milliseconds (as discord.js's RateLimitError has)
+ * holds the target that long.
+ */
+export type OutboxSender = (target: string, batch: OutboxBatch) => Promise<RateLimitState | void>;
+
+export interface DiscordOutboxOptions {
+  /** How long the first line of a batch waits for more to join it */
+  coalesceMs: number;
+  /** Lines per embed */
+  maxLines: number;
+  /** Characters of line text per embed, kept under Discord's 4096 description limit */
+  maxChars: number;
+  /** Lines waiting per target before the oldest are skipped */
+  maxBacklog: number;
+  /** Sends per window assumed until Discord reports the real bucket */
+  bucketSize: number;
+  bucketWindowMs: number;
+}
+
+export const defaultDiscordOutboxOptions: DiscordOutboxOptions = {
+  coalesceMs: parseInt(process.env.DISCORD_COALESCE_MS || '750'),
+  maxLines: 15,
+  maxChars: 3500,
+  maxBacklog: parseInt(process.env.DISCORD_BACKLOG_MAX || '200'),
+  bucketSize: 5,
+  bucketWindowMs: 5000
+};
+
+export interface DiscordOutboxStats {
+  queuedLines: number;
+  sentBatches: number;
+  sentLines: number;
+  skippedLines: number;
+  failedBatches: number;
+}
+
+interface Target {
+  lines: OutboxLine[];
+  skipped: number;
+  firstQueuedAt: number;
+  remaining: number;
+  resetAt: number;
+  timer?: NodeJS.Timeout;
+  sending: boolean;
+}
+
+/**
+ * Outbound scheduler for the Discord bridge, one queue per Discord channel.
+ * Lines arriving close together go out as one multi-line embed. Sends are
+ * paced by the channel's rate-limit bucket before Discord has to refuse
+ * them, so a storm only makes batches bigger. Past the backlog cap the
+ * oldest lines are skipped and the next batch says how many.
+ */
+export class DiscordOutbox {
+  private targets: Map<string, Target> = new Map();
+  private stats: DiscordOutboxStats = { queuedLines: 0, sentBatches: 0, sentLines: 0, skippedLines: 0, failedBatches: 0 };
+  private stopped = false;
+
+  constructor(
+    private readonly sender: OutboxSender,
+    private readonly options: DiscordOutboxOptions = defaultDiscordOutboxOptions
+  ) {}
+
+  public enqueue(targetId: string, line: OutboxLine): void {
+    if (this.stopped) {
+      return;
+    }
+
+    const target = this.getTarget(targetId);
+    if (target.lines.length === 0) {
+      target.firstQueuedAt = Date.now();
+    }
+
+    target.lines.push(line);
+    this.stats.queuedLines++;
+
+    if (target.lines.length > this.options.maxBacklog) {
+      const excess = target.lines.length - this.options.maxBacklog;
+      target.lines.splice(0, excess);
+      target.skipped += excess;
+      this.stats.queuedLines -= excess;
+      this.stats.skippedLines += excess;
+    }
+
+    this.schedule(targetId, target);
+  }
+
+  /**
+   * Take the bucket state Discord reported for a channel, e.g. from the
+   * REST client's response events
+   */
+  public updateRateLimit(targetId: string, state: RateLimitState): void {
+    const target = this.getTarget(targetId);
+
+    target.remaining = state.remaining;
+    target.resetAt = Date.now() + state.resetAfterMs;
+  }
+
+  public getStats(): DiscordOutboxStats {
+    return { ...this.stats };
+  }
+
+  public stop(): void {
+    this.stopped = true;
+    for (const target of this.targets.values()) {
+      if (target.timer) {
+        clearTimeout(target.timer);
+      }
+    }
+    this.targets.clear();
+    this.stats.queuedLines = 0;
+  }
+
+  private getTarget(targetId: string): Target {
+    let target = this.targets.get(targetId);
+    if (!target) {
+      target = { lines: [], skipped: 0, firstQueuedAt: 0, remaining: this.options.bucketSize, resetAt: 0, sending: false };
+      this.targets.set(targetId, target);
+    }
+    return target;
+  }
+
+  // Arm the target's timer for when its next batch may go
+  private schedule(targetId: string, target: Target): void {
+    if (target.sending || target.timer || target.lines.length === 0 || this.stopped) {
+      return;
+    }
+
+    const now = Date.now();
+    let due = target.firstQueuedAt + this.options.coalesceMs;
+
+    // A full embed's worth is waiting; no point holding it back
+    if (target.lines.length >= this.options.maxLines) {
+      due = now;
+    }
+    if (target.remaining <= 0 && target.resetAt > due) {
+      due = target.resetAt;
+    }
+
+    target.timer = setTimeout(() => {
+      target.timer = undefined;
+      this.flush(targetId, target);
+    }, Math.max(due - now, 0));
+  }
+
+  private async flush(targetId: string, target: Target): Promise<void> {
+    const now = Date.now();
+
+    if (now >= target.resetAt) {
+      target.remaining = this.options.bucketSize;
+      target.resetAt = now + this.options.bucketWindowMs;
+    }
+    if (target.remaining <= 0) {
+      this.schedule(targetId, target);
+      return;
+    }
+
+    const batch: OutboxBatch = { lines: this.takeLines(target), skipped: target.skipped };
+    target.skipped = 0;
+    target.remaining--;
+    target.sending = true;
+
+    try {
+      const state = await this.sender(targetId, batch);
+      if (state) {
+        this.updateRateLimit(targetId, state);
+      }
+      this.stats.sentBatches++;
+      this.stats.sentLines += batch.lines.length;
+    } catch (error) {
+      // The batch is lost; the next one reports it along with any other skips
+      const retryAfter = (error as { retryAfter?: number } | undefined)?.retryAfter;
+      if (retryAfter !== undefined) {
+        target.remaining = 0;
+        target.resetAt = Date.now() + retryAfter;
+      }
+      target.skipped += batch.lines.length + batch.skipped;
+      this.stats.failedBatches++;
+      this.stats.skippedLines += batch.lines.length;
+    }
+
+    target.sending = false;
+    this.schedule(targetId, target);
+  }
+
+  // Oldest lines that fit in one embed
+  private takeLines(target: Target): OutboxLine[] {
+    let count = 0;
+    let chars = 0;
+
+    while (count < target.lines.length && count < this.options.maxLines) {
+      const length = target.lines[count].text.length;
+      if (count > 0 && chars + length > this.options.maxChars) {
+        break;
+      }
+      chars += length;
+      count++;
+    }
+
+    this.stats.queuedLines -= count;
+    return target.lines.splice(0, count);
+  }
+}
@@ -1,15 +1,36 @@
 import WebSocket from 'ws';
+import { performance } from 'perf_hooks';
 import { EventEmitter } from 'events';
-import { MudVaultMessage, ConnectionInfo, MudInfo, ErrorCodes, WhoUser } from '../types';
+import { MudVaultMessage, ConnectionInfo, MudInfo, ErrorCodes, WhoUser, ChannelPayload, ChannelMessage, AuthPayload, MultiTellPayload } from '../types';
 import { validateMessage, validateMudName, normalizeMudName } from '../utils/validation';
-import { createErrorMessage, createPongMessage, createMessage, isExpired } from '../utils/message';
-import logger from '../utils/logger';
+import { createErrorMessage, createPongMessage, createMessage, isExpired, splitMultiTell, expandMultiTell } from '../utils/message';
+import logger, { hotPath } from '../utils/logger';
+import { consumeMessageRateLimit } from '../middleware/rateLimiter';
 import redisService from './redis';
+import persistence from './persistence';
+import { SendQueue, SendQueueStats } from './sendQueue';
+import { ClusterBus } from './cluster';
+import { Capability, hasCapability, negotiateCapabilities } from '../utils/capabilities';
+import channelService from './channel';
+
+const HEARTBEAT_INTERVAL_MS = 30000; // Ping every connection every 30 seconds
+const HEARTBEAT_TIMEOUT_MS = 60000;  // Drop connections silent for 60 seconds
+const HEARTBEAT_SLOTS = 30;
 
 export class Gateway extends EventEmitter {
   private connections: Map<string, WebSocket> = new Map();
   private connectionInfo: Map<string, ConnectionInfo> = new Map();
   private mudInfo: Map<string, MudInfo> = new Map();
+  private mudConnections: Map<string, string> = new Map(); // normalized MUD name -> connection ID
+  private normalizedNames: Map<string, string> = new Map(); // raw MUD name -> normalized
+  private sendQueues: Map<string, SendQueue> = new Map();
+  private slowConsumerDisconnects = 0;
+  private cluster: ClusterBus | null = null;
+  private heartbeatWheel: Set<string>[] = Array.from({ length: HEARTBEAT_SLOTS }, () => new Set<string>());
+  private heartbeatSlots: Map<string, number> = new Map(); // connection ID -> wheel slot
+  private heartbeatPosition = 0;
+  private nextHeartbeatSlot = 0;
+  private heartbeatTimer: NodeJS.Timeout;
   private server: WebSocket.Server;
 
   constructor(port: number) {
@@ -27,6 +48,47 @@ export class Gateway extends EventEmitter {
     });
 
     logger.info(`WebSocket gateway listening on port ${port}`);
+
+    if (process.env.GATEWAY_CLUSTER === 'true') {
+      this.startCluster(new ClusterBus());
+    }
+
+    this.heartbeatTimer = setInterval(() => this.heartbeatTick(), HEARTBEAT_INTERVAL_MS / HEARTBEAT_SLOTS);
+    this.heartbeatTimer.unref();
+  }
+
+  /**
+   * Join other gateway nodes on the same Redis. MUDs held elsewhere are
+   * reached through the bus; traffic from peers is delivered locally only.
+   */
+  public startCluster(cluster: ClusterBus): Promise<void> {
+    this.cluster = cluster;
+
+    // Frames from peers were validated on the node that received them
+    cluster.on('forward', (mudName: string, frame: Buffer) => {
+      const connectionId = this.findConnectionByMud(mudName);
+      if (!connectionId) {
+        logger.warn(`❌ CLUSTER FORWARD FAILED - ${mudName} is not on this node`);
+        return;
+      }
+      try {
+        this.sendMessage(connectionId, JSON.parse(frame.toString('utf8')), frame);
+      } catch (error) {
+        logger.error('Invalid frame from cluster peer:', error);
+      }
+    });
+
+    cluster.on('broadcast', (frame: Buffer) => {
+      try {
+        this.deliverToAll(JSON.parse(frame.toString('utf8')), frame);
+      } catch (error) {
+        logger.error('Invalid frame from cluster peer:', error);
+      }
+    });
+
+    return cluster.start(() => Array.from(this.mudConnections.keys())).catch((error) => {
+      logger.error('Failed to join gateway cluster:', error);
+    });
   }
 
   private handleConnection(ws: WebSocket, req: any): void {
@@ -50,15 +112,17 @@ export class Gateway extends EventEmitter {
     });
     
     this.connections.set(connectionId, ws);
+    this.sendQueues.set(connectionId, new SendQueue(ws));
     this.connectionInfo.set(connectionId, {
       id: connectionId,
       mudName: '',
       host: remoteAddress,
       authenticated: false,
       connected: new Date(),
-      lastSeen: new Date(),
+      lastSeen: performance.now(),
       messageCount: 0,
-      version: '1.0'
+      version: '1.0',
+      capabilities: 0
     });
 
     ws.on('message', (data) => {
@@ -96,20 +160,20 @@ export class Gateway extends EventEmitter {
         return;
       }
 
-      connection.lastSeen = new Date();
+      connection.lastSeen = performance.now();
       connection.messageCount++;
 
       const messageText = data.toString();
-      const messageSize = Buffer.byteLength(messageText, 'utf8');
       
-      logger.debug(`📨 INCOMING MESSAGE: ${connectionId}`, {
+      hotPath.debug('📨 INCOMING MESSAGE', () => ({
+        connectionId,
         mudName: connection.mudName || 'Unauthenticated',
         authenticated: connection.authenticated,
-        messageSize,
+        messageSize: Buffer.byteLength(messageText, 'utf8'),
         messageCount: connection.messageCount,
         rawLength: messageText.length,
         preview: messageText.substring(0, 200) + (messageText.length > 200 ? '...' : '')
-      });
+      }));
 
       let messageData: any;
       
@@ -133,8 +197,7 @@ export class Gateway extends EventEmitter {
           messageType: messageData.type || 'Unknown',
           messageId: messageData.id || 'No ID',
           messageSize: messageText.length,
-          rawMessage: messageText.substring(0, 1000),
-          parsedData: JSON.stringify(messageData, null, 2).substring(0, 1000)
+          rawMessage: messageText.substring(0, 1000)
         });
         this.sendError(connectionId, ErrorCodes.INVALID_MESSAGE, validation.error);
         return;
@@ -142,15 +205,16 @@ export class Gateway extends EventEmitter {
 
       const message = validation.value!;
 
-      logger.info(`✅ VALID MESSAGE: ${connectionId}`, {
+      hotPath.info('✅ VALID MESSAGE', () => ({
+        connectionId,
         mudName: connection.mudName || 'Unauthenticated',
         messageType: message.type,
         messageId: message.id,
         from: `${message.from.user || 'No user'}@${message.from.mud}`,
-        to: message.to.user ? `${message.to.user}@${message.to.mud}` : `channel:${message.to.channel}` || message.to.mud,
+        to: message.to.user ? `${message.to.user}@${message.to.mud}` : message.to.channel ? `channel:${message.to.channel}` : message.to.mud,
         priority: message.metadata.priority,
         ttl: message.metadata.ttl
-      });
+      }));
 
       if (isExpired(message)) {
         logger.warn(`⏰ EXPIRED MESSAGE: ${connectionId}`, {
@@ -177,7 +241,19 @@ export class Gateway extends EventEmitter {
         return;
       }
 
-      await this.routeMessage(connectionId, message);
+      // Tell the client which message was rejected and when to retry so it
+      // can requeue it and pace itself below the limit
+      const rateLimit = await consumeMessageRateLimit(connection.mudName, message.type, this.countDestinations(message));
+      if (!rateLimit.allowed) {
+        this.sendError(connectionId, ErrorCodes.RATE_LIMITED, `Rate limit exceeded for ${message.type} messages`, {
+          messageId: message.id,
+          messageType: message.type,
+          retryAfter: rateLimit.retryAfter
+        });
+        return;
+      }
+
+      await this.routeMessage(connectionId, message, Buffer.isBuffer(data) ? data : Buffer.from(messageText, 'utf8'));
 
     } catch (error) {
       logger.error(`Error handling message from ${connectionId}:`, error);
@@ -192,7 +268,7 @@ export class Gateway extends EventEmitter {
       return;
     }
 
-    const { mudName } = message.payload as any;
+    const { mudName, capabilities, params } = message.payload as AuthPayload;
     
     logger.info(`🔐 AUTHENTICATION ATTEMPT: ${connectionId}`, {
       attemptedMudName: mudName,
@@ -228,12 +304,13 @@ export class Gateway extends EventEmitter {
     }
 
     // Normalize mudName for case-insensitive matching
-    const finalMudName = normalizeMudName(mudName).toLowerCase();
+    const finalMudName = this.normalizeName(mudName);
 
     // Check if MUD name is already connected
-    const existingMud = Array.from(this.connectionInfo.values()).find(
-      conn => conn.authenticated && normalizeMudName(conn.mudName).toLowerCase() === finalMudName && conn.id !== connectionId
-    );
+    const existingConnectionId = this.mudConnections.get(finalMudName);
+    const existingMud = existingConnectionId && existingConnectionId !== connectionId
+      ? this.connectionInfo.get(existingConnectionId)
+      : undefined;
 
     if (existingMud) {
       logger.warn(`⚠️ MUD ALREADY CONNECTED: ${finalMudName}`, {
@@ -244,9 +321,26 @@ export class Gateway extends EventEmitter {
       });
     }
 
+    // A connection that re-authenticates under a new name gives up the old one
+    if (connection.authenticated && this.mudConnections.get(connection.mudName) === connectionId) {
+      this.mudConnections.delete(connection.mudName);
+      this.cluster?.release(connection.mudName);
+    }
+
     connection.mudName = finalMudName;
     connection.authenticated = true;
 
+    // Features both sides support are enabled for this session only
+    const negotiated = negotiateCapabilities(capabilities, params);
+    connection.capabilities = negotiated.capabilities;
+    this.sendQueues.get(connectionId)?.setBatching(
+      hasCapability(negotiated.capabilities, Capability.Batching) ? negotiated.params.maxBatchBytes : 0
+    );
+
+    // The newest connection for a name takes over routing for it
+    this.mudConnections.set(finalMudName, connectionId);
+    this.cluster?.claim(finalMudName);
+
     const mudInfo = {
       name: finalMudName,
       host: connection.host,
@@ -267,6 +361,7 @@ export class Gateway extends EventEmitter {
       connectionId,
       remoteAddress: connection.host,
       version: message.version,
+      capabilities: negotiated.capabilities,
       messageId: message.id,
       totalConnectedMuds: this.mudInfo.size,
       authenticationTime: `${Math.round((Date.now() - connection.connected.getTime()) / 1000)}s`
@@ -279,7 +374,9 @@ export class Gateway extends EventEmitter {
       { mud: finalMudName },
       {
         mudName: finalMudName,
-        response: 'Authentication successful'
+        response: 'Authentication successful',
+        capabilities: negotiated.capabilities,
+        params: { ...negotiated.params }
       },
       { priority: 10 }
     );
@@ -295,11 +392,12 @@ export class Gateway extends EventEmitter {
       return;
     }
 
-    logger.info(`🏓 PING REQUEST: ${connectionId}`, {
+    hotPath.info('🏓 PING REQUEST', () => ({
+      connectionId,
       mudName: connection.mudName,
       timestamp: (message.payload as any).timestamp,
       messageId: message.id
-    });
+    }));
 
     const pongMessage = createPongMessage(
       { mud: 'Gateway' },
@@ -310,37 +408,47 @@ export class Gateway extends EventEmitter {
     await this.sendMessage(connectionId, pongMessage);
   }
 
-  private async routeMessage(connectionId: string, message: MudVaultMessage): Promise<void> {
+  private async routeMessage(connectionId: string, message: MudVaultMessage, raw?: Buffer): Promise<void> {
     const connection = this.connectionInfo.get(connectionId);
     if (!connection) {
       logger.warn(`📤 ROUTING FAILED: Connection ${connectionId} not found`);
       return;
     }
 
+    // A client that already names itself correctly needs no rewrite, so its
+    // bytes are forwarded as received; otherwise serialize once for all targets.
+    // Batching peers and SSE feeds split on newlines, so multi-line JSON is
+    // always re-encoded onto one line.
+    const passthrough = raw !== undefined && message.from.mud === connection.mudName && !raw.includes(0x0a);
     message.from.mud = connection.mudName;
+    const frame = passthrough ? raw! : this.encodeMessage(message);
 
-    logger.info(`📤 ROUTING MESSAGE: ${message.id}`, {
+    hotPath.info('📤 ROUTING MESSAGE', () => ({
+      messageId: message.id,
       from: `${message.from.user || 'System'}@${message.from.mud}`,
       to: message.to.user ? `${message.to.user}@${message.to.mud}` : `${message.to.channel ? `#${message.to.channel}` : message.to.mud}`,
       type: message.type,
       priority: message.metadata.priority,
-      routingMode: message.to.mud === '*' ? 'BROADCAST' : message.to.mud === 'Gateway' ? 'GATEWAY' : 'FORWARD',
-      messageSize: JSON.stringify(message).length
-    });
+      routingMode: message.type === 'multitell' ? 'SPLIT' : message.to.mud === '*' ? 'BROADCAST' : message.to.mud === 'Gateway' ? 'GATEWAY' : 'FORWARD',
+      messageSize: frame.length,
+      passthrough
+    }));
 
     try {
-      if (message.to.mud === '*') {
-        await this.broadcastMessage(message, connectionId);
+      if (message.type === 'multitell') {
+        await this.splitMessage(message, connectionId);
+      } else if (message.to.mud === '*') {
+        await this.broadcastMessage(message, connectionId, frame);
       } else if (message.to.mud === 'Gateway') {
         await this.handleGatewayMessage(connectionId, message);
       } else {
-        await this.forwardMessage(message, connectionId);
+        await this.forwardMessage(message, connectionId, frame);
       }
 
-      await this.storeMessage(message);
+      this.storeMessage(message, frame);
       this.emit('messageRouted', { message, fromConnection: connectionId });
       
-      logger.debug(`✅ MESSAGE ROUTED SUCCESSFULLY: ${message.id}`);
+      hotPath.debug('✅ MESSAGE ROUTED SUCCESSFULLY', () => ({ messageId: message.id }));
     } catch (error) {
       logger.error(`❌ MESSAGE ROUTING FAILED: ${message.id}`, {
         error: error instanceof Error ? error.message : 'Unknown error',
@@ -351,36 +459,58 @@ export class Gateway extends EventEmitter {
     }
   }
 
-  private async broadcastMessage(message: MudVaultMessage, excludeConnection?: string): Promise<void> {
+  private async broadcastMessage(message: MudVaultMessage, excludeConnection?: string, frame?: Buffer): Promise<void> {
+    // Every target gets the same buffer; ws only prepends its frame header
+    const data = frame ?? this.encodeMessage(message);
+
+    // Peers each get one copy and fan it out to their own connections
+    this.cluster?.broadcast(data);
+    await this.deliverToAll(message, data, excludeConnection);
+  }
+
+  private async deliverToAll(message: MudVaultMessage, data: Buffer, excludeConnection?: string): Promise<void> {
     const promises: Promise<void>[] = [];
-    const targetMuds: string[] = [];
     
     for (const [connId, ws] of this.connections) {
       if (connId !== excludeConnection && ws.readyState === WebSocket.OPEN) {
         const connection = this.connectionInfo.get(connId);
         if (connection?.authenticated) {
-          promises.push(this.sendMessage(connId, message));
-          targetMuds.push(connection.mudName);
+          promises.push(this.sendMessage(connId, message, data));
         }
       }
     }
 
-    logger.info(`📡 BROADCASTING MESSAGE: ${message.id}`, {
+    // Target names are only collected when the entry is actually written
+    hotPath.info('📡 BROADCASTING MESSAGE', () => ({
+      messageId: message.id,
       from: `${message.from.user || 'System'}@${message.from.mud}`,
       type: message.type,
-      targetCount: targetMuds.length,
-      targetMuds: targetMuds.join(', '),
+      targetCount: promises.length,
+      targetMuds: Array.from(this.connectionInfo.entries())
+        .filter(([connId, info]) => connId !== excludeConnection && info.authenticated)
+        .map(([, info]) => info.mudName),
       excludedConnection: excludeConnection || 'None'
-    });
+    }));
 
     await Promise.all(promises);
   }
 
-  private async forwardMessage(message: MudVaultMessage, fromConnection: string): Promise<void> {
+  private async forwardMessage(message: MudVaultMessage, fromConnection: string, frame?: Buffer): Promise<void> {
     const targetMud = message.to.mud;
     const targetConnection = this.findConnectionByMud(targetMud);
 
     if (!targetConnection) {
+      const owner = this.cluster?.ownerOf(this.normalizeName(targetMud));
+      if (owner) {
+        hotPath.info('➡️ FORWARDING MESSAGE TO NODE', () => ({
+          messageId: message.id,
+          targetMud,
+          node: owner
+        }));
+        this.cluster!.forward(owner, this.normalizeName(targetMud), frame ?? this.encodeMessage(message));
+        return;
+      }
+
       logger.warn(`❌ FORWARD FAILED - Target MUD not found: ${message.id}`, {
         from: `${message.from.user || 'System'}@${message.from.mud}`,
         targetMud,
@@ -391,16 +521,41 @@ export class Gateway extends EventEmitter {
       return;
     }
 
-    const targetInfo = this.connectionInfo.get(targetConnection);
-    logger.info(`➡️ FORWARDING MESSAGE: ${message.id}`, {
+    hotPath.info('➡️ FORWARDING MESSAGE', () => ({
+      messageId: message.id,
       from: `${message.from.user || 'System'}@${message.from.mud}`,
       to: message.to.user ? `${message.to.user}@${targetMud}` : targetMud,
       type: message.type,
       targetConnection,
-      targetRemoteAddress: targetInfo?.host || 'Unknown'
-    });
+      targetRemoteAddress: this.connectionInfo.get(targetConnection)?.host || 'Unknown'
+    }));
 
-    await this.sendMessage(targetConnection, message);
+    await this.sendMessage(targetConnection, message, frame);
+  }
+
+  // Each destination MUD gets one envelope listing only its own recipients
+  private async splitMessage(message: MudVaultMessage, fromConnection: string): Promise<void> {
+    const envelopes = splitMultiTell(message, name => this.normalizeName(name));
+
+    hotPath.info('🔀 SPLITTING MESSAGE', () => ({
+      messageId: message.id,
+      from: `${message.from.user || 'System'}@${message.from.mud}`,
+      recipients: (message.payload as MultiTellPayload).recipients.length,
+      targetMuds: envelopes.map(envelope => envelope.to.mud)
+    }));
+
+    await Promise.all(envelopes.map(envelope => this.forwardMessage(envelope, fromConnection)));
+  }
+
+  private countDestinations(message: MudVaultMessage): number {
+    if (message.type !== 'multitell') {
+      return 1;
+    }
+    const muds = new Set<string>();
+    for (const recipient of (message.payload as MultiTellPayload).recipients) {
+      muds.add(this.normalizeName(recipient.mud));
+    }
+    return muds.size;
   }
 
   private async handleGatewayMessage(connectionId: string, message: MudVaultMessage): Promise<void> {
@@ -435,6 +590,12 @@ export class Gateway extends EventEmitter {
         }
         break;
         
+      case 'channel':
+        if ((message.payload as ChannelPayload).action === 'history') {
+          await this.handleChannelHistoryRequest(connectionId, message);
+        }
+        break;
+        
       default:
         this.sendError(connectionId, ErrorCodes.PROTOCOL_ERROR, `Unsupported gateway message type: ${message.type}`);
     }
@@ -457,13 +618,10 @@ export class Gateway extends EventEmitter {
     const mudUsers: WhoUser[] = [];
 
     for (const mudName of connectedMuds) {
-      // Normalize for lookup
-      const normalizedMudName = normalizeMudName(mudName).toLowerCase();
-      const connection = Array.from(this.connectionInfo.values())
-        .find(conn => conn.authenticated && normalizeMudName(conn.mudName).toLowerCase() === normalizedMudName);
+      const connection = this.findConnectionInfoByMud(mudName);
       
       if (connection) {
-        const idleSeconds = Math.floor((Date.now() - connection.lastSeen.getTime()) / 1000);
+        const idleSeconds = Math.floor((performance.now() - connection.lastSeen) / 1000);
         const uptimeSeconds = Math.floor((Date.now() - connection.connected.getTime()) / 1000);
         
         mudUsers.push({
@@ -598,8 +756,7 @@ export class Gateway extends EventEmitter {
     const mudList = [];
 
     for (const mudName of connectedMuds) {
-      const connection = Array.from(this.connectionInfo.values())
-        .find(conn => conn.authenticated && normalizeMudName(conn.mudName).toLowerCase() === normalizeMudName(mudName).toLowerCase());
+      const connection = this.findConnectionInfoByMud(mudName);
       
       if (connection) {
         const uptimeSeconds = Math.floor((Date.now() - connection.connected.getTime()) / 1000);
@@ -672,17 +829,75 @@ export class Gateway extends EventEmitter {
     await this.sendMessage(connectionId, response);
   }
 
+  private async handleChannelHistoryRequest(connectionId: string, message: MudVaultMessage): Promise<void> {
+    const payload = message.payload as ChannelPayload;
+    const limit = payload.limit || 20;
+
+    // History is only for those who could join the channel; the channel
+    // goes back in details so the client can stop waiting for it
+    const denied = channelService.getHistoryDenial(payload.channel, message.from);
+    if (denied) {
+      this.sendError(connectionId, ErrorCodes.UNAUTHORIZED, denied, { channel: payload.channel });
+      return;
+    }
+
+    // One bulk reply so a client replaying a channel on join never has to
+    // ask per message; stored newest first, sent oldest first
+    const history = (await channelService.getChannelHistory(payload.channel, limit, 'message')).reverse();
+
+    const response = createMessage(
+      'channel',
+      { mud: 'Gateway' },
+      { mud: message.from.mud, user: message.from.user, channel: payload.channel },
+      {
+        channel: payload.channel,
+        message: '',
+        action: 'history',
+        history
+      },
+      { priority: message.metadata.priority }
+    );
+
+    logger.info(`📜 CHANNEL HISTORY RESPONSE: ${connectionId}`, {
+      mudName: message.from.mud,
+      channel: payload.channel,
+      count: history.length
+    });
+
+    await this.sendMessage(connectionId, response);
+  }
+
   private findConnectionByMud(mudName: string): string | null {
-    const normalizedTarget = normalizeMudName(mudName).toLowerCase();
-    for (const [connId, info] of this.connectionInfo) {
-      if (normalizeMudName(info.mudName).toLowerCase() === normalizedTarget && info.authenticated) {
-        return connId;
+    return this.mudConnections.get(this.normalizeName(mudName)) ?? null;
+  }
+
+  private findConnectionInfoByMud(mudName: string): ConnectionInfo | undefined {
+    const connectionId = this.findConnectionByMud(mudName);
+    return connectionId ? this.connectionInfo.get(connectionId) : undefined;
+  }
+
+  /**
+   * normalizeMudName() runs several regexes, so results are cached per raw
+   * spelling. The cache is reset rather than evicted once it fills, since
+   * the set of names in use is small and stable.
+   */
+  private normalizeName(mudName: string): string {
+    let normalized = this.normalizedNames.get(mudName);
+    if (normalized === undefined) {
+      if (this.normalizedNames.size >= 4096) {
+        this.normalizedNames.clear();
       }
+      normalized = normalizeMudName(mudName).toLowerCase();
+      this.normalizedNames.set(mudName, normalized);
     }
-    return null;
+    return normalized;
   }
 
-  private async sendMessage(connectionId: string, message: MudVaultMessage): Promise<void> {
+  private encodeMessage(message: MudVaultMessage): Buffer {
+    return Buffer.from(JSON.stringify(message), 'utf8');
+  }
+
+  private async sendMessage(connectionId: string, message: MudVaultMessage, frame?: Buffer): Promise<void> {
     const ws = this.connections.get(connectionId);
     const connection = this.connectionInfo.get(connectionId);
     
@@ -695,20 +910,31 @@ export class Gateway extends EventEmitter {
       return;
     }
 
+    // MUDs that have not negotiated multitell get the equivalent plain tells
+    if (message.type === 'multitell' && !hasCapability(connection?.capabilities ?? 0, Capability.MultiTell)) {
+      await Promise.all(expandMultiTell(message).map(tell => this.sendMessage(connectionId, tell)));
+      return;
+    }
+
     try {
-      const messageJson = JSON.stringify(message);
-      const messageSize = Buffer.byteLength(messageJson, 'utf8');
+      const data = frame ?? this.encodeMessage(message);
       
-      logger.debug(`📤 OUTGOING MESSAGE: ${connectionId}`, {
+      hotPath.debug('📤 OUTGOING MESSAGE', () => ({
+        connectionId,
         mudName: connection?.mudName || 'Unknown',
         messageType: message.type,
         messageId: message.id,
-        messageSize,
+        messageSize: data.length,
         to: message.to.user ? `${message.to.user}@${message.to.mud}` : message.to.mud,
         isError: message.type === 'error'
-      });
+      }));
 
-      ws.send(messageJson);
+      const queue = this.sendQueues.get(connectionId);
+      if (!queue) {
+        ws.send(data, { binary: false });
+      } else if (queue.enqueue(data, message) === 'slow') {
+        this.disconnectSlowConsumer(connectionId, ws, queue);
+      }
     } catch (error) {
       logger.error(`❌ SEND ERROR: ${connectionId}`, {
         mudName: connection?.mudName || 'Unknown',
@@ -719,7 +945,24 @@ export class Gateway extends EventEmitter {
     }
   }
 
-  private sendError(connectionId: string, code: ErrorCodes, message: string): void {
+  private disconnectSlowConsumer(connectionId: string, ws: WebSocket, queue: SendQueue): void {
+    const connection = this.connectionInfo.get(connectionId);
+
+    this.slowConsumerDisconnects++;
+    logger.warn(`🐢 SLOW CONSUMER DISCONNECTED: ${connectionId}`, {
+      mudName: connection?.mudName || 'Unknown',
+      remoteAddress: connection?.host || 'Unknown',
+      bufferedAmount: ws.bufferedAmount,
+      ...queue.getStats(),
+      totalSlowConsumerDisconnects: this.slowConsumerDisconnects
+    });
+
+    // Stop queueing for it now; the close handler does the rest of the cleanup
+    this.sendQueues.delete(connectionId);
+    ws.terminate();
+  }
+
+  private sendError(connectionId: string, code: ErrorCodes, message: string, details?: any): void {
     const connection = this.connectionInfo.get(connectionId);
     if (!connection) {
       logger.warn(`⚠️ CANNOT SEND ERROR - Connection not found: ${connectionId}`);
@@ -737,17 +980,31 @@ export class Gateway extends EventEmitter {
       { mud: 'Gateway' },
       { mud: connection.mudName || 'Unknown' },
       code,
-      message
+      message,
+      details
     );
 
     this.sendMessage(connectionId, errorMessage);
   }
 
-  private async storeMessage(message: MudVaultMessage): Promise<void> {
+  // Queued write-behind; routing never waits on Redis for history
+  private storeMessage(message: MudVaultMessage, frame?: Buffer): void {
     try {
       const key = `message_history:${message.type}`;
-      await redisService.lpush(key, JSON.stringify(message));
-      await redisService.ltrim(key, 0, 999); // Keep last 1000 messages
+      persistence.append(key, frame ? frame.toString('utf8') : JSON.stringify(message), 1000); // Keep last 1000 messages
+
+      // Channel lines also go to the per-channel history that join replays read
+      const payload = message.payload as ChannelPayload;
+      if (message.type === 'channel' && (!payload.action || payload.action === 'message')) {
+        const entry: ChannelMessage = {
+          id: message.id,
+          timestamp: message.timestamp,
+          from: message.from,
+          message: payload.message || '',
+          type: 'message'
+        };
+        persistence.append(`channel_history:${payload.channel}`, JSON.stringify(entry), 1000);
+      }
     } catch (error) {
       logger.error('Error storing message:', error);
     }
@@ -775,46 +1032,82 @@ export class Gateway extends EventEmitter {
         connectionId,
         totalMessagesProcessed: connection.messageCount,
         sessionDuration: `${Math.round(connectionDuration / 1000)}s`,
-        lastSeen: connection.lastSeen.toISOString()
+        lastSeen: new Date(Date.now() - (performance.now() - connection.lastSeen)).toISOString()
       });
       
-      redisService.srem('connected_muds', connection.mudName);
-      this.mudInfo.delete(connection.mudName);
+      if (this.mudConnections.get(connection.mudName) === connectionId) {
+        // Hand the name back to an older duplicate connection if one is still up
+        const remaining = Array.from(this.connectionInfo.values())
+          .find(conn => conn.authenticated && conn.mudName === connection.mudName && conn.id !== connectionId);
+
+        if (remaining) {
+          this.mudConnections.set(connection.mudName, remaining.id);
+        } else {
+          this.mudConnections.delete(connection.mudName);
+          this.cluster?.release(connection.mudName);
+          redisService.srem('connected_muds', connection.mudName);
+          this.mudInfo.delete(connection.mudName);
+        }
+      }
       this.emit('mudDisconnected', { mudName: connection.mudName, connectionId });
     }
 
     this.connections.delete(connectionId);
     this.connectionInfo.delete(connectionId);
+    this.sendQueues.delete(connectionId);
+    this.stopHeartbeat(connectionId);
   }
 
+  /**
+   * Connections are dealt round-robin into the slots of one heartbeat wheel.
+   * Each tick visits a single slot, so every connection is still checked
+   * once per HEARTBEAT_INTERVAL_MS but pings go out spread evenly over it.
+   */
   private startHeartbeat(connectionId: string): void {
-    const interval = setInterval(() => {
+    const slot = this.nextHeartbeatSlot;
+    this.nextHeartbeatSlot = (slot + 1) % HEARTBEAT_SLOTS;
+
+    this.heartbeatWheel[slot].add(connectionId);
+    this.heartbeatSlots.set(connectionId, slot);
+  }
+
+  private stopHeartbeat(connectionId: string): void {
+    const slot = this.heartbeatSlots.get(connectionId);
+    if (slot !== undefined) {
+      this.heartbeatWheel[slot].delete(connectionId);
+      this.heartbeatSlots.delete(connectionId);
+    }
+  }
+
+  private heartbeatTick(): void {
+    const slot = this.heartbeatWheel[this.heartbeatPosition];
+    this.heartbeatPosition = (this.heartbeatPosition + 1) % HEARTBEAT_SLOTS;
+
+    const now = performance.now();
+    for (const connectionId of slot) {
       const ws = this.connections.get(connectionId);
       const connection = this.connectionInfo.get(connectionId);
-      
+
       if (!ws || !connection || ws.readyState !== WebSocket.OPEN) {
-        clearInterval(interval);
-        return;
+        this.stopHeartbeat(connectionId);
+        continue;
       }
 
-      const now = Date.now();
-      const lastSeen = connection.lastSeen.getTime();
-      
-      if (now - lastSeen > 60000) { // 60 seconds timeout
+      if (now - connection.lastSeen > HEARTBEAT_TIMEOUT_MS) {
         logger.warn(`Connection ${connectionId} timed out`);
+        this.stopHeartbeat(connectionId);
         ws.terminate();
-        clearInterval(interval);
-        return;
+        continue;
       }
 
       ws.ping();
-    }, 30000); // Ping every 30 seconds
+    }
   }
 
   private updateLastSeen(connectionId: string): void {
     const connection = this.connectionInfo.get(connectionId);
     if (connection) {
-      connection.lastSeen = new Date();
+      connection.lastSeen = performance.now();
     }
   }
 
@@ -830,6 +1123,19 @@ export class Gateway extends EventEmitter {
     return Array.from(this.mudInfo.values());
   }
 
+  public getSendQueueStats(): SendQueueStats & { slowConsumerDisconnects: number } {
+    const totals = { queuedMessages: 0, queuedBytes: 0, droppedFull: 0, droppedExpired: 0, slowConsumerDisconnects: this.slowConsumerDisconnects };
+
+    for (const queue of this.sendQueues.values()) {
+      const stats = queue.getStats();
+      totals.queuedMessages += stats.queuedMessages;
+      totals.queuedBytes += stats.queuedBytes;
+      totals.droppedFull += stats.droppedFull;
+      totals.droppedExpired += stats.droppedExpired;
+    }
+    return totals;
+  }
+
   public async close(): Promise<void> {
     logger.info('Shutting down gateway...');
     
@@ -838,6 +1144,9 @@ export class Gateway extends EventEmitter {
     }
 
     this.server.close();
+    clearInterval(this.heartbeatTimer);
+    this.cluster?.stop();
+    await persistence.flush();
     await redisService.disconnect();
   }
 }
@@ -0,0 +1,147 @@
+import logger from '../utils/logger';
+import redisService from './redis';
+
+interface PendingWrite {
+  key: string;
+  value: string;
+  maxLength: number;
+}
+
+/**
+ * Write-behind queue for history lists. Routing appends here and returns
+ * immediately; writes are grouped per key and sent as one pipeline every
+ * flush interval, or sooner once a batch fills up. The queue is a ring of
+ * maxPending writes: when Redis falls behind, the oldest pending writes
+ * are overwritten first.
+ */
+export class PersistenceQueue {
+  private pending: Array<PendingWrite | undefined>;
+  private head = 0;
+  private count = 0;
+  private timer: NodeJS.Timeout | null = null;
+  private flushing: Promise<void> | null = null;
+  private flushQueued = false;
+  private dropped = 0;
+
+  constructor(
+    private readonly flushIntervalMs: number = parseInt(process.env.PERSIST_FLUSH_MS || '50'),
+    private readonly batchSize: number = parseInt(process.env.PERSIST_BATCH_SIZE || '500'),
+    private readonly maxPending: number = parseInt(process.env.PERSIST_MAX_PENDING || '10000')
+  ) {
+    this.pending = new Array(maxPending);
+  }
+
+  /**
+   * Queue an lpush of value onto key, trimming the list to maxLength
+   */
+  public append(key: string, value: string, maxLength: number): void {
+    if (this.count >= this.maxPending) {
+      this.head = (this.head + 1) % this.maxPending;
+      this.count--;
+      if (this.dropped++ % 1000 === 0) {
+        logger.warn('Persistence queue full, dropping oldest writes', {
+          maxPending: this.maxPending,
+          dropped: this.dropped
+        });
+      }
+    }
+
+    this.pending[(this.head + this.count) % this.maxPending] = { key, value, maxLength };
+    this.count++;
+
+    if (this.count >= this.batchSize) {
+      this.requestFlush();
+    } else if (!this.timer && !this.flushQueued) {
+      this.timer = setTimeout(() => {
+        this.timer = null;
+        this.requestFlush();
+      }, this.flushIntervalMs);
+      this.timer.unref();
+    }
+  }
+
+  public size(): number {
+    return this.count;
+  }
+
+  public getDroppedCount(): number {
+    return this.dropped;
+  }
+
+  /**
+   * Write everything queued so far. Resolves once it is in Redis (or the
+   * attempt failed); concurrent callers share the in-progress flush.
+   */
+  public async flush(): Promise<void> {
+    if (this.timer) {
+      clearTimeout(this.timer);
+      this.timer = null;
+    }
+
+    while (this.flushing) {
+      await this.flushing;
+    }
+
+    this.flushQueued = false;
+    if (this.count === 0) {
+      return;
+    }
+
+    const batch = this.take();
+
+    this.flushing = this.write(batch);
+    try {
+      await this.flushing;
+    } finally {
+      this.flushing = null;
+    }
+  }
+
+  // Automatic flushes wait behind a slow write as one queued flush, however
+  // many appends ask for one meanwhile
+  private requestFlush(): void {
+    if (!this.flushQueued) {
+      this.flushQueued = true;
+      void this.flush();
+    }
+  }
+
+  private take(): PendingWrite[] {
+    const batch: PendingWrite[] = new Array(this.count);
+
+    for (let i = 0; i < this.count; i++) {
+      const slot = (this.head + i) % this.maxPending;
+      batch[i] = this.pending[slot]!;
+      this.pending[slot] = undefined;
+    }
+    this.head = 0;
+    this.count = 0;
+
+    return batch;
+  }
+
+  private async write(batch: PendingWrite[]): Promise<void> {
+    const lists = new Map<string, { values: string[]; maxLength: number }>();
+
+    for (const { key, value, maxLength } of batch) {
+      const list = lists.get(key);
+      if (list) {
+        list.values.push(value);
+      } else {
+        lists.set(key, { values: [value], maxLength });
+      }
+    }
+
+    try {
+      await redisService.lpushTrimBatch(lists);
+    } catch (error) {
+      logger.error('Error flushing persistence queue:', {
+        writes: batch.length,
+        lists: lists.size,
+        error: error instanceof Error ? error.message : 'Unknown error'
+      });
+    }
+  }
+}
+
+export default new PersistenceQueue();
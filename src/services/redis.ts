@@ -119,6 +119,25 @@ class RedisService {
     }
   }
 
+  /**
+   * Push several values onto several capped lists in one pipelined round
+   * trip. Values are pushed oldest first, so the newest ends up at the head
+   * just as with repeated lpush calls.
+   */
+  async lpushTrimBatch(lists: Map<string, { values: string[]; maxLength: number }>): Promise<void> {
+    try {
+      const pipeline = this.client.multi();
+      for (const [key, { values, maxLength }] of lists) {
+        pipeline.lPush(key, values);
+        pipeline.lTrim(key, 0, maxLength - 1);
+      }
+      await pipeline.execAsPipeline();
+    } catch (error) {
+      logger.error(`Error writing batch to ${lists.size} lists:`, error);
+      throw error;
+    }
+  }
+
   async sadd(key: string, member: string): Promise<void> {
     try {
       await this.client.sAdd(key, member);
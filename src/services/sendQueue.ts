@@ -0,0 +1,216 @@
+import WebSocket from 'ws';
+import { MudVaultMessage } from '../types';
+import { isExpired } from '../utils/message';
+
+interface QueuedFrame {
+  data: Buffer;
+  message: MudVaultMessage;
+}
+
+export type EnqueueResult = 'sent' | 'queued' | 'dropped' | 'slow';
+
+export interface SendQueueOptions {
+  /** Bytes allowed in the socket buffer before frames are held here */
+  highWaterMark: number;
+  /** Bytes allowed in this queue before frames are dropped */
+  maxQueuedBytes: number;
+  /** How long a queue may stay over half its byte cap before the peer counts as slow */
+  slowConsumerMs: number;
+}
+
+export const defaultSendQueueOptions: SendQueueOptions = {
+  highWaterMark: parseInt(process.env.SEND_HIGH_WATER_BYTES || String(256 * 1024)),
+  maxQueuedBytes: parseInt(process.env.SEND_QUEUE_MAX_BYTES || String(1024 * 1024)),
+  slowConsumerMs: parseInt(process.env.SEND_SLOW_CONSUMER_MS || '30000')
+};
+
+export interface SendQueueStats {
+  queuedMessages: number;
+  queuedBytes: number;
+  droppedFull: number;
+  droppedExpired: number;
+}
+
+// Priority classes from metadata.priority (1-10): high, normal, low
+const CLASS_COUNT = 3;
+
+const NEWLINE = Buffer.from('\n');
+
+function priorityClass(priority: number): number {
+  return priority >= 8 ? 0 : priority >= 4 ? 1 : 2;
+}
+
+/**
+ * Outbound queue for one connection. Frames go straight to the socket while
+ * its buffer is below the high water mark; past that they wait here by
+ * priority class, and are written as the socket drains. Expired frames are
+ * dropped when they reach the front, and once the byte cap is hit the
+ * oldest frames of the lowest class below the new one make room.
+ */
+export class SendQueue {
+  private classes: QueuedFrame[][] = [[], [], []];
+  private heads: number[] = [0, 0, 0];
+  private queuedBytes = 0;
+  private queuedMessages = 0;
+  private saturatedSince = 0;
+  private droppedFull = 0;
+  private droppedExpired = 0;
+  private batchBytes = 0;
+  private readonly onWritten = () => this.drain();
+
+  constructor(
+    private readonly ws: WebSocket,
+    private readonly options: SendQueueOptions = defaultSendQueueOptions
+  ) {}
+
+  /**
+   * Send or queue a frame. 'slow' means the queue has stayed over half its
+   * byte cap for longer than slowConsumerMs and the peer should be dropped.
+   */
+  public enqueue(data: Buffer, message: MudVaultMessage): EnqueueResult {
+    if (this.queuedMessages === 0 && this.ws.bufferedAmount < this.options.highWaterMark) {
+      this.ws.send(data, { binary: false }, this.onWritten);
+      return 'sent';
+    }
+
+    const cls = priorityClass(message.metadata.priority);
+    let dropped = false;
+
+    if (this.queuedBytes + data.length > this.options.maxQueuedBytes &&
+        !this.makeRoom(cls, data.length)) {
+      this.droppedFull++;
+      dropped = true;
+    } else {
+      this.classes[cls].push({ data, message });
+      this.queuedBytes += data.length;
+      this.queuedMessages++;
+      this.drain();
+    }
+
+    if (this.saturatedSince && Date.now() - this.saturatedSince >= this.options.slowConsumerMs) {
+      return 'slow';
+    }
+    return dropped ? 'dropped' : this.queuedMessages > 0 ? 'queued' : 'sent';
+  }
+
+  /**
+   * Let queued frames go out several to a frame, newline-separated, up to
+   * maxBytes per frame. Only for peers that negotiated batching. Routing
+   * keeps newlines out of frames; one that holds any is still sent alone.
+   */
+  public setBatching(maxBytes: number): void {
+    this.batchBytes = Math.max(maxBytes, 0);
+  }
+
+  /**
+   * Write queued frames while the socket has room. Every write's callback
+   * calls back in here, so the queue keeps moving as the socket drains.
+   */
+  public drain(): void {
+    while (this.queuedMessages > 0 &&
+           this.ws.readyState === WebSocket.OPEN &&
+           this.ws.bufferedAmount < this.options.highWaterMark) {
+      const frame = this.shift();
+      if (isExpired(frame.message)) {
+        this.droppedExpired++;
+        continue;
+      }
+      if (this.batchBytes > 0 && this.queuedMessages > 0) {
+        this.ws.send(this.takeBatch(frame.data), { binary: false }, this.onWritten);
+      } else {
+        this.ws.send(frame.data, { binary: false }, this.onWritten);
+      }
+    }
+
+    if (this.queuedBytes < this.options.maxQueuedBytes / 2) {
+      this.saturatedSince = 0;
+    } else if (!this.saturatedSince) {
+      this.saturatedSince = Date.now();
+    }
+  }
+
+  public getStats(): SendQueueStats {
+    return {
+      queuedMessages: this.queuedMessages,
+      queuedBytes: this.queuedBytes,
+      droppedFull: this.droppedFull,
+      droppedExpired: this.droppedExpired
+    };
+  }
+
+  // Join the next frames in send order onto first while they fit in one
+  // batch, stopping at a frame that could not be told apart once joined
+  private takeBatch(first: Buffer): Buffer {
+    const parts = [first];
+    let size = first.length;
+
+    if (first.includes(NEWLINE)) {
+      return first;
+    }
+
+    while (this.queuedMessages > 0) {
+      const next = this.peek();
+      if (size + 1 + next.data.length > this.batchBytes || next.data.includes(NEWLINE)) {
+        break;
+      }
+      this.shift();
+      if (isExpired(next.message)) {
+        this.droppedExpired++;
+        continue;
+      }
+      parts.push(NEWLINE, next.data);
+      size += 1 + next.data.length;
+    }
+
+    return parts.length === 1 ? first : Buffer.concat(parts, size);
+  }
+
+  // Evict from the lowest classes strictly below cls until size fits
+  private makeRoom(cls: number, size: number): boolean {
+    for (let victim = CLASS_COUNT - 1; victim > cls; victim--) {
+      while (this.heads[victim] < this.classes[victim].length) {
+        if (this.queuedBytes + size <= this.options.maxQueuedBytes) {
+          return true;
+        }
+        const frame = this.classes[victim][this.heads[victim]++];
+        this.queuedBytes -= frame.data.length;
+        this.queuedMessages--;
+        this.droppedFull++;
+      }
+      this.compact(victim);
+    }
+    return this.queuedBytes + size <= this.options.maxQueuedBytes;
+  }
+
+  private peek(): QueuedFrame {
+    for (let cls = 0; cls < CLASS_COUNT; cls++) {
+      if (this.heads[cls] < this.classes[cls].length) {
+        return this.classes[cls][this.heads[cls]];
+      }
+    }
+    throw new Error('peek() on an empty send queue');
+  }
+
+  private shift(): QueuedFrame {
+    for (let cls = 0; cls < CLASS_COUNT; cls++) {
+      if (this.heads[cls] < this.classes[cls].length) {
+        const frame = this.classes[cls][this.heads[cls]++];
+        this.queuedBytes -= frame.data.length;
+        this.queuedMessages--;
+        this.compact(cls);
+        return frame;
+      }
+    }
+    throw new Error('shift() on an empty send queue');
+  }
+
+  private compact(cls: number): void {
+    if (this.heads[cls] === this.classes[cls].length) {
+      this.classes[cls] = [];
+      this.heads[cls] = 0;
+    } else if (this.heads[cls] > 1024) {
+      this.classes[cls] = this.classes[cls].slice(this.heads[cls]);
+      this.heads[cls] = 0;
+    }
+  }
+}
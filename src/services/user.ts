@@ -1,11 +1,14 @@
 import { EventEmitter } from 'events';
 import { UserInfo, UserLocation, MessageEndpoint } from '../types';
 import logger from '../utils/logger';
+import { TrigramIndex } from '../utils/trigram';
 import redisService from './redis';
 
 export class UserService extends EventEmitter {
   private onlineUsers: Map<string, UserInfo> = new Map(); // user@mud -> UserInfo
   private userLocations: Map<string, UserLocation[]> = new Map(); // username -> locations
+  private mudUsers: Map<string, Set<string>> = new Map(); // mud -> user@mud keys online there
+  private searchIndex = new TrigramIndex<string>(); // user@mud over username, displayName, realName
 
   constructor() {
     super();
@@ -19,7 +22,7 @@ export class UserService extends EventEmitter {
       lastLogin: new Date().toISOString()
     };
 
-    this.onlineUsers.set(userKey, fullUserInfo);
+    this.trackOnline(mud, userKey, fullUserInfo);
 
     // Update location tracking
     if (!this.userLocations.has(userInfo.username)) {
@@ -52,7 +55,7 @@ export class UserService extends EventEmitter {
   public async setUserOffline(mud: string, username: string): Promise<void> {
     const userKey = `${username}@${mud}`;
     
-    this.onlineUsers.delete(userKey);
+    this.trackOffline(mud, userKey);
 
     // Update location tracking
     const locations = this.userLocations.get(username);
@@ -89,7 +92,7 @@ export class UserService extends EventEmitter {
     }
 
     const updatedInfo = { ...existingInfo, ...userInfo };
-    this.onlineUsers.set(userKey, updatedInfo);
+    this.trackOnline(mud, userKey, updatedInfo);
 
     // Update location if provided
     if (userInfo.location) {
@@ -127,9 +130,7 @@ export class UserService extends EventEmitter {
 
   public getOnlineUsers(mud?: string): UserInfo[] {
     if (mud) {
-      return Array.from(this.onlineUsers.entries())
-        .filter(([userKey]) => userKey.endsWith(`@${mud}`))
-        .map(([, userInfo]) => userInfo);
+      return Array.from(this.mudUsers.get(mud) || [], userKey => this.onlineUsers.get(userKey)!);
     }
     
     return Array.from(this.onlineUsers.values());
@@ -173,18 +174,10 @@ export class UserService extends EventEmitter {
 
   public async getUserCount(mud?: string): Promise<number> {
     if (mud) {
-      return (await this.getOnlineUsersFromRedis(mud)).length;
+      return this.mudUsers.get(mud)?.size || 0;
     }
     
-    let total = 0;
-    const muds = await redisService.smembers('connected_muds');
-    
-    for (const mudName of muds) {
-      const count = await this.getUserCount(mudName);
-      total += count;
-    }
-    
-    return total;
+    return this.onlineUsers.size;
   }
 
   public async cleanupOfflineUsers(): Promise<void> {
@@ -205,35 +198,42 @@ export class UserService extends EventEmitter {
   }
 
   public async searchUsers(query: string, limit: number = 10): Promise<UserInfo[]> {
-    const results: UserInfo[] = [];
-    const lowerQuery = query.toLowerCase();
-    
-    for (const userInfo of this.onlineUsers.values()) {
-      if (results.length >= limit) break;
-      
-      if (
-        userInfo.username.toLowerCase().includes(lowerQuery) ||
-        userInfo.displayName?.toLowerCase().includes(lowerQuery) ||
-        userInfo.realName?.toLowerCase().includes(lowerQuery)
-      ) {
-        results.push(userInfo);
-      }
-    }
-    
-    return results;
+    return this.searchIndex.search(query, limit).map(userKey => this.onlineUsers.get(userKey)!);
   }
 
   public getStats(): { totalUsers: number; mudCounts: Record<string, number> } {
     const mudCounts: Record<string, number> = {};
-    let totalUsers = 0;
     
-    for (const [userKey] of this.onlineUsers) {
-      const mud = userKey.split('@')[1];
-      mudCounts[mud] = (mudCounts[mud] || 0) + 1;
-      totalUsers++;
+    for (const [mud, users] of this.mudUsers) {
+      mudCounts[mud] = users.size;
     }
     
-    return { totalUsers, mudCounts };
+    return { totalUsers: this.onlineUsers.size, mudCounts };
+  }
+
+  // Keep the per-MUD sets and the search index in step with onlineUsers
+  private trackOnline(mud: string, userKey: string, userInfo: UserInfo): void {
+    this.onlineUsers.set(userKey, userInfo);
+
+    let users = this.mudUsers.get(mud);
+    if (!users) {
+      users = new Set();
+      this.mudUsers.set(mud, users);
+    }
+    users.add(userKey);
+
+    this.searchIndex.set(userKey, [userInfo.username, userInfo.displayName, userInfo.realName]);
+  }
+
+  private trackOffline(mud: string, userKey: string): void {
+    this.onlineUsers.delete(userKey);
+
+    const users = this.mudUsers.get(mud);
+    if (users?.delete(userKey) && users.size === 0) {
+      this.mudUsers.delete(mud);
+    }
+
+    this.searchIndex.delete(userKey);
   }
 
   public async initialize(): Promise<void> {
@@ -250,7 +250,7 @@ export class UserService extends EventEmitter {
           
           if (userData) {
             const userInfo: UserInfo = JSON.parse(userData);
-            this.onlineUsers.set(userKey, userInfo);
+            this.trackOnline(mud, userKey, userInfo);
           }
         }
       }
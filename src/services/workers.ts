@@ -0,0 +1,106 @@
+import cluster from 'cluster';
+import os from 'os';
+import logger from '../utils/logger';
+
+const RESTART_DELAY_MS = 1000;
+const MAX_RESTART_DELAY_MS = 30000;
+const STABLE_AFTER_MS = 60000; // A worker that lived this long resets its backoff
+
+/**
+ * Number of gateway worker processes to run: GATEWAY_WORKERS, where 'auto'
+ * means one per CPU. 1 (the default) runs everything in this process.
+ */
+export function workerCount(setting: string | undefined = process.env.GATEWAY_WORKERS): number {
+  if (setting === 'auto') {
+    return os.cpus().length;
+  }
+  const count = parseInt(setting || '1');
+  return Number.isFinite(count) && count > 1 ? count : 1;
+}
+
+/**
+ * Environment for worker `index`. Every worker joins the gateway cluster
+ * under its own node ID, so MUDs on other workers are reached through the
+ * cluster bus exactly as on other hosts. Only worker 0 runs the Discord
+ * bridge; a bridge per worker would relay every message several times.
+ */
+export function workerEnv(index: number, env: NodeJS.ProcessEnv = process.env): NodeJS.ProcessEnv {
+  const baseId = env.GATEWAY_NODE_ID || os.hostname();
+  const overrides: NodeJS.ProcessEnv = {
+    GATEWAY_CLUSTER: 'true',
+    GATEWAY_NODE_ID: `${baseId}-w${index}`,
+    GATEWAY_WORKER_INDEX: String(index)
+  };
+  if (index > 0) {
+    overrides.DISCORD_ENABLED = 'false';
+  }
+  return overrides;
+}
+
+/**
+ * Run as the primary of `count` gateway workers. The workers share the HTTP
+ * and WebSocket ports (the primary hands out accepted connections in turn),
+ * and a MUD stays on the worker that accepted it for the life of its
+ * connection. Workers that die are restarted with backoff.
+ */
+export function runWorkers(count: number): void {
+  const indexes: Map<number, number> = new Map(); // worker ID -> index
+  const started: Map<number, number> = new Map(); // index -> start time
+  const delays: Map<number, number> = new Map();  // index -> next restart delay
+  let stopping = false;
+
+  const fork = (index: number) => {
+    const worker = cluster.fork(workerEnv(index));
+    indexes.set(worker.id, index);
+    started.set(index, Date.now());
+  };
+
+  cluster.on('exit', (worker, code, signal) => {
+    const index = indexes.get(worker.id);
+    indexes.delete(worker.id);
+
+    if (stopping) {
+      if (indexes.size === 0) {
+        logger.info('All gateway workers stopped');
+        process.exit(0);
+      }
+      return;
+    }
+    if (index === undefined) {
+      return;
+    }
+
+    const lived = Date.now() - (started.get(index) || 0);
+    const delay = lived >= STABLE_AFTER_MS ? RESTART_DELAY_MS : (delays.get(index) || RESTART_DELAY_MS);
+    delays.set(index, Math.min(delay * 2, MAX_RESTART_DELAY_MS));
+
+    logger.error(`Gateway worker ${index} exited (${signal || code}), restarting in ${delay}ms`);
+    setTimeout(() => {
+      if (!stopping) {
+        fork(index);
+      }
+    }, delay);
+  });
+
+  const shutdown = (signal: NodeJS.Signals) => {
+    if (stopping) {
+      return;
+    }
+    stopping = true;
+    logger.info(`Received ${signal}, stopping ${indexes.size} gateway workers...`);
+    for (const worker of Object.values(cluster.workers || {})) {
+      worker?.process.kill(signal);
+    }
+    if (indexes.size === 0) {
+      process.exit(0);
+    }
+  };
+
+  process.on('SIGTERM', () => shutdown('SIGTERM'));
+  process.on('SIGINT', () => shutdown('SIGINT'));
+
+  logger.info(`Starting ${count} gateway workers`);
+  for (let index = 0; index < count; index++) {
+    fork(index);
+  }
+}
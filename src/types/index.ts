@@ -27,6 +27,7 @@ export interface MessageMetadata {
 
 export type MessageType = 
   | 'tell' 
+  | 'multitell' // One tell to several users, split per MUD by the gateway
   | 'emote' 
   | 'emoteto'
   | 'channel' 
@@ -43,6 +44,7 @@ export type MessageType =
 
 export type MessagePayload = 
   | TellPayload 
+  | MultiTellPayload
   | EmotePayload 
   | ChannelPayload 
   | WhoPayload 
@@ -60,6 +62,17 @@ export interface TellPayload {
   formatted?: string;
 }
 
+export interface TellRecipient {
+  mud: string;
+  user: string;
+}
+
+export interface MultiTellPayload {
+  message: string;
+  formatted?: string;
+  recipients: TellRecipient[]; // Each MUD receives only its own users
+}
+
 export interface EmotePayload {
   action: string;
   target?: string;
@@ -69,8 +82,10 @@ export interface EmotePayload {
 export interface ChannelPayload {
   channel: string;
   message: string;
-  action?: 'join' | 'leave' | 'message' | 'list';
+  action?: 'join' | 'leave' | 'message' | 'list' | 'history';
   formatted?: string;
+  limit?: number; // history requests
+  history?: ChannelMessage[]; // history responses, oldest first
 }
 
 export interface WhoPayload {
@@ -101,6 +116,8 @@ export interface AuthPayload {
   mudName?: string;
   challenge?: string;
   response?: string;
+  capabilities?: number; // Capability bitmap, see utils/capabilities
+  params?: { [key: string]: number };
 }
 
 export interface PingPayload {
@@ -196,9 +213,10 @@ export interface ConnectionInfo {
   host: string;
   authenticated: boolean;
   connected: Date;
-  lastSeen: Date;
+  lastSeen: number; // performance.now() at the last inbound traffic
   messageCount: number;
   version: string;
+  capabilities: number; // Negotiated at authentication
 }
 
 export interface WhoUser {
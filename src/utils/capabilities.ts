@@ -0,0 +1,52 @@
+/**
+ * Optional protocol features, negotiated in the auth exchange. A MUD sends
+ * the features it supports as a bitmap, plus any parameters they need; the
+ * gateway answers with the features both sides support, and only those are
+ * used for the session. A MUD that sends no bitmap gets none, so older
+ * clients see no change.
+ */
+export enum Capability {
+  Batching = 1 << 0,        // Several newline-separated messages per frame
+  Compression = 1 << 1,     // Bits reserved for features still to come
+  BinaryEncoding = 1 << 2,
+  Resume = 1 << 3,
+  InterestFilter = 1 << 4,
+  DirectoryDelta = 1 << 5,
+  MultiTell = 1 << 6        // Multitell envelopes instead of one tell per user
+}
+
+export interface SessionParams {
+  maxBatchBytes: number;    // Largest batched frame the MUD accepts
+}
+
+export interface Negotiated {
+  capabilities: number;
+  params: SessionParams;
+}
+
+// What this gateway implements
+export const GATEWAY_CAPABILITIES = Capability.Batching | Capability.MultiTell;
+
+const GATEWAY_PARAMS: SessionParams = {
+  maxBatchBytes: parseInt(process.env.SEND_BATCH_MAX_BYTES || String(16 * 1024))
+};
+
+/**
+ * Agree on the session's features from what the MUD offered. Parameters
+ * take the smaller of the two sides' limits; a feature whose parameter
+ * leaves it unusable is dropped.
+ */
+export function negotiateCapabilities(offered?: number, params?: Record<string, number>): Negotiated {
+  let capabilities = (offered || 0) & GATEWAY_CAPABILITIES;
+
+  const maxBatchBytes = Math.min(params?.maxBatchBytes ?? GATEWAY_PARAMS.maxBatchBytes, GATEWAY_PARAMS.maxBatchBytes);
+  if (maxBatchBytes <= 0) {
+    capabilities &= ~Capability.Batching;
+  }
+
+  return { capabilities, params: { maxBatchBytes: Math.max(maxBatchBytes, 0) } };
+}
+
+export function hasCapability(capabilities: number, capability: Capability): boolean {
+  return (capabilities & capability) !== 0;
+}
@@ -39,4 +39,38 @@ if (process.env.LOG_FILE) {
   }));
 }
 
+type LogFields = () => Record<string, unknown>;
+
+// Fraction of per-message info logs that are written (1 = all, 0.01 = 1 in 100)
+const parsedSampleRate = parseFloat(process.env.LOG_SAMPLE_RATE || '1');
+const sampleRate = isNaN(parsedSampleRate) ? 1 : Math.min(Math.max(parsedSampleRate, 0), 1);
+let sampleCredit = 0;
+
+function sampled(): boolean {
+  if (sampleRate >= 1) return true;
+  sampleCredit += sampleRate;
+  if (sampleCredit < 1) return false;
+  sampleCredit -= 1;
+  return true;
+}
+
+/**
+ * Logging for per-message code paths. Fields are passed as a function and
+ * only built when the entry is actually written, so a disabled level costs
+ * one comparison; info entries are additionally sampled by LOG_SAMPLE_RATE.
+ */
+export const hotPath = {
+  debug(message: string, fields: LogFields): void {
+    if (logger.isLevelEnabled('debug')) {
+      logger.debug(message, fields());
+    }
+  },
+
+  info(message: string, fields: LogFields): void {
+    if (logger.isLevelEnabled('info') && sampled()) {
+      logger.info(message, fields());
+    }
+  }
+};
+
 export default logger;
\ No newline at end of file
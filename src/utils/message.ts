@@ -1,5 +1,5 @@
 import { v4 as uuidv4 } from 'uuid';
-import { MudVaultMessage, MessageType, MessageEndpoint, MessagePayload, MessageMetadata } from '../types';
+import { MudVaultMessage, MessageType, MessageEndpoint, MessagePayload, MessageMetadata, MultiTellPayload, TellRecipient } from '../types';
 
 export function createMessage(
   type: MessageType,
@@ -84,6 +84,72 @@ export function createTellMessage(
   );
 }
 
+export function createMultiTellMessage(
+  from: MessageEndpoint,
+  recipients: TellRecipient[],
+  message: string
+): MudVaultMessage {
+  return createMessage(
+    'multitell',
+    from,
+    { mud: 'Gateway' },
+    {
+      message,
+      recipients
+    }
+  );
+}
+
+/**
+ * Split a multitell into one envelope per destination MUD, each listing
+ * only that MUD's recipients. MUD names are grouped by their normalized
+ * form and repeated users are dropped, so a MUD is never sent the line twice.
+ */
+export function splitMultiTell(
+  message: MudVaultMessage,
+  normalize: (mudName: string) => string = name => name.toLowerCase()
+): MudVaultMessage[] {
+  const payload = message.payload as MultiTellPayload;
+  const groups = new Map<string, TellRecipient[]>();
+  const seen = new Set<string>();
+
+  for (const recipient of payload.recipients) {
+    const mud = normalize(recipient.mud);
+    const key = `${recipient.user.toLowerCase()}@${mud}`;
+    if (seen.has(key)) continue;
+    seen.add(key);
+
+    const group = groups.get(mud);
+    if (group) {
+      group.push(recipient);
+    } else {
+      groups.set(mud, [recipient]);
+    }
+  }
+
+  return Array.from(groups.values(), recipients => ({
+    ...message,
+    to: { mud: recipients[0].mud },
+    payload: { ...payload, recipients }
+  }));
+}
+
+/**
+ * The equivalent plain tells, one per recipient, for MUDs that have not
+ * negotiated multitell
+ */
+export function expandMultiTell(message: MudVaultMessage): MudVaultMessage[] {
+  const { message: text, formatted, recipients } = message.payload as MultiTellPayload;
+
+  return recipients.map(recipient => createMessage(
+    'tell',
+    message.from,
+    { mud: recipient.mud, user: recipient.user },
+    formatted === undefined ? { message: text } : { message: text, formatted },
+    message.metadata
+  ));
+}
+
 export function createChannelMessage(
   from: MessageEndpoint,
   channel: string,
@@ -166,6 +232,9 @@ export function formatMessageForDisplay(message: MudVaultMessage): string {
     case 'tell':
       return `${message.from.user}@${message.from.mud} tells you: ${(message.payload as any).message}`;
     
+    case 'multitell':
+      return `${message.from.user}@${message.from.mud} tells you: ${(message.payload as any).message}`;
+
     case 'emote':
       return `${message.from.user}@${message.from.mud} ${(message.payload as any).action}`;
     
@@ -0,0 +1,114 @@
+/**
+ * Case-insensitive substring index over a few text fields per key. Every
+ * field is split into overlapping three-character grams; a query can only
+ * match keys holding all of its grams, so a search walks the shortest of
+ * those posting sets and confirms each candidate, instead of testing every
+ * key. Queries shorter than a gram fall back to a scan.
+ */
+export class TrigramIndex<K> {
+  private postings: Map<string, Set<K>> = new Map();
+  private entries: Map<K, { fields: string[]; grams: Set<string> }> = new Map();
+
+  get size(): number {
+    return this.entries.size;
+  }
+
+  /**
+   * Index a key's fields, replacing whatever was indexed for it before
+   */
+  public set(key: K, fields: Array<string | undefined>): void {
+    this.delete(key);
+
+    const lowered = fields.filter((field): field is string => !!field).map(field => field.toLowerCase());
+    const grams = new Set<string>();
+    for (const field of lowered) {
+      for (const gram of trigrams(field)) {
+        grams.add(gram);
+      }
+    }
+
+    for (const gram of grams) {
+      let keys = this.postings.get(gram);
+      if (!keys) {
+        keys = new Set();
+        this.postings.set(gram, keys);
+      }
+      keys.add(key);
+    }
+
+    this.entries.set(key, { fields: lowered, grams });
+  }
+
+  public delete(key: K): boolean {
+    const entry = this.entries.get(key);
+    if (!entry) {
+      return false;
+    }
+
+    for (const gram of entry.grams) {
+      const keys = this.postings.get(gram)!;
+      keys.delete(key);
+      if (keys.size === 0) {
+        this.postings.delete(gram);
+      }
+    }
+
+    this.entries.delete(key);
+    return true;
+  }
+
+  /**
+   * Keys with a field containing the query, up to limit
+   */
+  public search(query: string, limit: number = Infinity): K[] {
+    const needle = query.toLowerCase();
+    const results: K[] = [];
+
+    if (limit <= 0) {
+      return results;
+    }
+
+    if (needle.length < 3) {
+      for (const [key, entry] of this.entries) {
+        if (entry.fields.some(field => field.includes(needle))) {
+          results.push(key);
+          if (results.length >= limit) break;
+        }
+      }
+      return results;
+    }
+
+    const sets: Set<K>[] = [];
+    for (const gram of trigrams(needle)) {
+      const keys = this.postings.get(gram);
+      if (!keys) {
+        return results;
+      }
+      sets.push(keys);
+    }
+    sets.sort((a, b) => a.size - b.size);
+
+    for (const key of sets[0]) {
+      if (!sets.every(keys => keys.has(key))) continue;
+      if (!this.entries.get(key)!.fields.some(field => field.includes(needle))) continue;
+
+      results.push(key);
+      if (results.length >= limit) break;
+    }
+
+    return results;
+  }
+
+  public clear(): void {
+    this.postings.clear();
+    this.entries.clear();
+  }
+}
+
+function trigrams(text: string): Set<string> {
+  const grams = new Set<string>();
+  for (let i = 0; i + 3 <= text.length; i++) {
+    grams.add(text.slice(i, i + 3));
+  }
+  return grams;
+}
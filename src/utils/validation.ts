@@ -1,6 +1,8 @@
 import Joi from 'joi';
 import { MudVaultMessage, MessageType } from '../types';
 
+export const MULTITELL_MAX_RECIPIENTS = 32;
+
 const messageEndpointSchema = Joi.object({
   mud: Joi.string().required(),
   user: Joi.string().optional(),
@@ -30,6 +32,15 @@ const tellPayloadSchema = basePayloadSchema.keys({
   message: Joi.string().max(4096).allow('').required()
 });
 
+const multiTellPayloadSchema = Joi.object({
+  message: Joi.string().max(4096).allow('').required(),
+  formatted: Joi.string().max(8192).optional(),
+  recipients: Joi.array().items(Joi.object({
+    mud: Joi.string().required(),
+    user: Joi.string().required()
+  })).min(1).max(MULTITELL_MAX_RECIPIENTS).required()
+});
+
 const emotePayloadSchema = Joi.object({
   action: Joi.string().max(4096).required(),
   target: Joi.string().optional(),
@@ -44,8 +55,9 @@ const channelPayloadSchema = Joi.object({
     return value;
   }),
   message: Joi.string().max(4096).allow('').optional(),
-  action: Joi.string().valid('join', 'leave', 'message', 'list').optional(),
-  formatted: Joi.string().max(8192).optional()
+  action: Joi.string().valid('join', 'leave', 'message', 'list', 'history').optional(),
+  formatted: Joi.string().max(8192).optional(),
+  limit: Joi.number().integer().min(1).max(100).optional()
 });
 
 const whoUserSchema = Joi.object({
@@ -94,7 +106,9 @@ const authPayloadSchema = Joi.object({
   token: Joi.string().optional(),
   mudName: Joi.string().optional(),
   challenge: Joi.string().optional(),
-  response: Joi.string().optional()
+  response: Joi.string().optional(),
+  capabilities: Joi.number().integer().min(0).optional(),
+  params: Joi.object().pattern(Joi.string(), Joi.number().integer().min(0)).optional()
 });
 
 const pingPayloadSchema = Joi.object({
@@ -133,6 +147,7 @@ const channelsPayloadSchema = Joi.object({
 
 const payloadSchemas: Record<MessageType, Joi.ObjectSchema> = {
   tell: tellPayloadSchema,
+  multitell: multiTellPayloadSchema,
   emote: emotePayloadSchema,
   emoteto: emotePayloadSchema,
   channel: channelPayloadSchema,
@@ -160,7 +175,293 @@ const messageSchema = Joi.object({
   metadata: messageMetadataSchema.required()
 });
 
+/*
+ * Compiled fast path.
+ *
+ * The schemas above are mirrored below as straight-line checks built once at
+ * load time. They accept a strict subset of what Joi accepts: anything that
+ * would need conversion (numeric strings, JSON-encoded objects, non-canonical
+ * timestamps, braced UUIDs) or is rejected falls through to Joi, which stays
+ * the authority for both the result and the error text. A passing envelope is
+ * validated in place, so the success path builds no intermediate objects.
+ */
+
+type Check = (value: any) => boolean;
+
+interface Field {
+  check: Check;
+  required: boolean;
+}
+
+const required = (check: Check): Field => ({ check, required: true });
+const optional = (check: Check): Field => ({ check, required: false });
+
+const NAME_PATTERN = /^[a-zA-Z0-9\-_]{1,32}$/;
+const UUID_PATTERN = /^[0-9a-f]{8}-[0-9a-f]{4}-[1-8][0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12}$/i;
+const ISO_TIMESTAMP_PATTERN = /^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}\.\d{3}Z$/;
+
+function isPlainObject(value: any): boolean {
+  return typeof value === 'object' && value !== null && !Array.isArray(value);
+}
+
+function str(options: { max?: number; allowEmpty?: boolean; valid?: readonly string[]; test?: (value: string) => boolean } = {}): Check {
+  const max = options.max ?? Infinity;
+  const minLength = options.allowEmpty ? 0 : 1;
+  const valid = options.valid ? new Set(options.valid) : undefined;
+  const test = options.test;
+
+  return (value) =>
+    typeof value === 'string' &&
+    value.length >= minLength &&
+    value.length <= max &&
+    (valid === undefined || valid.has(value)) &&
+    (test === undefined || test(value));
+}
+
+function num(options: { integer?: boolean; min?: number; max?: number } = {}): Check {
+  const min = Math.max(options.min ?? -Infinity, Number.MIN_SAFE_INTEGER);
+  const max = Math.min(options.max ?? Infinity, Number.MAX_SAFE_INTEGER);
+  const integer = options.integer === true;
+
+  return (value) =>
+    typeof value === 'number' &&
+    value >= min &&
+    value <= max &&
+    (!integer || Number.isInteger(value));
+}
+
+const bool: Check = (value) => typeof value === 'boolean';
+const anyValue: Check = () => true;
+const anyObject: Check = isPlainObject;
+
+function arrayOf(item: Check): Check {
+  return (value) => {
+    if (!Array.isArray(value)) return false;
+    for (let i = 0; i < value.length; i++) {
+      if (!item(value[i])) return false;
+    }
+    return true;
+  };
+}
+
+function arrayOfLength(item: Check, min: number, max: number): Check {
+  const items = arrayOf(item);
+  return (value) => items(value) && value.length >= min && value.length <= max;
+}
+
+// Like Joi.object().pattern(Joi.string(), ...), which rejects an empty key
+function recordOf(item: Check): Check {
+  return (value) => {
+    if (!isPlainObject(value)) return false;
+    for (const key in value) {
+      if (key === '' || !item(value[key])) return false;
+    }
+    return true;
+  };
+}
+
+function objectOf(fields: Record<string, Field>): Check {
+  const known = new Map(Object.entries(fields));
+  const requiredKeys = Object.keys(fields).filter(key => fields[key].required);
+
+  return (value) => {
+    if (!isPlainObject(value)) return false;
+    for (const key in value) {
+      const field = known.get(key);
+      if (field === undefined || !field.check(value[key])) return false;
+    }
+    for (let i = 0; i < requiredKeys.length; i++) {
+      if (value[requiredKeys[i]] === undefined) return false;
+    }
+    return true;
+  };
+}
+
+function digitsAt(value: string, start: number, count: number): number {
+  let result = 0;
+  for (let i = start; i < start + count; i++) {
+    result = result * 10 + value.charCodeAt(i) - 48;
+  }
+  return result;
+}
+
+// Only the exact Date#toISOString() form, so the value Joi would convert to is the value itself
+function isCanonicalTimestamp(value: string): boolean {
+  if (!ISO_TIMESTAMP_PATTERN.test(value)) return false;
+
+  const year = digitsAt(value, 0, 4);
+  const month = digitsAt(value, 5, 2);
+  const day = digitsAt(value, 8, 2);
+  const leap = (year % 4 === 0 && year % 100 !== 0) || year % 400 === 0;
+  const daysInMonth = month === 2 ? (leap ? 29 : 28) : month === 4 || month === 6 || month === 9 || month === 11 ? 30 : 31;
+
+  return month >= 1 && month <= 12 &&
+    day >= 1 && day <= daysInMonth &&
+    digitsAt(value, 11, 2) <= 23 &&
+    digitsAt(value, 14, 2) <= 59 &&
+    digitsAt(value, 17, 2) <= 59;
+}
+
+const fastEndpoint = objectOf({
+  mud: required(str()),
+  user: optional(str()),
+  displayName: optional(str()),
+  channel: optional(str({ test: value => NAME_PATTERN.test(value) }))
+});
+
+const fastMetadata = objectOf({
+  priority: optional(num({ integer: true, min: 1, max: 10 })),
+  ttl: optional(num({ integer: true, min: 1, max: 3600 })),
+  encoding: optional(str()),
+  language: optional(str()),
+  retry: optional(bool)
+});
+
+const fastEmotePayload = objectOf({
+  action: required(str({ max: 4096 })),
+  target: optional(str()),
+  formatted: optional(str({ max: 8192 }))
+});
+
+const fastPingPayload = objectOf({
+  timestamp: required(num())
+});
+
+const fastStringArray = arrayOf(str());
+
+const fastPayloadChecks: Record<MessageType, Check> = {
+  tell: objectOf({
+    message: required(str({ max: 4096, allowEmpty: true })),
+    formatted: optional(str({ max: 8192 }))
+  }),
+  multitell: objectOf({
+    message: required(str({ max: 4096, allowEmpty: true })),
+    formatted: optional(str({ max: 8192 })),
+    recipients: required(arrayOfLength(objectOf({
+      mud: required(str()),
+      user: required(str())
+    }), 1, MULTITELL_MAX_RECIPIENTS))
+  }),
+  emote: fastEmotePayload,
+  emoteto: fastEmotePayload,
+  channel: objectOf({
+    channel: required(str({ test: value => NAME_PATTERN.test(value) })),
+    message: optional(str({ max: 4096, allowEmpty: true })),
+    action: optional(str({ valid: ['join', 'leave', 'message', 'list', 'history'] })),
+    formatted: optional(str({ max: 8192 })),
+    limit: optional(num({ integer: true, min: 1, max: 100 }))
+  }),
+  who: objectOf({
+    users: optional(arrayOf(objectOf({
+      username: required(str()),
+      displayName: optional(str()),
+      title: optional(str()),
+      level: optional(str()),
+      idle: required(num({ integer: true, min: 0 })),
+      location: optional(str()),
+      flags: optional(fastStringArray),
+      realName: optional(str())
+    }))),
+    request: optional(bool),
+    sort: optional(str({ valid: ['alpha', 'level', 'idle', 'random'] })),
+    format: optional(str({ valid: ['short', 'long', 'custom'] })),
+    filter: optional(objectOf({
+      minLevel: optional(str()),
+      maxLevel: optional(str()),
+      flags: optional(fastStringArray)
+    }))
+  }),
+  finger: objectOf({
+    user: required(str()),
+    info: optional(anyObject),
+    request: optional(bool)
+  }),
+  locate: objectOf({
+    user: required(str()),
+    locations: optional(arrayOf(anyObject)),
+    request: optional(bool)
+  }),
+  presence: objectOf({
+    status: required(str({ valid: ['online', 'offline', 'away', 'busy'] })),
+    activity: optional(str()),
+    location: optional(str())
+  }),
+  auth: objectOf({
+    token: optional(str()),
+    mudName: optional(str()),
+    challenge: optional(str()),
+    response: optional(str()),
+    capabilities: optional(num({ integer: true, min: 0 })),
+    params: optional(recordOf(num({ integer: true, min: 0 })))
+  }),
+  ping: fastPingPayload,
+  pong: fastPingPayload,
+  error: objectOf({
+    code: required(num({ integer: true })),
+    message: required(str()),
+    details: optional(anyValue)
+  }),
+  mudlist: objectOf({
+    muds: optional(arrayOf(objectOf({
+      name: required(str()),
+      host: optional(str()),
+      version: optional(str()),
+      admin: optional(str()),
+      email: optional(str()),
+      uptime: optional(num()),
+      users: optional(num()),
+      description: optional(str())
+    }))),
+    request: optional(bool)
+  }),
+  channels: objectOf({
+    channels: optional(arrayOf(objectOf({
+      name: required(str()),
+      description: optional(str()),
+      memberCount: optional(num()),
+      flags: optional(fastStringArray)
+    }))),
+    request: optional(bool)
+  })
+};
+
+const fastEnvelope = objectOf({
+  version: required(str({ valid: ['1.0'] })),
+  id: required(str({ test: value => UUID_PATTERN.test(value) })),
+  timestamp: required(str({ test: isCanonicalTimestamp })),
+  type: required(str({ valid: Object.keys(payloadSchemas) })),
+  from: required(fastEndpoint),
+  to: required(fastEndpoint),
+  payload: required(anyObject),
+  signature: optional(str()),
+  metadata: required(fastMetadata)
+});
+
+/**
+ * True when the compiled checks accept the message as-is. A false result
+ * does not mean the message is invalid, only that Joi has to decide.
+ */
+export function matchesCompiledSchema(message: any): boolean {
+  return fastEnvelope(message) && fastPayloadChecks[message.type as MessageType](message.payload);
+}
+
 export function validateMessage(message: any): { error?: string; value?: MudVaultMessage } {
+  if (matchesCompiledSchema(message)) {
+    const metadata = message.metadata;
+    if (metadata.priority === undefined) metadata.priority = 5;
+    if (metadata.ttl === undefined) metadata.ttl = 300;
+    if (metadata.encoding === undefined) metadata.encoding = 'utf-8';
+    if (metadata.language === undefined) metadata.language = 'en';
+    return { value: message as MudVaultMessage };
+  }
+
+  return validateMessageSchema(message);
+}
+
+/**
+ * Full Joi validation; the reference the compiled checks are tested against
+ */
+export function validateMessageSchema(message: any): { error?: string; value?: MudVaultMessage } {
   const { error, value } = messageSchema.validate(message, { allowUnknown: false });
   
   if (error) {
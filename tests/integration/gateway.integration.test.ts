@@ -192,6 +192,31 @@ describe('Gateway Integration Tests', () => {
     expect(received.from.user).toBe('User1');
   });
 
+  test('should forward a multi-line message on a single line', async () => {
+    await Promise.all([
+      new Promise(resolve => wsClient1.on('open', resolve)),
+      new Promise(resolve => wsClient2.on('open', resolve))
+    ]);
+
+    await authenticate(wsClient1, TEST_MUD_1);
+    await authenticate(wsClient2, TEST_MUD_2);
+
+    const rawPromise = new Promise<string>(resolve => wsClient2.once('message', data => resolve(data.toString())));
+
+    const tellMessage = createMessage(
+      'tell',
+      { mud: TEST_MUD_1, user: 'User1' },
+      { mud: TEST_MUD_2, user: 'User2' },
+      { message: 'Pretty-printed' }
+    );
+
+    wsClient1.send(JSON.stringify(tellMessage, null, 2).replace(/\n/g, '\r\n'));
+    const raw = await rawPromise;
+
+    expect(raw).not.toContain('\n');
+    expect(JSON.parse(raw).payload.message).toBe('Pretty-printed');
+  });
+
   test('should handle mudlist requests', async () => {
     // Connect and authenticate both clients
     await Promise.all([
@@ -24,4 +24,15 @@ jest.mock('../src/services/redis', () => ({
   smembers: jest.fn().mockResolvedValue([]),
   lpush: jest.fn().mockResolvedValue(1),
   ltrim: jest.fn().mockResolvedValue('OK'),
-}));
\ No newline at end of file
+  lrange: jest.fn().mockResolvedValue([]),
+  lpushTrimBatch: jest.fn().mockResolvedValue(undefined),
+  publish: jest.fn().mockResolvedValue(undefined),
+  subscribe: jest.fn().mockResolvedValue(undefined),
+}));
+
+// Mock the Redis-backed rate limiters so the gateway doesn't open its own connection
+jest.mock('../src/middleware/rateLimiter', () => ({
+  consumeMessageRateLimit: jest.fn().mockResolvedValue({ allowed: true, retryAfter: 0 }),
+  checkMessageRateLimit: jest.fn().mockResolvedValue(true),
+  checkWebSocketRateLimit: jest.fn().mockResolvedValue(true),
+}));
@@ -0,0 +1,77 @@
+import { ChannelService } from '../../src/services/channel';
+import redisService from '../../src/services/redis';
+
+const lrange = redisService.lrange as jest.Mock;
+
+describe('ChannelService', () => {
+  const creator = { mud: 'Home', user: 'admin' };
+
+  beforeEach(() => {
+    lrange.mockReset();
+    lrange.mockResolvedValue([]);
+  });
+
+  describe('getAccessDenial', () => {
+    test('should allow anyone into an open channel', async () => {
+      const service = new ChannelService();
+      const channel = await service.createChannel('gossip', creator);
+
+      expect(service.getAccessDenial(channel, { mud: 'Far', user: 'bob' })).toBeNull();
+    });
+
+    test('should deny banned users and MUDs outside a restricted channel', async () => {
+      const service = new ChannelService();
+      const channel = await service.createChannel('staff', creator);
+      channel.banned.push('bob@Far');
+      channel.mudRestricted = true;
+      channel.allowedMuds = ['Home', 'Far'];
+
+      expect(service.getAccessDenial(channel, { mud: 'Far', user: 'bob' })).toMatch(/banned/);
+      expect(service.getAccessDenial(channel, { mud: 'Elsewhere', user: 'eve' })).toMatch(/not allowed/);
+      expect(service.getAccessDenial(channel, { mud: 'Far', user: 'joe' })).toBeNull();
+      await expect(service.joinChannel('staff', { mud: 'Elsewhere', user: 'eve' })).rejects.toThrow(/not allowed/);
+      expect(service.getHistoryDenial('staff', { mud: 'Elsewhere', user: 'eve' })).toMatch(/not allowed/);
+    });
+
+    test('should serve history for a mesh channel that has no record', async () => {
+      const stored = [JSON.stringify({ id: '1', timestamp: '', from: { mud: 'Far', user: 'bob' }, message: 'hi', type: 'message' })];
+      lrange.mockImplementation(async (_key: string, start: number, stop: number) => stored.slice(start, stop + 1));
+
+      const service = new ChannelService();
+
+      expect(service.getChannel('gossip')).toBeUndefined();
+      expect(service.getHistoryDenial('gossip', { mud: 'Far', user: 'bob' })).toBeNull();
+      expect(await service.getChannelHistory('gossip', 20, 'message')).toHaveLength(1);
+    });
+  });
+
+  describe('getChannelHistory', () => {
+    const entry = (n: number, type: string) =>
+      JSON.stringify({ id: `${n}`, timestamp: '', from: { mud: 'Far', user: 'bob' }, message: `m${n}`, type });
+
+    test('should fill the limit with entries of the requested type', async () => {
+      // Newest first: the latest 50 entries are all joins and leaves
+      const stored = [
+        ...Array.from({ length: 50 }, (_, n) => entry(n, n % 2 ? 'join' : 'leave')),
+        ...Array.from({ length: 30 }, (_, n) => entry(50 + n, 'message'))
+      ];
+      lrange.mockImplementation(async (_key: string, start: number, stop: number) => stored.slice(start, stop + 1));
+
+      const service = new ChannelService();
+      const history = await service.getChannelHistory('gossip', 20, 'message');
+
+      expect(history).toHaveLength(20);
+      expect(history.map(h => h.message)).toEqual(Array.from({ length: 20 }, (_, n) => `m${50 + n}`));
+    });
+
+    test('should stop at the end of the list', async () => {
+      const stored = [entry(0, 'join'), entry(1, 'message')];
+      lrange.mockImplementation(async (_key: string, start: number, stop: number) => stored.slice(start, stop + 1));
+
+      const service = new ChannelService();
+
+      expect(await service.getChannelHistory('gossip', 20, 'message')).toHaveLength(1);
+      expect(lrange).toHaveBeenCalledTimes(1);
+    });
+  });
+});
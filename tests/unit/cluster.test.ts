@@ -0,0 +1,76 @@
+import { ClusterBus } from '../../src/services/cluster';
+import redisService from '../../src/services/redis';
+
+describe('ClusterBus', () => {
+  let subscribers: Map<string, Array<(message: string) => void>>;
+
+  beforeEach(() => {
+    // In-memory stand-in for Redis pub/sub shared by every node in a test
+    subscribers = new Map();
+    (redisService.subscribe as jest.Mock).mockImplementation(async (channel: string, callback: (message: string) => void) => {
+      subscribers.set(channel, [...(subscribers.get(channel) || []), callback]);
+    });
+    (redisService.publish as jest.Mock).mockImplementation(async (channel: string, message: string) => {
+      for (const callback of subscribers.get(channel) || []) {
+        callback(message);
+      }
+    });
+  });
+
+  const startNode = async (nodeId: string, localMuds: string[] = []) => {
+    const node = new ClusterBus(nodeId);
+    await node.start(() => localMuds);
+    node.stop();
+    return node;
+  };
+
+  test('should learn which node holds a MUD', async () => {
+    const a = await startNode('a');
+    const b = await startNode('b');
+
+    a.claim('mud1');
+    expect(b.ownerOf('mud1')).toBe('a');
+    expect(a.ownerOf('mud1')).toBeUndefined();
+
+    a.release('mud1');
+    expect(b.ownerOf('mud1')).toBeUndefined();
+  });
+
+  test('should send claims to a node that joins later', async () => {
+    await startNode('a', ['mud1']);
+    const c = await startNode('c');
+
+    expect(c.ownerOf('mud1')).toBe('a');
+  });
+
+  test('should forward frames to the owning node only', async () => {
+    const a = await startNode('a');
+    const b = await startNode('b');
+    const c = await startNode('c');
+    const onA = jest.fn();
+    const onC = jest.fn();
+    a.on('forward', onA);
+    c.on('forward', onC);
+
+    b.forward('a', 'mud1', Buffer.from('{"id":"x"}'));
+
+    expect(onA).toHaveBeenCalledWith('mud1', Buffer.from('{"id":"x"}'));
+    expect(onC).not.toHaveBeenCalled();
+  });
+
+  test('should deliver a broadcast once to every other node', async () => {
+    const a = await startNode('a');
+    const b = await startNode('b');
+    const c = await startNode('c');
+    const received = { a: jest.fn(), b: jest.fn(), c: jest.fn() };
+    a.on('broadcast', received.a);
+    b.on('broadcast', received.b);
+    c.on('broadcast', received.c);
+
+    a.broadcast(Buffer.from('{"type":"channel"}'));
+
+    expect(received.a).not.toHaveBeenCalled();
+    expect(received.b).toHaveBeenCalledTimes(1);
+    expect(received.c).toHaveBeenCalledTimes(1);
+  });
+});
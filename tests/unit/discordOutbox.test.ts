@@ -0,0 +1,143 @@
+import { DiscordOutbox, OutboxBatch, RateLimitState } from '../../src/services/discordOutbox';
+
+describe('DiscordOutbox', () => {
+  const options = { coalesceMs: 500, maxLines: 10, maxChars: 1000, maxBacklog: 50, bucketSize: 5, bucketWindowMs: 5000 };
+
+  beforeEach(() => {
+    jest.useFakeTimers();
+    jest.setSystemTime(1_000_000);
+  });
+
+  afterEach(() => {
+    jest.useRealTimers();
+  });
+
+  // Stand-in for Discord's create-message route: 5 requests per 5s per channel,
+  // reported in the rate-limit headers, and a 429 for anything over that
+  const mockDiscord = () => {
+    const buckets = new Map<string, { used: number; resetAt: number }>();
+    const received: Array<{ target: string; batch: OutboxBatch }> = [];
+    let rejected = 0;
+
+    const send = jest.fn(async (target: string, batch: OutboxBatch): Promise<RateLimitState> => {
+      const now = Date.now();
+      let bucket = buckets.get(target);
+      if (!bucket || now >= bucket.resetAt) {
+        bucket = { used: 0, resetAt: now + 5000 };
+        buckets.set(target, bucket);
+      }
+      if (bucket.used >= 5) {
+        rejected++;
+        throw Object.assign(new Error('429 Too Many Requests'), { retryAfter: bucket.resetAt - now });
+      }
+      bucket.used++;
+      received.push({ target, batch });
+      return { remaining: 5 - bucket.used, resetAfterMs: bucket.resetAt - now };
+    });
+
+    return { send, received, rejected: () => rejected };
+  };
+
+  const line = (n: number, channel: string = 'gossip') =>
+    ({ channel, mud: 'Far', user: 'bob', text: `message ${n}`, timestamp: new Date().toISOString() });
+
+  test('should coalesce lines arriving within the window into one batch', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, options);
+
+    outbox.enqueue('c1', line(1));
+    await jest.advanceTimersByTimeAsync(100);
+    outbox.enqueue('c1', line(2));
+    outbox.enqueue('c1', line(3));
+    expect(discord.send).not.toHaveBeenCalled();
+
+    await jest.advanceTimersByTimeAsync(400);
+
+    expect(discord.received).toHaveLength(1);
+    expect(discord.received[0].batch.lines.map(l => l.text)).toEqual(['message 1', 'message 2', 'message 3']);
+    expect(discord.received[0].batch.skipped).toBe(0);
+  });
+
+  test('should keep targets independent', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, options);
+
+    outbox.enqueue('c1', line(1));
+    outbox.enqueue('c2', line(2));
+    await jest.advanceTimersByTimeAsync(500);
+
+    expect(discord.received.map(r => r.target).sort()).toEqual(['c1', 'c2']);
+  });
+
+  test('should keep up with a storm without tripping the rate limit', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, options);
+
+    // 8 lines a second for 15 seconds, against one send a second
+    for (let n = 0; n < 120; n++) {
+      outbox.enqueue('c1', line(n));
+      await jest.advanceTimersByTimeAsync(125);
+    }
+    await jest.advanceTimersByTimeAsync(6000);
+
+    const delivered = discord.received.flatMap(r => r.batch.lines.map(l => l.text));
+    expect(discord.rejected()).toBe(0);
+    expect(delivered).toEqual(Array.from({ length: 120 }, (_, n) => `message ${n}`));
+    expect(discord.received.length).toBeLessThanOrEqual(20);
+    expect(outbox.getStats().queuedLines).toBe(0);
+  });
+
+  test('should skip the oldest lines past the backlog cap and report them', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, { ...options, maxBacklog: 20 });
+
+    for (let n = 0; n < 30; n++) {
+      outbox.enqueue('c1', line(n));
+    }
+    await jest.advanceTimersByTimeAsync(10000);
+
+    const delivered = discord.received.flatMap(r => r.batch.lines.map(l => l.text));
+    expect(delivered[0]).toBe('message 10');
+    expect(delivered).toHaveLength(20);
+    expect(discord.received[0].batch.skipped).toBe(10);
+    expect(outbox.getStats().skippedLines).toBe(10);
+  });
+
+  test('should hold a target on a 429 and report the lost batch', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, options);
+
+    // Something else used up the channel's bucket; our view of it is stale
+    outbox.updateRateLimit('c1', { remaining: 1, resetAfterMs: 3000 });
+    for (let used = 0; used < 5; used++) {
+      await discord.send('c1', { lines: [], skipped: 0 }).catch(() => undefined);
+    }
+    discord.received.length = 0;
+
+    outbox.enqueue('c1', line(1));
+    await jest.advanceTimersByTimeAsync(500);
+    expect(discord.rejected()).toBe(1);
+
+    outbox.enqueue('c1', line(2));
+    await jest.advanceTimersByTimeAsync(1000);
+    expect(discord.received).toHaveLength(0);
+
+    await jest.advanceTimersByTimeAsync(5000);
+    expect(discord.received).toHaveLength(1);
+    expect(discord.received[0].batch.lines.map(l => l.text)).toEqual(['message 2']);
+    expect(discord.received[0].batch.skipped).toBe(1);
+    expect(outbox.getStats().failedBatches).toBe(1);
+  });
+
+  test('should send nothing after stop', async () => {
+    const discord = mockDiscord();
+    const outbox = new DiscordOutbox(discord.send, options);
+
+    outbox.enqueue('c1', line(1));
+    outbox.stop();
+    outbox.enqueue('c1', line(2));
+    await jest.advanceTimersByTimeAsync(5000);
+
+    expect(discord.send).not.toHaveBeenCalled();
+  });
+});
@@ -0,0 +1,123 @@
+import { GcraLimiter, GcraStore } from '../../src/middleware/gcra';
+
+describe('GcraLimiter', () => {
+  let now: jest.SpyInstance;
+
+  beforeEach(() => {
+    now = jest.spyOn(Date, 'now').mockReturnValue(1_000_000);
+  });
+
+  afterEach(() => {
+    now.mockRestore();
+  });
+
+  // Fake pipeline backed by a plain counter map, shared like Redis would be
+  const fakeStore = (counters: Map<string, number>): GcraStore => ({
+    multi() {
+      const replies: Array<() => unknown> = [];
+      const pipeline = {
+        incrBy(key: string, increment: number) {
+          replies.push(() => {
+            counters.set(key, (counters.get(key) || 0) + increment);
+            return counters.get(key);
+          });
+          return pipeline;
+        },
+        pExpire() {
+          replies.push(() => 1);
+          return pipeline;
+        },
+        async execAsPipeline() {
+          return replies.map(reply => reply());
+        }
+      };
+      return pipeline;
+    }
+  });
+
+  test('should allow a full burst and then reject', () => {
+    const limiter = new GcraLimiter({ keyPrefix: 't', points: 5, duration: 60, tolerance: 1 });
+
+    for (let i = 0; i < 5; i++) {
+      expect(limiter.consume('mud').allowed).toBe(true);
+    }
+    const rejected = limiter.consume('mud');
+    expect(rejected.allowed).toBe(false);
+    expect(rejected.msBeforeNext).toBe(12000);
+  });
+
+  test('should allow a single consume of up to burstPoints', () => {
+    const limiter = new GcraLimiter({ keyPrefix: 't', points: 30, duration: 60, tolerance: 0.5 });
+
+    expect(limiter.burstPoints).toBe(15);
+    expect(limiter.consume('over', limiter.burstPoints + 1).allowed).toBe(false);
+    expect(limiter.consume('full', limiter.burstPoints).allowed).toBe(true);
+    expect(limiter.consume('full').allowed).toBe(false);
+  });
+
+  test('should recover one point per emission interval', () => {
+    const limiter = new GcraLimiter({ keyPrefix: 't', points: 5, duration: 60, tolerance: 1 });
+
+    for (let i = 0; i < 5; i++) {
+      limiter.consume('mud');
+    }
+    now.mockReturnValue(1_000_000 + 12000);
+    expect(limiter.consume('mud').allowed).toBe(true);
+    expect(limiter.consume('mud').allowed).toBe(false);
+  });
+
+  test('should block a key for blockDuration once it goes over', () => {
+    const limiter = new GcraLimiter({ keyPrefix: 't', points: 1, duration: 1, blockDuration: 60, tolerance: 1 });
+
+    expect(limiter.consume('mud').allowed).toBe(true);
+    expect(limiter.consume('mud').msBeforeNext).toBe(60000);
+
+    now.mockReturnValue(1_000_000 + 30000);
+    expect(limiter.consume('mud').allowed).toBe(false);
+  });
+
+  test('should scale the burst by tolerance', () => {
+    const limiter = new GcraLimiter({ keyPrefix: 't', points: 10, duration: 60, tolerance: 0.5 });
+
+    let allowed = 0;
+    while (limiter.consume('mud').allowed) {
+      allowed++;
+    }
+    expect(allowed).toBe(5);
+  });
+
+  test('should charge usage from other nodes after reconciling', async () => {
+    const counters = new Map<string, number>();
+    const store = fakeStore(counters);
+    const nodeA = new GcraLimiter({ keyPrefix: 'rl', points: 10, duration: 60, tolerance: 1 });
+    const nodeB = new GcraLimiter({ keyPrefix: 'rl', points: 10, duration: 60, tolerance: 1 });
+
+    nodeA.consume('mud');
+    nodeB.consume('mud');
+    await nodeA.reconcile(store);
+    await nodeB.reconcile(store);
+
+    for (let i = 0; i < 6; i++) {
+      nodeA.consume('mud');
+    }
+    await nodeA.reconcile(store);
+    await nodeB.reconcile(store);
+
+    expect(counters.get('rl:mud')).toBe(8);
+    // B used 1 itself and learned of A's 6 new requests, leaving 3
+    expect(nodeB.get('mud')!.remainingPoints).toBe(3);
+  });
+
+  test('should forget keys that have fully recovered', async () => {
+    const limiter = new GcraLimiter({ keyPrefix: 'rl', points: 10, duration: 60, tolerance: 1 });
+    const store = fakeStore(new Map());
+
+    limiter.consume('mud');
+    await limiter.reconcile(store);
+    expect(limiter.size()).toBe(1);
+
+    now.mockReturnValue(1_000_000 + 60000);
+    await limiter.reconcile(store);
+    expect(limiter.size()).toBe(0);
+  });
+});
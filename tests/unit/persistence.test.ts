@@ -0,0 +1,114 @@
+import { PersistenceQueue } from '../../src/services/persistence';
+import redisService from '../../src/services/redis';
+
+const lpushTrimBatch = redisService.lpushTrimBatch as jest.Mock;
+
+describe('PersistenceQueue', () => {
+  beforeEach(() => {
+    lpushTrimBatch.mockClear();
+  });
+
+  test('should group queued writes per list in one batch', async () => {
+    const queue = new PersistenceQueue(1000, 100, 100);
+
+    queue.append('message_history:tell', 'a', 1000);
+    queue.append('channel_history:gossip', 'b', 1000);
+    queue.append('message_history:tell', 'c', 1000);
+    expect(lpushTrimBatch).not.toHaveBeenCalled();
+
+    await queue.flush();
+
+    expect(lpushTrimBatch).toHaveBeenCalledTimes(1);
+    const lists = lpushTrimBatch.mock.calls[0][0];
+    expect(lists.get('message_history:tell')).toEqual({ values: ['a', 'c'], maxLength: 1000 });
+    expect(lists.get('channel_history:gossip')).toEqual({ values: ['b'], maxLength: 1000 });
+    expect(queue.size()).toBe(0);
+  });
+
+  describe('automatic flushes', () => {
+    beforeEach(() => {
+      jest.useFakeTimers();
+    });
+
+    afterEach(() => {
+      jest.useRealTimers();
+    });
+
+    test('should flush on its own once a batch fills', async () => {
+      const queue = new PersistenceQueue(1000, 2, 100);
+
+      queue.append('k', 'a', 10);
+      await jest.advanceTimersByTimeAsync(0);
+      expect(lpushTrimBatch).not.toHaveBeenCalled();
+
+      queue.append('k', 'b', 10);
+      await jest.advanceTimersByTimeAsync(0);
+
+      expect(lpushTrimBatch).toHaveBeenCalledTimes(1);
+      expect(lpushTrimBatch.mock.calls[0][0].get('k').values).toEqual(['a', 'b']);
+      expect(queue.size()).toBe(0);
+    });
+
+    test('should flush on its own after the interval', async () => {
+      const queue = new PersistenceQueue(100, 50, 100);
+
+      queue.append('k', 'a', 10);
+      await jest.advanceTimersByTimeAsync(99);
+      expect(lpushTrimBatch).not.toHaveBeenCalled();
+
+      await jest.advanceTimersByTimeAsync(1);
+      expect(lpushTrimBatch).toHaveBeenCalledTimes(1);
+      expect(queue.size()).toBe(0);
+    });
+
+    test('should stay bounded and queue one flush behind a stuck write', async () => {
+      let release: () => void = () => undefined;
+      lpushTrimBatch.mockImplementationOnce(() => new Promise<void>(resolve => { release = resolve; }));
+      const queue = new PersistenceQueue(10, 2, 5);
+      const flush = jest.spyOn(queue, 'flush');
+
+      queue.append('k', 'a', 10);
+      queue.append('k', 'b', 10);
+      await jest.advanceTimersByTimeAsync(0);
+      expect(lpushTrimBatch).toHaveBeenCalledTimes(1);
+
+      // Redis is stuck on the first batch while 20 more writes arrive
+      for (let n = 0; n < 20; n++) {
+        queue.append('k', `w${n}`, 10);
+        await jest.advanceTimersByTimeAsync(10);
+      }
+      expect(queue.size()).toBe(5);
+      expect(queue.getDroppedCount()).toBe(15);
+      expect((queue as any).pending.length).toBe(5);
+      expect(lpushTrimBatch).toHaveBeenCalledTimes(1);
+      expect(flush).toHaveBeenCalledTimes(2);
+
+      release();
+      await jest.advanceTimersByTimeAsync(100);
+
+      expect(lpushTrimBatch).toHaveBeenCalledTimes(2);
+      expect(lpushTrimBatch.mock.calls[1][0].get('k').values).toEqual(['w15', 'w16', 'w17', 'w18', 'w19']);
+      expect(queue.size()).toBe(0);
+    });
+  });
+
+  test('should drop the oldest writes when full', async () => {
+    const queue = new PersistenceQueue(1000, 100, 2);
+
+    queue.append('k', 'a', 10);
+    queue.append('k', 'b', 10);
+    queue.append('k', 'c', 10);
+    expect(queue.size()).toBe(2);
+    expect(queue.getDroppedCount()).toBe(1);
+
+    await queue.flush();
+    expect(lpushTrimBatch.mock.calls[0][0].get('k').values).toEqual(['b', 'c']);
+  });
+
+  test('should not write when nothing is queued', async () => {
+    const queue = new PersistenceQueue();
+
+    await queue.flush();
+    expect(lpushTrimBatch).not.toHaveBeenCalled();
+  });
+});
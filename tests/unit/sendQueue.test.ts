@@ -0,0 +1,129 @@
+import WebSocket from 'ws';
+import { SendQueue } from '../../src/services/sendQueue';
+import { createMessage } from '../../src/utils/message';
+
+describe('SendQueue', () => {
+  const options = { highWaterMark: 100, maxQueuedBytes: 40, slowConsumerMs: 1000 };
+
+  const fakeSocket = () => {
+    const ws: any = { readyState: WebSocket.OPEN, bufferedAmount: 0 };
+    ws.send = jest.fn((_data: Buffer, _options: any, callback?: () => void) => {
+      ws.lastCallback = callback;
+    });
+    return ws;
+  };
+
+  const message = (priority: number, ttl: number = 300) =>
+    createMessage('tell', { mud: 'A' }, { mud: 'B', user: 'bob' }, { message: 'hi' }, { priority, ttl });
+
+  const frame = (text: string) => Buffer.from(text.padEnd(10, '.'));
+
+  test('should send directly while the socket has room', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, options);
+
+    expect(queue.enqueue(frame('a'), message(5))).toBe('sent');
+    expect(ws.send).toHaveBeenCalledTimes(1);
+  });
+
+  test('should hold frames while the socket is backed up and send by priority', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, options);
+    ws.bufferedAmount = 200;
+
+    expect(queue.enqueue(frame('low'), message(1))).toBe('queued');
+    expect(queue.enqueue(frame('high'), message(9))).toBe('queued');
+    expect(ws.send).not.toHaveBeenCalled();
+
+    ws.bufferedAmount = 0;
+    queue.drain();
+
+    expect(ws.send.mock.calls.map((call: any[]) => call[0].toString().replace(/\.+$/, ''))).toEqual(['high', 'low']);
+    expect(queue.getStats().queuedMessages).toBe(0);
+  });
+
+  test('should evict lower priority frames when the byte cap is hit', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, options);
+    ws.bufferedAmount = 200;
+
+    for (let i = 0; i < 4; i++) {
+      queue.enqueue(frame(`low${i}`), message(1));
+    }
+    expect(queue.enqueue(frame('high'), message(9))).toBe('queued');
+    expect(queue.enqueue(frame('normal'), message(5))).toBe('queued');
+
+    const stats = queue.getStats();
+    expect(stats.queuedBytes).toBeLessThanOrEqual(40);
+    expect(stats.droppedFull).toBe(2);
+  });
+
+  test('should drop expired frames at dequeue', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, options);
+    ws.bufferedAmount = 200;
+
+    const stale = message(5, 1);
+    stale.timestamp = new Date(Date.now() - 5000).toISOString();
+    queue.enqueue(frame('stale'), stale);
+
+    ws.bufferedAmount = 0;
+    queue.drain();
+
+    expect(ws.send).not.toHaveBeenCalled();
+    expect(queue.getStats().droppedExpired).toBe(1);
+  });
+
+  test('should join queued frames into newline-separated batches once negotiated', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, { ...options, maxQueuedBytes: 100 });
+    queue.setBatching(25);
+    ws.bufferedAmount = 200;
+
+    queue.enqueue(frame('a'), message(5));
+    queue.enqueue(frame('b'), message(5));
+    queue.enqueue(frame('c'), message(5));
+
+    ws.bufferedAmount = 0;
+    queue.drain();
+
+    const sent = ws.send.mock.calls.map((call: any[]) => call[0].toString());
+    expect(sent).toEqual(['a.........\nb.........', 'c.........']);
+    expect(queue.getStats().queuedMessages).toBe(0);
+  });
+
+  test('should send a frame holding newlines of its own outside any batch', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, { ...options, maxQueuedBytes: 100 });
+    queue.setBatching(50);
+    ws.bufferedAmount = 200;
+
+    queue.enqueue(frame('a'), message(5));
+    queue.enqueue(Buffer.from('{\r\n  "b": 1\r\n}'), message(5));
+    queue.enqueue(frame('c'), message(5));
+    queue.enqueue(frame('d'), message(5));
+
+    ws.bufferedAmount = 0;
+    queue.drain();
+
+    const sent = ws.send.mock.calls.map((call: any[]) => call[0].toString());
+    expect(sent).toEqual(['a.........', '{\r\n  "b": 1\r\n}', 'c.........\nd.........']);
+  });
+
+  test('should report a peer that stays backed up as slow', () => {
+    const ws = fakeSocket();
+    const queue = new SendQueue(ws, options);
+    const now = jest.spyOn(Date, 'now');
+    ws.bufferedAmount = 200;
+
+    now.mockReturnValue(1000);
+    queue.enqueue(frame('a'), message(5));
+    queue.enqueue(frame('b'), message(5));
+    expect(queue.enqueue(frame('c'), message(5))).toBe('queued');
+
+    now.mockReturnValue(2500);
+    expect(queue.enqueue(frame('d'), message(5))).toBe('slow');
+
+    now.mockRestore();
+  });
+});
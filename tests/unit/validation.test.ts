@@ -1,4 +1,4 @@
-import { validateMessage, validateMudName, normalizeMudName } from '../../src/utils/validation';
+import { validateMessage, validateMessageSchema, matchesCompiledSchema, validateMudName, normalizeMudName } from '../../src/utils/validation';
 import { MudVaultMessage } from '../../src/types';
 
 describe('validateMessage', () => {
@@ -44,6 +44,21 @@ describe('validateMessage', () => {
       expect(result.error).toBeUndefined();
     });
 
+    test('should validate a channel history request', () => {
+      const message = createValidMessage({
+        type: 'channel',
+        to: { mud: 'Gateway', channel: 'gossip' },
+        payload: {
+          channel: 'gossip',
+          action: 'history',
+          limit: 20
+        }
+      });
+      
+      const result = validateMessage(message);
+      expect(result.error).toBeUndefined();
+    });
+
     test('should validate a who request', () => {
       const message = createValidMessage({
         type: 'who',
@@ -245,4 +260,107 @@ describe('normalizeMudName', () => {
     expect(normalizeMudName('a'.repeat(40))).toBe('a'.repeat(32));
     expect(normalizeMudName('---test---')).toBe('test');
   });
-});
\ No newline at end of file
+});
+
+describe('compiled validation', () => {
+  const envelope = (overrides: any = {}): any => ({
+    version: '1.0',
+    id: '0192d3c4-5e6f-7a8b-9c0d-1e2f3a4b5c6d',
+    timestamp: '2025-01-26T12:34:56.789Z',
+    type: 'tell',
+    from: { mud: 'TestMUD', user: 'alice' },
+    to: { mud: 'TargetMUD', user: 'bob' },
+    payload: { message: 'Hello world' },
+    metadata: { priority: 5, ttl: 300, encoding: 'utf-8', language: 'en' },
+    ...overrides
+  });
+
+  // Shared corpus: the compiled checks and Joi must agree on every entry
+  const corpus: Array<[string, any]> = [
+    ['tell', envelope()],
+    ['tell with empty message', envelope({ payload: { message: '' } })],
+    ['tell without message', envelope({ payload: {} })],
+    ['tell with oversized message', envelope({ payload: { message: 'x'.repeat(4097) } })],
+    ['tell with unknown payload key', envelope({ payload: { message: 'hi', extra: true } })],
+    ['multitell', envelope({ type: 'multitell', to: { mud: 'Gateway' }, payload: { message: 'hi', recipients: [{ mud: 'A', user: 'bob' }, { mud: 'B', user: 'amy' }] } })],
+    ['multitell without recipients', envelope({ type: 'multitell', payload: { message: 'hi', recipients: [] } })],
+    ['multitell too many recipients', envelope({ type: 'multitell', payload: { message: 'hi', recipients: Array.from({ length: 33 }, () => ({ mud: 'A', user: 'bob' })) } })],
+    ['multitell recipient without user', envelope({ type: 'multitell', payload: { message: 'hi', recipients: [{ mud: 'A' }] } })],
+    ['v4 id', envelope({ id: '550e8400-e29b-41d4-a716-446655440000' })],
+    ['braced id', envelope({ id: '{550e8400-e29b-41d4-a716-446655440000}' })],
+    ['bad id', envelope({ id: 'not-a-uuid' })],
+    ['timestamp without millis', envelope({ timestamp: '2025-01-26T12:34:56Z' })],
+    ['timestamp with offset', envelope({ timestamp: '2025-01-26T12:34:56.789+02:00' })],
+    ['impossible date', envelope({ timestamp: '2025-02-30T12:34:56.789Z' })],
+    ['leap day', envelope({ timestamp: '2024-02-29T00:00:00.000Z' })],
+    ['bad timestamp', envelope({ timestamp: 'yesterday' })],
+    ['unknown envelope key', envelope({ extra: 1 })],
+    ['signature', envelope({ signature: 'abc' })],
+    ['empty signature', envelope({ signature: '' })],
+    ['bad version', envelope({ version: '2.0' })],
+    ['unknown type', envelope({ type: 'unknown' })],
+    ['prototype type', envelope({ type: 'toString' })],
+    ['empty from mud', envelope({ from: { mud: '' } })],
+    ['array from', envelope({ from: [] })],
+    ['bad endpoint channel', envelope({ to: { mud: '*', channel: 'bad name' } })],
+    ['metadata defaults', envelope({ metadata: {} })],
+    ['metadata numeric string', envelope({ metadata: { priority: '7' } })],
+    ['metadata fractional ttl', envelope({ metadata: { ttl: 1.5 } })],
+    ['metadata retry', envelope({ metadata: { retry: true } })],
+    ['missing metadata', envelope({ metadata: undefined })],
+    ['channel message', envelope({ type: 'channel', to: { mud: '*', channel: 'gossip' }, payload: { channel: 'gossip', message: 'hi', action: 'message' } })],
+    ['channel history', envelope({ type: 'channel', to: { mud: 'Gateway', channel: 'gossip' }, payload: { channel: 'gossip', action: 'history', limit: 20 } })],
+    ['channel history limit too high', envelope({ type: 'channel', payload: { channel: 'gossip', action: 'history', limit: 101 } })],
+    ['channel bad action', envelope({ type: 'channel', payload: { channel: 'gossip', action: 'shout' } })],
+    ['channel bad name', envelope({ type: 'channel', payload: { channel: 'no spaces' } })],
+    ['emote', envelope({ type: 'emote', payload: { action: 'waves', target: 'bob' } })],
+    ['emote without action', envelope({ type: 'emoteto', payload: {} })],
+    ['who request', envelope({ type: 'who', payload: { request: true, sort: 'alpha', format: 'long' } })],
+    ['who users', envelope({ type: 'who', payload: { users: [{ username: 'alice', idle: 0, level: '50', flags: ['admin'] }] } })],
+    ['who negative idle', envelope({ type: 'who', payload: { users: [{ username: 'alice', idle: -1 }] } })],
+    ['who string boolean', envelope({ type: 'who', payload: { request: 'true' } })],
+    ['who filter', envelope({ type: 'who', payload: { filter: { minLevel: '1', flags: ['newbie'] } } })],
+    ['finger', envelope({ type: 'finger', payload: { user: 'bob', request: true } })],
+    ['finger info', envelope({ type: 'finger', payload: { user: 'bob', info: { anything: [1, 2] } } })],
+    ['locate', envelope({ type: 'locate', payload: { user: 'bob', locations: [{ mud: 'X' }] } })],
+    ['presence', envelope({ type: 'presence', payload: { status: 'away' } })],
+    ['presence bad status', envelope({ type: 'presence', payload: { status: 'asleep' } })],
+    ['auth', envelope({ type: 'auth', to: { mud: 'Gateway' }, payload: { mudName: 'TestMUD', token: 'key' } })],
+    ['auth capabilities', envelope({ type: 'auth', to: { mud: 'Gateway' }, payload: { mudName: 'TestMUD', capabilities: 3, params: { maxBatchBytes: 8000 } } })],
+    ['auth negative capabilities', envelope({ type: 'auth', payload: { mudName: 'TestMUD', capabilities: -1 } })],
+    ['auth string param', envelope({ type: 'auth', payload: { mudName: 'TestMUD', params: { maxBatchBytes: '8000' } } })],
+    ['auth empty param name', envelope({ type: 'auth', payload: { mudName: 'TestMUD', params: { '': 1 } } })],
+    ['ping', envelope({ type: 'ping', payload: { timestamp: 1706271296789 } })],
+    ['pong without timestamp', envelope({ type: 'pong', payload: {} })],
+    ['error', envelope({ type: 'error', payload: { code: 1006, message: 'Slow down', details: { retryAfter: 2 } } })],
+    ['error fractional code', envelope({ type: 'error', payload: { code: 1.5, message: 'x' } })],
+    ['mudlist', envelope({ type: 'mudlist', payload: { muds: [{ name: 'X', users: 3 }] } })],
+    ['channels', envelope({ type: 'channels', payload: { channels: [{ name: 'gossip', memberCount: 2, flags: ['public'] }] } })],
+    ['channels item without name', envelope({ type: 'channels', payload: { channels: [{ description: 'x' }] } })],
+    ['not an object', 'tell'],
+    ['null', null]
+  ];
+
+  test.each(corpus)('should agree with the Joi schema: %s', (_name, message) => {
+    const clone = () => (message === null || typeof message !== 'object' ? message : JSON.parse(JSON.stringify(message)));
+    const compiled = validateMessage(clone());
+    const reference = validateMessageSchema(clone());
+
+    expect(compiled.error).toEqual(reference.error);
+    expect(compiled.value).toEqual(reference.value);
+  });
+
+  test('should take the fast path for canonical messages', () => {
+    expect(matchesCompiledSchema(envelope())).toBe(true);
+    expect(matchesCompiledSchema(envelope({ metadata: {} }))).toBe(true);
+    expect(matchesCompiledSchema(envelope({ type: 'ping', payload: { timestamp: 1 } }))).toBe(true);
+  });
+
+  test('should validate in place and fill metadata defaults', () => {
+    const message = envelope({ metadata: {} });
+    const result = validateMessage(message);
+
+    expect(result.value).toBe(message);
+    expect(message.metadata).toEqual({ priority: 5, ttl: 300, encoding: 'utf-8', language: 'en' });
+  });
+});
@@ -0,0 +1,42 @@
+import os from 'os';
+import { workerCount, workerEnv } from '../../src/services/workers';
+
+describe('Gateway workers', () => {
+  describe('workerCount', () => {
+    it('should default to a single process', () => {
+      expect(workerCount(undefined)).toBe(1);
+      expect(workerCount('')).toBe(1);
+      expect(workerCount('0')).toBe(1);
+      expect(workerCount('nonsense')).toBe(1);
+    });
+
+    it('should honour an explicit count', () => {
+      expect(workerCount('4')).toBe(4);
+    });
+
+    it('should use one worker per CPU for auto', () => {
+      expect(workerCount('auto')).toBe(os.cpus().length);
+    });
+  });
+
+  describe('workerEnv', () => {
+    it('should give each worker its own cluster node ID', () => {
+      const env = { GATEWAY_NODE_ID: 'gw1' };
+
+      expect(workerEnv(0, env)).toMatchObject({ GATEWAY_CLUSTER: 'true', GATEWAY_NODE_ID: 'gw1-w0', GATEWAY_WORKER_INDEX: '0' });
+      expect(workerEnv(3, env)).toMatchObject({ GATEWAY_CLUSTER: 'true', GATEWAY_NODE_ID: 'gw1-w3', GATEWAY_WORKER_INDEX: '3' });
+    });
+
+    it('should fall back to the hostname for node IDs', () => {
+      expect(workerEnv(1, {}).GATEWAY_NODE_ID).toBe(`${os.hostname()}-w1`);
+    });
+
+    it('should leave the Discord bridge to the first worker', () => {
+      const env = { DISCORD_ENABLED: 'true' };
+
+      expect(workerEnv(0, env).DISCORD_ENABLED).toBeUndefined();
+      expect(workerEnv(1, env).DISCORD_ENABLED).toBe('false');
+      expect(workerEnv(7, env).DISCORD_ENABLED).toBe('false');
+    });
+  });
+});
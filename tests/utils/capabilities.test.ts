@@ -0,0 +1,29 @@
+import { Capability, GATEWAY_CAPABILITIES, hasCapability, negotiateCapabilities } from '../../src/utils/capabilities';
+
+describe('Capability negotiation', () => {
+  test('should enable nothing for clients that offer nothing', () => {
+    const negotiated = negotiateCapabilities(undefined, undefined);
+
+    expect(negotiated.capabilities).toBe(0);
+  });
+
+  test('should enable only features both sides support', () => {
+    const offered = Capability.Batching | Capability.Compression | Capability.Resume;
+    const negotiated = negotiateCapabilities(offered, { maxBatchBytes: 8000 });
+
+    expect(negotiated.capabilities).toBe(offered & GATEWAY_CAPABILITIES);
+    expect(hasCapability(negotiated.capabilities, Capability.Batching)).toBe(true);
+    expect(hasCapability(negotiated.capabilities, Capability.Compression)).toBe(false);
+  });
+
+  test('should settle parameters on the smaller limit', () => {
+    expect(negotiateCapabilities(Capability.Batching, { maxBatchBytes: 100 }).params.maxBatchBytes).toBe(100);
+    expect(negotiateCapabilities(Capability.Batching, { maxBatchBytes: 10 * 1024 * 1024 }).params.maxBatchBytes).toBe(16 * 1024);
+  });
+
+  test('should drop batching when the client cannot take any', () => {
+    const negotiated = negotiateCapabilities(Capability.Batching, { maxBatchBytes: 0 });
+
+    expect(hasCapability(negotiated.capabilities, Capability.Batching)).toBe(false);
+  });
+});
@@ -0,0 +1,64 @@
+describe('Hot path logging', () => {
+  const originalLevel = process.env.LOG_LEVEL;
+  const originalRate = process.env.LOG_SAMPLE_RATE;
+
+  // Assigning undefined to process.env stores the string "undefined"
+  function setEnv(name: string, value: string | undefined) {
+    if (value === undefined) {
+      delete process.env[name];
+    } else {
+      process.env[name] = value;
+    }
+  }
+
+  afterEach(() => {
+    setEnv('LOG_LEVEL', originalLevel);
+    setEnv('LOG_SAMPLE_RATE', originalRate);
+  });
+
+  function loadLogger(level: string, sampleRate?: string) {
+    process.env.LOG_LEVEL = level;
+    setEnv('LOG_SAMPLE_RATE', sampleRate);
+
+    let loaded: typeof import('../../src/utils/logger') | undefined;
+    jest.isolateModules(() => {
+      loaded = require('../../src/utils/logger');
+    });
+    return loaded!;
+  }
+
+  test('should not build fields when the level is disabled', () => {
+    const { hotPath, default: logger } = loadLogger('info');
+    const debugSpy = jest.spyOn(logger, 'debug').mockImplementation(() => logger);
+    const fields = jest.fn(() => ({ messageId: 'x' }));
+
+    hotPath.debug('test', fields);
+
+    expect(fields).not.toHaveBeenCalled();
+    expect(debugSpy).not.toHaveBeenCalled();
+  });
+
+  test('should write every info entry by default', () => {
+    const { hotPath, default: logger } = loadLogger('info');
+    const infoSpy = jest.spyOn(logger, 'info').mockImplementation(() => logger);
+
+    for (let i = 0; i < 10; i++) {
+      hotPath.info('test', () => ({ i }));
+    }
+
+    expect(infoSpy).toHaveBeenCalledTimes(10);
+  });
+
+  test('should sample info entries at LOG_SAMPLE_RATE', () => {
+    const { hotPath, default: logger } = loadLogger('info', '0.25');
+    const infoSpy = jest.spyOn(logger, 'info').mockImplementation(() => logger);
+    const fields = jest.fn(() => ({}));
+
+    for (let i = 0; i < 100; i++) {
+      hotPath.info('test', fields);
+    }
+
+    expect(infoSpy).toHaveBeenCalledTimes(25);
+    expect(fields).toHaveBeenCalledTimes(25);
+  });
+});
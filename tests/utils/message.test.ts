@@ -1,6 +1,9 @@
 import {
   createMessage,
   createTellMessage,
+  createMultiTellMessage,
+  splitMultiTell,
+  expandMultiTell,
   createChannelMessage,
   createWhoRequestMessage,
   createPingMessage,
@@ -78,6 +81,47 @@ describe('Message Utilities', () => {
     });
   });
 
+  describe('multitell', () => {
+    const recipients = [
+      { mud: 'MudA', user: 'bob' },
+      { mud: 'MudB', user: 'amy' },
+      { mud: 'muda', user: 'joe' },
+      { mud: 'MudA', user: 'Bob' }
+    ];
+
+    test('should address multitells to the gateway', () => {
+      const message = createMultiTellMessage({ mud: 'TestMUD', user: 'sender' }, recipients, 'Hi all');
+
+      expect(message.type).toBe('multitell');
+      expect(message.to).toEqual({ mud: 'Gateway' });
+      expect(message.payload).toEqual({ message: 'Hi all', recipients });
+    });
+
+    test('should split into one envelope per MUD without repeated users', () => {
+      const message = createMultiTellMessage({ mud: 'TestMUD', user: 'sender' }, recipients, 'Hi all');
+      const envelopes = splitMultiTell(message);
+
+      expect(envelopes).toHaveLength(2);
+      expect(envelopes[0].to).toEqual({ mud: 'MudA' });
+      expect(envelopes[0].payload).toEqual({ message: 'Hi all', recipients: [recipients[0], recipients[2]] });
+      expect(envelopes[1].to).toEqual({ mud: 'MudB' });
+      expect(envelopes[1].payload).toEqual({ message: 'Hi all', recipients: [recipients[1]] });
+      expect(envelopes[1].id).toBe(message.id);
+    });
+
+    test('should expand into plain tells', () => {
+      const message = createMultiTellMessage({ mud: 'TestMUD', user: 'sender' }, recipients.slice(0, 2), 'Hi all');
+      const tells = expandMultiTell(message);
+
+      expect(tells).toHaveLength(2);
+      expect(tells[0].type).toBe('tell');
+      expect(tells[0].from).toEqual({ mud: 'TestMUD', user: 'sender' });
+      expect(tells[0].to).toEqual({ mud: 'MudA', user: 'bob' });
+      expect(tells[0].payload).toEqual({ message: 'Hi all' });
+      expect(tells[1].to).toEqual({ mud: 'MudB', user: 'amy' });
+    });
+  });
+
   describe('createChannelMessage', () => {
     test('should create a channel message', () => {
       const message = createChannelMessage(
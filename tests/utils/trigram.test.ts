@@ -0,0 +1,55 @@
+import { TrigramIndex } from '../../src/utils/trigram';
+
+describe('TrigramIndex', () => {
+  const build = () => {
+    const index = new TrigramIndex<string>();
+    index.set('Gandalf@Middle', ['Gandalf', 'Gandalf the Grey', undefined]);
+    index.set('Frodo@Middle', ['Frodo', undefined, 'Frodo Baggins']);
+    index.set('Bilbo@Shire', ['Bilbo', 'Mr. Baggins', 'Bilbo Baggins']);
+    return index;
+  };
+
+  test('should find substrings in any field, ignoring case', () => {
+    const index = build();
+
+    expect(index.search('BAGGINS').sort()).toEqual(['Bilbo@Shire', 'Frodo@Middle']);
+    expect(index.search('grey')).toEqual(['Gandalf@Middle']);
+    expect(index.search('dalf')).toEqual(['Gandalf@Middle']);
+  });
+
+  test('should not match grams spread over different fields', () => {
+    const index = new TrigramIndex<string>();
+    index.set('a', ['abc', 'cde']);
+
+    expect(index.search('bcd')).toEqual([]);
+    expect(index.search('abcde')).toEqual([]);
+  });
+
+  test('should answer short queries by scanning', () => {
+    const index = build();
+
+    expect(index.search('o').sort()).toEqual(['Bilbo@Shire', 'Frodo@Middle']);
+    expect(index.search('mr')).toEqual(['Bilbo@Shire']);
+  });
+
+  test('should honour the limit', () => {
+    const index = build();
+
+    expect(index.search('baggins', 1)).toHaveLength(1);
+    expect(index.search('a', 2)).toHaveLength(2);
+    expect(index.search('baggins', 0)).toEqual([]);
+  });
+
+  test('should forget replaced and deleted keys', () => {
+    const index = build();
+
+    index.set('Bilbo@Shire', ['Bilbo', 'Ring-bearer']);
+    expect(index.search('baggins')).toEqual(['Frodo@Middle']);
+    expect(index.search('bearer')).toEqual(['Bilbo@Shire']);
+
+    expect(index.delete('Frodo@Middle')).toBe(true);
+    expect(index.delete('Frodo@Middle')).toBe(false);
+    expect(index.search('baggins')).toEqual([]);
+    expect(index.size).toBe(2);
+  });
+});